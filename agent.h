@@ -8,35 +8,23 @@
 #ifndef AGENT_H_
 #define AGENT_H_
 
-#include <QStringList>
-
+/*! \brief A reference to the memory of one agent held in an AgentStore.
+ */
 class Agent {
   public:
     Agent() {
-        agentType = "";
-        x = 0.0;
-        y = 0.0;
-        z = 0.0;
-        shapeDimension = 0.0;
-        shapeDimensionY = 0.0;
-        shapeDimensionZ = 0.0;
-        conditionVariable = 0.0;
-        isEnvironment = false;
-        isPicked = false;
+        type = -1;
+        row = -1;
     }
+    Agent(int t, int r) {
+        type = t;
+        row = r;
+    }
+
+    bool isValid() const { return type != -1 && row != -1; }
 
-    QString agentType;
-    QStringList tags;
-    QStringList values;
-    double x;
-    double y;
-    double z;
-    double shapeDimension;
-    double shapeDimensionY;
-    double shapeDimensionZ;
-    double conditionVariable;
-    bool isEnvironment;
-    bool isPicked;
+    int type;  /*!< \brief The agent type index in the store */
+    int row;  /*!< \brief The row of the agent within its type */
 };
 
 #endif  // AGENT_H_
@@ -7,19 +7,36 @@
  */
 #include "./agentdialog.h"
 #include "./ui_agentdialog.h"
+#include "./zeroxmlreader.h"
 
-AgentDialog::AgentDialog(Agent * a, QWidget *parent)
+/*! \brief Show the memory of an agent.
+ *
+ * Agents are read with only the variables the rules and plots use, so if
+ * any were skipped the whole memory of this one agent is read now from
+ * its iteration file.
+ *  \param store The agents of the iteration
+ *  \param a The agent
+ *  \param fileName The iteration file the agents were read from
+ *  \param parent The parent widget
+ */
+AgentDialog::AgentDialog(AgentStore * store, Agent a,
+        const QString & fileName, QWidget *parent)
   : QDialog(parent), ui(new Ui::AgentDialog) {
     ui->setupUi(this);
     agent = a;
+    AgentColumns columns = store->type(a.type);
+    if (columns.isProjected() && !fileName.isEmpty() &&
+            ZeroXMLReader::readAgent(fileName, columns.name, a.row,
+                &columns))
+        a.row = 0;
 
     QString title = "Agent '";
-    title.append(a->agentType);
+    title.append(columns.name);
     title.append("' Memory");
     setWindowTitle(title);
 
     ui->tableWidget_Variables->setColumnCount(2);
-    ui->tableWidget_Variables->setRowCount(a->tags.size());
+    ui->tableWidget_Variables->setRowCount(columns.variables.size());
     QStringList headers;
     headers.append("name");
     headers.append("value");
@@ -31,14 +48,14 @@ AgentDialog::AgentDialog(Agent * a, QWidget *parent)
     // ui->tableWidget_Variables->setSelectionBehavior(
     // QAbstractItemView::SelectRows);
 
-    for (int i = 0; i < a->tags.size(); i++) {
+    for (int i = 0; i < columns.variables.size(); i++) {
         int row = i;
         int column = 0;
-        QTableWidgetItem *newItem = new QTableWidgetItem(a->tags[i]);
+        QTableWidgetItem *newItem = new QTableWidgetItem(columns.variables[i]);
         newItem->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
         ui->tableWidget_Variables->setItem(row, column, newItem);
         column = 1;
-        newItem = new QTableWidgetItem(a->values[i]);
+        newItem = new QTableWidgetItem(columns.text(i, a.row));
         newItem->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
         ui->tableWidget_Variables->setItem(row, column, newItem);
     }
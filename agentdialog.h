@@ -10,6 +10,7 @@
 
 #include <QDialog>
 #include "./agent.h"
+#include "./agentstore.h"
 
 namespace Ui {
     class AgentDialog;
@@ -19,12 +20,13 @@ class AgentDialog : public QDialog {
     Q_OBJECT
 
   public:
-    explicit AgentDialog(Agent * a, QWidget *parent = 0);
+    AgentDialog(AgentStore * store, Agent a, const QString & fileName,
+            QWidget *parent = 0);
     ~AgentDialog();
 
   private:
     Ui::AgentDialog *ui;
-    Agent * agent;
+    Agent agent;
 };
 
 #endif  // AGENTDIALOG_H_
@@ -0,0 +1,342 @@
+/*!
+ * \file agentpicker.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of agent picker
+ */
+#include <math.h>
+#include "./agentpicker.h"
+#include "./visualsettingsitem.h"
+
+/*! \brief Pick radius in pixels, as the 5 by 5 gluPickMatrix used */
+static const double pickPixels = 2.5;
+/*! \brief The most cells along an axis */
+static const int maximumResolution = 128;
+/*! \brief The most rings of cells tested around the ray for points */
+static const int maximumRing = 4;
+
+AgentPicker::AgentPicker() {
+    for (int a = 0; a < 3; a++) {
+        minimum[a] = 0.0;
+        cellSize[a] = 1.0;
+        resolution[a] = 0;
+    }
+    hasPoints = false;
+    pickCount = 0;
+    valid = false;
+    restricted = false;
+}
+
+/*! \brief True if the grid is out of date.
+ *  \param limits The axes restriction or 0 if the axes are not restricted
+ */
+bool AgentPicker::needsBuild(const Dimension * limits) const {
+    if (!valid) return true;
+    if ((limits != 0) != restricted) return true;
+    return limits != 0 && *limits != restriction;
+}
+
+/*! \brief Put the rule agents of every rule into the grid.
+ *  \param model The visual rules
+ *  \param limits The axes restriction or 0 if the axes are not restricted
+ */
+void AgentPicker::build(VisualSettingsModel * model,
+        const Dimension * limits) {
+    entries.clear();
+    cellStart.clear();
+    cellEntries.clear();
+    hasPoints = false;
+    restricted = (limits != 0);
+    if (limits) restriction = *limits;
+    valid = true;
+
+    for (int j = 0; j < model->getRules().count(); j++) {
+        VisualSettingsItem * rule = model->getRules()[j];
+        QString shape = rule->shape().getShape();
+        for (int i = 0; i < rule->agents.size(); i++) {
+            RuleAgent * a = rule->agents.at(i);
+            if (limits && !limits->contains(a->x, a->y, a->z)) continue;
+            PickEntry e;
+            e.agent = a;
+            e.x = a->x;
+            e.y = a->y;
+            e.z = a->z;
+            e.pixels = 0.0;
+            if (shape == "sphere") {
+                e.shape = PickEntry::Sphere;
+                e.hx = e.hy = e.hz = a->shapeDimension/2.0;
+            } else if (shape == "cube") {
+                e.shape = PickEntry::Cube;
+                e.hx = a->shapeDimension/2.0;
+                e.hy = a->shapeDimensionY/2.0;
+                e.hz = a->shapeDimensionZ/2.0;
+            } else if (shape == "point") {
+                e.shape = PickEntry::Point;
+                e.hx = e.hy = e.hz = 0.0;
+                e.pixels = qMax(pickPixels, a->shapeDimension/2.0);
+                hasPoints = true;
+            } else {
+                continue;
+            }
+            entries.append(e);
+        }
+    }
+    if (entries.isEmpty()) return;
+
+    /* Bounds of every agent */
+    double maximum[3];
+    minimum[0] = maximum[0] = entries.at(0).x;
+    minimum[1] = maximum[1] = entries.at(0).y;
+    minimum[2] = maximum[2] = entries.at(0).z;
+    for (int i = 0; i < entries.count(); i++) {
+        const PickEntry & e = entries.at(i);
+        minimum[0] = qMin(minimum[0], e.x - e.hx);
+        minimum[1] = qMin(minimum[1], e.y - e.hy);
+        minimum[2] = qMin(minimum[2], e.z - e.hz);
+        maximum[0] = qMax(maximum[0], e.x + e.hx);
+        maximum[1] = qMax(maximum[1], e.y + e.hy);
+        maximum[2] = qMax(maximum[2], e.z + e.hz);
+    }
+
+    /* About one cell per agent over the axes that are not flat */
+    int axes = 0;
+    for (int a = 0; a < 3; a++)
+        if (maximum[a] > minimum[a]) axes++;
+    int cells = 1;
+    if (axes > 0)
+        cells = static_cast<int>(ceil(
+                pow(static_cast<double>(entries.count()), 1.0 / axes)));
+    cells = qBound(1, cells, maximumResolution);
+    for (int a = 0; a < 3; a++) {
+        double extent = maximum[a] - minimum[a];
+        resolution[a] = (extent > 0.0) ? cells : 1;
+        cellSize[a] = (extent > 0.0) ? extent / resolution[a] : 1.0;
+    }
+
+    /* Count the entries of each cell, then place them */
+    int total = resolution[0] * resolution[1] * resolution[2];
+    cellStart.fill(0, total + 1);
+    for (int pass = 0; pass < 2; pass++) {
+        QVector<int> next;
+        if (pass == 1) {
+            for (int c = 0; c < total; c++)
+                cellStart[c + 1] += cellStart[c];
+            cellEntries.resize(cellStart.at(total));
+            next = cellStart;
+        }
+        for (int n = 0; n < entries.count(); n++) {
+            const PickEntry & e = entries.at(n);
+            int lo[3], hi[3];
+            double centre[3] = { e.x, e.y, e.z };
+            double half[3] = { e.hx, e.hy, e.hz };
+            for (int a = 0; a < 3; a++) {
+                lo[a] = qBound(0, static_cast<int>(floor(
+                        (centre[a] - half[a] - minimum[a]) / cellSize[a])),
+                        resolution[a] - 1);
+                hi[a] = qBound(0, static_cast<int>(floor(
+                        (centre[a] + half[a] - minimum[a]) / cellSize[a])),
+                        resolution[a] - 1);
+            }
+            for (int k = lo[2]; k <= hi[2]; k++)
+                for (int j = lo[1]; j <= hi[1]; j++)
+                    for (int i = lo[0]; i <= hi[0]; i++) {
+                        int c = cellIndex(i, j, k);
+                        if (pass == 0)
+                            cellStart[c + 1]++;
+                        else
+                            cellEntries[next[c]++] = n;
+                    }
+        }
+    }
+
+    stamps.fill(0, entries.count());
+    pickCount = 0;
+}
+
+/*! \brief Find the nearest rule agent along a ray.
+ *  \param nearPoint The mouse position unprojected onto the near plane
+ *  \param farPoint The mouse position unprojected onto the far plane
+ *  \param nearPixel The size of a pixel at the near plane
+ *  \param farPixel The size of a pixel at the far plane
+ *  \return The nearest rule agent or 0 if none is under the mouse
+ */
+RuleAgent * AgentPicker::pick(const double nearPoint[3],
+        const double farPoint[3], double nearPixel, double farPixel) const {
+    if (entries.isEmpty()) return 0;
+
+    double o[3], d[3];
+    for (int a = 0; a < 3; a++) {
+        o[a] = nearPoint[a];
+        d[a] = farPoint[a] - nearPoint[a];
+    }
+
+    /* Points are hit within a few pixels so look at cells around the ray */
+    int ring = 0;
+    double margin = 0.0;
+    if (hasPoints) {
+        double largest = 0.0;
+        for (int i = 0; i < entries.count(); i++)
+            largest = qMax(largest, entries.at(i).pixels);
+        margin = largest * qMax(nearPixel, farPixel);
+        double smallestCell = qMin(cellSize[0], qMin(cellSize[1],
+                cellSize[2]));
+        ring = static_cast<int>(ceil(margin / smallestCell));
+    }
+
+    pickCount++;
+    if (pickCount == 0) {
+        stamps.fill(0);
+        pickCount = 1;
+    }
+
+    int best = -1;
+    double bestS = 2.0;
+
+    if (ring > maximumRing) {
+        /* Points are large compared to the cells, test every agent */
+        for (int n = 0; n < entries.count(); n++) {
+            double s;
+            if (hit(entries.at(n), o, d, nearPixel, farPixel, &s) &&
+                    s < bestS) {
+                best = n;
+                bestS = s;
+            }
+        }
+        return (best == -1) ? 0 : entries.at(best).agent;
+    }
+
+    /* Clip the ray to the grid, grown by the point margin */
+    double sEnter = 0.0, sExit = 1.0;
+    for (int a = 0; a < 3; a++) {
+        double lo = minimum[a] - margin;
+        double hi = minimum[a] + resolution[a] * cellSize[a] + margin;
+        if (d[a] == 0.0) {
+            if (o[a] < lo || o[a] > hi) return 0;
+        } else {
+            double s1 = (lo - o[a]) / d[a];
+            double s2 = (hi - o[a]) / d[a];
+            if (s1 > s2) qSwap(s1, s2);
+            sEnter = qMax(sEnter, s1);
+            sExit = qMin(sExit, s2);
+        }
+    }
+    if (sEnter > sExit) return 0;
+
+    /* Walk the cells along the ray */
+    int cell[3], step[3];
+    double sMax[3], sDelta[3];
+    for (int a = 0; a < 3; a++) {
+        double p = o[a] + d[a] * sEnter;
+        cell[a] = qBound(0, static_cast<int>(floor(
+                (p - minimum[a]) / cellSize[a])), resolution[a] - 1);
+        if (d[a] > 0.0) {
+            step[a] = 1;
+            sMax[a] = (minimum[a] + (cell[a] + 1) * cellSize[a] - o[a]) / d[a];
+            sDelta[a] = cellSize[a] / d[a];
+        } else if (d[a] < 0.0) {
+            step[a] = -1;
+            sMax[a] = (minimum[a] + cell[a] * cellSize[a] - o[a]) / d[a];
+            sDelta[a] = -cellSize[a] / d[a];
+        } else {
+            step[a] = 0;
+            sMax[a] = 3.0;
+            sDelta[a] = 3.0;
+        }
+    }
+
+    double s = sEnter;
+    while (true) {
+        /* Nothing in later cells can be nearer than a hit already found */
+        if (best != -1 && s > bestS) break;
+
+        for (int k = cell[2] - ring; k <= cell[2] + ring; k++) {
+            if (k < 0 || k >= resolution[2]) continue;
+            for (int j = cell[1] - ring; j <= cell[1] + ring; j++) {
+                if (j < 0 || j >= resolution[1]) continue;
+                for (int i = cell[0] - ring; i <= cell[0] + ring; i++) {
+                    if (i < 0 || i >= resolution[0]) continue;
+                    int c = cellIndex(i, j, k);
+                    for (int m = cellStart.at(c); m < cellStart.at(c + 1);
+                            m++) {
+                        int n = cellEntries.at(m);
+                        if (stamps.at(n) == pickCount) continue;
+                        stamps[n] = pickCount;
+                        double hitS;
+                        if (hit(entries.at(n), o, d, nearPixel, farPixel,
+                                &hitS) && hitS < bestS) {
+                            best = n;
+                            bestS = hitS;
+                        }
+                    }
+                }
+            }
+        }
+
+        int a = 0;
+        if (sMax[1] < sMax[a]) a = 1;
+        if (sMax[2] < sMax[a]) a = 2;
+        if (sMax[a] > sExit) break;
+        s = sMax[a];
+        cell[a] += step[a];
+        if (cell[a] < 0 || cell[a] >= resolution[a]) break;
+        sMax[a] += sDelta[a];
+    }
+
+    return (best == -1) ? 0 : entries.at(best).agent;
+}
+
+/*! \brief Test the ray against one agent.
+ *  \param e The agent
+ *  \param o The ray origin on the near plane
+ *  \param d The ray from the near plane to the far plane
+ *  \param nearPixel The size of a pixel at the near plane
+ *  \param farPixel The size of a pixel at the far plane
+ *  \param s Where the ray first meets the agent, 0 near to 1 far
+ *  \return True if the ray meets the agent between the planes
+ */
+bool AgentPicker::hit(const PickEntry & e, const double o[3],
+        const double d[3], double nearPixel, double farPixel,
+        double * s) const {
+    double c[3] = { e.x - o[0], e.y - o[1], e.z - o[2] };
+    double dd = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    double cd = c[0] * d[0] + c[1] * d[1] + c[2] * d[2];
+
+    if (e.shape == PickEntry::Sphere) {
+        double cc = c[0] * c[0] + c[1] * c[1] + c[2] * c[2] - e.hx * e.hx;
+        double disc = cd * cd - dd * cc;
+        if (disc < 0.0 || e.hx <= 0.0) return false;
+        double root = sqrt(disc);
+        double s0 = (cd - root) / dd;
+        double s1 = (cd + root) / dd;
+        if (s1 < 0.0 || s0 > 1.0) return false;
+        *s = qMax(s0, 0.0);
+        return true;
+    } else if (e.shape == PickEntry::Cube) {
+        double half[3] = { e.hx, e.hy, e.hz };
+        double sNear = 0.0, sFar = 1.0;
+        for (int a = 0; a < 3; a++) {
+            if (d[a] == 0.0) {
+                if (c[a] - half[a] > 0.0 || c[a] + half[a] < 0.0)
+                    return false;
+            } else {
+                double s1 = (c[a] - half[a]) / d[a];
+                double s2 = (c[a] + half[a]) / d[a];
+                if (s1 > s2) qSwap(s1, s2);
+                sNear = qMax(sNear, s1);
+                sFar = qMin(sFar, s2);
+                if (sNear > sFar) return false;
+            }
+        }
+        *s = sNear;
+        return true;
+    } else {
+        double t = qBound(0.0, cd / dd, 1.0);
+        double q[3] = { c[0] - d[0] * t, c[1] - d[1] * t, c[2] - d[2] * t };
+        double distance = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+        double radius = e.pixels * (nearPixel + t * (farPixel - nearPixel));
+        if (distance > radius) return false;
+        *s = t;
+        return true;
+    }
+}
@@ -0,0 +1,66 @@
+/*!
+ * \file agentpicker.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for agent picker
+ */
+#ifndef AGENTPICKER_H_
+#define AGENTPICKER_H_
+
+#include <QVector>
+#include "./visualsettingsmodel.h"
+#include "./ruleagent.h"
+#include "./dimension.h"
+
+/*! \brief The pick shape of one rule agent */
+struct PickEntry {
+    enum Shape { Sphere, Cube, Point };
+
+    RuleAgent * agent;
+    Shape shape;
+    double x, y, z;  /*!< \brief Centre */
+    double hx, hy, hz;  /*!< \brief Half size, hx is the sphere radius */
+    double pixels;  /*!< \brief Pick radius of a point in pixels */
+};
+
+/*! \brief Finds the rule agent under the mouse by casting a ray.
+ *
+ * The rule agents are put into a uniform grid of cells over their bounds,
+ * roughly one cell per agent.  A pick walks the cells along the ray from
+ * the near to the far plane and tests only the agents in those cells,
+ * stopping at the first cell beyond the nearest hit.  Points are picked
+ * within a few pixels of the ray so the cells next to the ray are tested
+ * too.  The grid is built on the first pick after the rule agents change.
+ */
+class AgentPicker {
+  public:
+    AgentPicker();
+
+    void invalidate() { valid = false; }
+    bool needsBuild(const Dimension * limits) const;
+    void build(VisualSettingsModel * model, const Dimension * limits);
+    RuleAgent * pick(const double nearPoint[3], const double farPoint[3],
+            double nearPixel, double farPixel) const;
+
+  private:
+    bool hit(const PickEntry & e, const double o[3], const double d[3],
+            double nearPixel, double farPixel, double * s) const;
+    int cellIndex(int i, int j, int k) const {
+        return (k * resolution[1] + j) * resolution[0] + i;
+    }
+    QVector<PickEntry> entries;
+    QVector<int> cellStart;  /*!< \brief First entry of each cell */
+    QVector<int> cellEntries;  /*!< \brief Entries ordered by cell */
+    double minimum[3];  /*!< \brief Grid lower corner */
+    double cellSize[3];
+    int resolution[3];  /*!< \brief Number of cells along each axis */
+    bool hasPoints;
+    mutable QVector<int> stamps;  /*!< \brief Last pick each entry was tested */
+    mutable int pickCount;
+    bool valid;
+    bool restricted;  /*!< \brief True if built with the axes restricted */
+    Dimension restriction;  /*!< \brief The axes restriction built with */
+};
+
+#endif  // AGENTPICKER_H_
@@ -0,0 +1,99 @@
+/*!
+ * \file agentprojection.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of agent projection
+ */
+#include "./agentprojection.h"
+#include "./visualsettingsitem.h"
+#include "./graphsettingsitem.h"
+
+/*! \brief Add the variables a visual rule uses, the same ones a
+ *  CompiledRule looks up, and its agent type if the rule is enabled.
+ *
+ * The variables of a disabled rule are added so enabling it only needs
+ * its agents read.
+ *  \param rule The visual rule
+ */
+void AgentProjection::addRule(VisualSettingsItem * rule) {
+    QString type = rule->agentType();
+    Condition condition = rule->condition();
+    Position x = rule->x();
+    Position y = rule->y();
+    Position z = rule->z();
+    Shape shape = rule->shape();
+
+    if (rule->enabled()) addType(type);
+    if (condition.enable) addVariable(type, condition.variable);
+    if (x.useVariable) addVariable(type, x.positionVariable);
+    if (y.useVariable) addVariable(type, y.positionVariable);
+    if (z.useVariable) addVariable(type, z.positionVariable);
+    if (shape.getUseVariable())
+        addVariable(type, shape.getDimensionVariable());
+    if (shape.getUseVariableY())
+        addVariable(type, shape.getDimensionVariableY());
+    if (shape.getUseVariableZ())
+        addVariable(type, shape.getDimensionVariableZ());
+}
+
+/*! \brief Add the variable a plot condition uses, and its agent type if
+ *  its graph is shown.
+ *  \param plot The plot
+ */
+void AgentProjection::addPlot(GraphSettingsItem * plot) {
+    Condition condition = plot->condition();
+    if (plot->getEnable()) addType(plot->getYaxis());
+    if (condition.enable) addVariable(plot->getYaxis(), condition.variable);
+}
+
+/*! \brief Add an agent type to be read.
+ *  \param type The agent type
+ */
+void AgentProjection::addType(const QString & type) {
+    if (all) return;
+    types.insert(type);
+}
+
+/*! \brief Add a variable to be read.
+ *  \param type The agent type
+ *  \param variable The memory variable
+ */
+void AgentProjection::addVariable(const QString & type,
+        const QString & variable) {
+    if (all) return;
+    variables[type].insert(variable);
+}
+
+/*! \brief True if a variable is to be read.
+ *  \param type The agent type
+ *  \param variable The memory variable
+ */
+bool AgentProjection::wantsVariable(const QString & type,
+        const QString & variable) const {
+    if (all) return true;
+    QHash<QString, QSet<QString> >::const_iterator i = variables.find(type);
+    return i != variables.constEnd() && i.value().contains(variable);
+}
+
+/*! \brief True if every agent and variable another projection reads is
+ *  read by this one, so agents read with this one can be used in its place.
+ *  \param other The other projection
+ */
+bool AgentProjection::contains(const AgentProjection & other) const {
+    if (all) return true;
+    if (other.all) return false;
+    if (!types.contains(other.types)) return false;
+    QHash<QString, QSet<QString> >::const_iterator i;
+    for (i = other.variables.constBegin(); i != other.variables.constEnd();
+            ++i) {
+        QHash<QString, QSet<QString> >::const_iterator j =
+                variables.find(i.key());
+        if (j == variables.constEnd()) {
+            if (!i.value().isEmpty()) return false;
+        } else if (!j.value().contains(i.value())) {
+            return false;
+        }
+    }
+    return true;
+}
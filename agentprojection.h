@@ -0,0 +1,48 @@
+/*!
+ * \file agentprojection.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for agent projection
+ */
+#ifndef AGENTPROJECTION_H_
+#define AGENTPROJECTION_H_
+
+#include <QString>
+#include <QHash>
+#include <QSet>
+
+class VisualSettingsItem;
+class GraphSettingsItem;
+
+/*! \brief The agent types and memory variables that need to be read.
+ *
+ * Visual rules and plots only use a few of the memory variables of an
+ * agent type.  The readers skip the text of every other variable, so less
+ * is parsed and held.  Agents of a type no enabled rule or plot uses are
+ * only counted.  A projection of everything reads every agent and
+ * variable.
+ */
+class AgentProjection {
+  public:
+    explicit AgentProjection(bool everything = true) { all = everything; }
+
+    void addRule(VisualSettingsItem * rule);
+    void addPlot(GraphSettingsItem * plot);
+    void addType(const QString & type);
+    void addVariable(const QString & type, const QString & variable);
+    bool isAll() const { return all; }
+    bool wantsType(const QString & type) const {
+        return all || types.contains(type);
+    }
+    bool wantsVariable(const QString & type, const QString & variable) const;
+    bool contains(const AgentProjection & other) const;
+
+  private:
+    bool all;  /*!< \brief True to read every variable */
+    QSet<QString> types;  /*!< \brief The agent types to read */
+    /*! \brief The variables to read of each agent type */
+    QHash<QString, QSet<QString> > variables;
+};
+
+#endif  // AGENTPROJECTION_H_
@@ -0,0 +1,735 @@
+/*!
+ * \file agentrenderer.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of agent renderer
+ */
+#include <QMap>
+#include <QtAlgorithms>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include "./agentrenderer.h"
+#include "./visualsettingsitem.h"
+
+/*! \brief The most vertices of one sphere batch before detail is lowered */
+static const int sphereVertexBudget = 1 << 21;
+/*! \brief The number of agents aimed for in one chunk */
+static const int chunkAgents = 1024;
+/*! \brief The most vertices held by built levels before unused ones are
+ *  freed */
+static const int cacheVertexBudget = 1 << 22;
+
+/*! \brief The colour of an agent, inverted if it has been picked */
+static QColor agentColour(const QColor & colour, const RuleAgent * a) {
+    if (!a->isPicked) return colour;
+    QColor c;
+    c.setRgbF(1.0 - colour.redF(), 1.0 - colour.greenF(),
+            1.0 - colour.blueF(), colour.alphaF());
+    return c;
+}
+
+/*! \brief The number of sphere slices and stacks of a level */
+static int sphereDetail(int level) {
+    return 2 << level;
+}
+
+AgentBatch::AgentBatch()
+    : vertexBuffer(QGLBuffer::VertexBuffer),
+      indexBuffer(QGLBuffer::IndexBuffer) {
+    primitive = GL_POINTS;
+    transparent = false;
+    pointSize = 1.0;
+    vertexCount = 0;
+    indexCount = 0;
+    buffered = false;
+    orderVersion = -1;
+}
+
+AgentChunk::AgentChunk() {
+    shape = Sphere;
+    transparent = false;
+    pointSize = 1.0;
+    centre[0] = centre[1] = centre[2] = 0.0;
+    radius = 0.0;
+    largest = 0.0;
+    depth = 0.0;
+    orderVersion = 0;
+    sortedView = -1;
+    for (int l = 0; l < levelCount; l++) {
+        levels[l] = 0;
+        lastDrawn[l] = 0;
+    }
+}
+
+AgentChunk::~AgentChunk() {
+    for (int l = 0; l < levelCount; l++) delete levels[l];
+}
+
+AgentRenderer::AgentRenderer() {
+    valid = false;
+    restricted = false;
+    frame = 0;
+    cachedVertices = 0;
+    drawnVertices = 0;
+    drawnChunks = 0;
+    sorted = false;
+    viewGeneration = 0;
+}
+
+AgentRenderer::~AgentRenderer() {
+    clear();
+}
+
+/*! \brief Delete all chunks and their buffers, the GL context must be
+ *  current.
+ */
+void AgentRenderer::clear() {
+    qDeleteAll(chunks);
+    chunks.clear();
+    opaqueChunks.clear();
+    transparentChunks.clear();
+    sorted = false;
+    cachedVertices = 0;
+    valid = false;
+}
+
+/*! \brief True if the chunks are out of date.
+ *  \param limits The axes restriction or 0 if the axes are not restricted
+ */
+bool AgentRenderer::needsBuild(const Dimension * limits) const {
+    if (!valid) return true;
+    if ((limits != 0) != restricted) return true;
+    return limits != 0 && *limits != restriction;
+}
+
+/*! \brief Sort the rule agents of every rule into chunks.
+ *  \param model The visual rules
+ *  \param limits The axes restriction or 0 if the axes are not restricted
+ */
+void AgentRenderer::build(VisualSettingsModel * model,
+        const Dimension * limits) {
+    clear();
+    restricted = (limits != 0);
+    if (limits) restriction = *limits;
+
+    for (int j = 0; j < model->getRules().count(); j++) {
+        VisualSettingsItem * rule = model->getRules()[j];
+        if (rule->agents.isEmpty()) continue;
+        QString shape = rule->shape().getShape();
+        QColor colour = rule->colour();
+        bool transparent = colour.alphaF() < 0.95;
+
+        if (shape == "sphere") {
+            addChunks(rule->agents, AgentChunk::Sphere, transparent, 1.0,
+                    colour, limits);
+        } else if (shape == "cube") {
+            addChunks(rule->agents, AgentChunk::Cube, transparent, 1.0,
+                    colour, limits);
+        } else if (shape == "point") {
+            /* Chunks of one point size */
+            QMap<int, QList<RuleAgent *> > sizes;
+            for (int i = 0; i < rule->agents.size(); i++) {
+                RuleAgent * a = rule->agents.at(i);
+                sizes[static_cast<int>(a->shapeDimension)].append(a);
+            }
+            QMapIterator<int, QList<RuleAgent *> > size(sizes);
+            while (size.hasNext()) {
+                size.next();
+                addChunks(size.value(), AgentChunk::Point, transparent,
+                        size.key(), colour, limits);
+            }
+        }
+    }
+
+    valid = true;
+}
+
+/*! \brief Sort the agents of one rule into chunks by a grid over them.
+ *  \param ruleAgents The rule agents
+ *  \param shape The rule shape
+ *  \param transparent True if the rule colour is transparent
+ *  \param pointSize The point size of point rules
+ *  \param colour The rule colour
+ *  \param limits The axes restriction or 0 if the axes are not restricted
+ */
+void AgentRenderer::addChunks(const QList<RuleAgent *> & ruleAgents,
+        AgentChunk::Shape shape, bool transparent, float pointSize,
+        const QColor & colour, const Dimension * limits) {
+    QVector<ChunkAgent> all;
+    all.reserve(ruleAgents.size());
+    for (int i = 0; i < ruleAgents.size(); i++) {
+        const RuleAgent * a = ruleAgents.at(i);
+        if (limits && !limits->contains(a->x, a->y, a->z)) continue;
+        QColor c = agentColour(colour, a);
+        ChunkAgent ca;
+        ca.x = a->x;
+        ca.y = a->y;
+        ca.z = a->z;
+        ca.sx = ca.sy = ca.sz = 0.0;
+        if (shape == AgentChunk::Sphere) {
+            ca.sx = ca.sy = ca.sz = a->shapeDimension/2.0;
+        } else if (shape == AgentChunk::Cube) {
+            ca.sx = a->shapeDimension/2.0;
+            ca.sy = a->shapeDimensionY/2.0;
+            ca.sz = a->shapeDimensionZ/2.0;
+        }
+        ca.r = c.red();
+        ca.g = c.green();
+        ca.b = c.blue();
+        ca.a = c.alpha();
+        all.append(ca);
+    }
+    if (all.isEmpty()) return;
+
+    /* A grid of about chunkAgents agents per cell over the axes that are
+     * not flat */
+    float minimum[3] = { all.at(0).x, all.at(0).y, all.at(0).z };
+    float maximum[3] = { all.at(0).x, all.at(0).y, all.at(0).z };
+    for (int i = 0; i < all.count(); i++) {
+        const ChunkAgent & a = all.at(i);
+        minimum[0] = qMin(minimum[0], a.x);
+        minimum[1] = qMin(minimum[1], a.y);
+        minimum[2] = qMin(minimum[2], a.z);
+        maximum[0] = qMax(maximum[0], a.x);
+        maximum[1] = qMax(maximum[1], a.y);
+        maximum[2] = qMax(maximum[2], a.z);
+    }
+    int axes = 0;
+    for (int k = 0; k < 3; k++)
+        if (maximum[k] > minimum[k]) axes++;
+    int cells = (all.count() + chunkAgents - 1) / chunkAgents;
+    int perAxis = 1;
+    if (axes > 0)
+        perAxis = qMax(1, static_cast<int>(ceil(
+                pow(static_cast<double>(cells), 1.0 / axes))));
+    int resolution[3];
+    float cellSize[3];
+    for (int k = 0; k < 3; k++) {
+        resolution[k] = (maximum[k] > minimum[k]) ? perAxis : 1;
+        cellSize[k] = (maximum[k] > minimum[k]) ?
+                (maximum[k] - minimum[k]) / resolution[k] : 1.0;
+    }
+
+    QVector<AgentChunk *> grid(resolution[0] * resolution[1] * resolution[2],
+            0);
+    for (int i = 0; i < all.count(); i++) {
+        const ChunkAgent & a = all.at(i);
+        float p[3] = { a.x, a.y, a.z };
+        int cell[3];
+        for (int k = 0; k < 3; k++)
+            cell[k] = qBound(0, static_cast<int>(
+                    (p[k] - minimum[k]) / cellSize[k]), resolution[k] - 1);
+        int index = (cell[2] * resolution[1] + cell[1]) * resolution[0] +
+                cell[0];
+        AgentChunk * chunk = grid.at(index);
+        if (chunk == 0) {
+            chunk = new AgentChunk;
+            chunk->shape = shape;
+            chunk->transparent = transparent;
+            chunk->pointSize = pointSize;
+            grid[index] = chunk;
+            chunks.append(chunk);
+            if (transparent)
+                transparentChunks.append(chunk);
+            else
+                opaqueChunks.append(chunk);
+        }
+        chunk->agents.append(a);
+    }
+
+    /* Bounding sphere of each chunk */
+    for (int g = 0; g < grid.count(); g++) {
+        AgentChunk * chunk = grid.at(g);
+        if (chunk == 0) continue;
+        const ChunkAgent & first = chunk->agents.at(0);
+        float lo[3] = { first.x, first.y, first.z };
+        float hi[3] = { first.x, first.y, first.z };
+        for (int i = 0; i < chunk->agents.count(); i++) {
+            const ChunkAgent & a = chunk->agents.at(i);
+            lo[0] = qMin(lo[0], a.x);
+            lo[1] = qMin(lo[1], a.y);
+            lo[2] = qMin(lo[2], a.z);
+            hi[0] = qMax(hi[0], a.x);
+            hi[1] = qMax(hi[1], a.y);
+            hi[2] = qMax(hi[2], a.z);
+            chunk->largest = qMax(chunk->largest,
+                    qMax(a.sx, qMax(a.sy, a.sz)));
+        }
+        float diagonal = 0.0;
+        for (int k = 0; k < 3; k++) {
+            chunk->centre[k] = (lo[k] + hi[k]) / 2.0;
+            diagonal += (hi[k] - lo[k]) * (hi[k] - lo[k]);
+        }
+        /* A cube corner is further than its largest half size */
+        float extra = (shape == AgentChunk::Cube) ?
+                chunk->largest * sqrt(3.0) : chunk->largest;
+        chunk->radius = sqrt(diagonal) / 2.0 + extra;
+    }
+}
+
+/*! \brief True if a sphere is at least partly inside the view frustum.
+ *  \param frustum The six frustum planes, normalised
+ *  \param c The sphere centre
+ *  \param radius The sphere radius
+ */
+bool AgentRenderer::sphereInFrustum(const float frustum[6][4],
+        const float c[3], float radius) {
+    for (int p = 0; p < 6; p++) {
+        float d = frustum[p][0] * c[0] + frustum[p][1] * c[1] +
+                frustum[p][2] * c[2] + frustum[p][3];
+        if (d <= -radius) return false;
+    }
+    return true;
+}
+
+/*! \brief The level of detail of a chunk from the pixel radius of its
+ *  largest agent at the nearest point of the chunk.
+ *  \param chunk The chunk
+ *  \param modelview The modelview matrix
+ *  \param projection The projection matrix
+ *  \param viewportHeight The viewport height in pixels
+ *  \return 0 for points, otherwise the sphere level or 1 for cubes
+ */
+int AgentRenderer::chooseLevel(const AgentChunk * chunk,
+        const float modelview[16], const float projection[16],
+        int viewportHeight) const {
+    if (chunk->shape == AgentChunk::Point) return 0;
+    int top = (chunk->shape == AgentChunk::Cube) ?
+            1 : AgentChunk::levelCount - 1;
+
+    /* Clip w of the nearest point, the eye distance in perspective */
+    float z = modelview[2] * chunk->centre[0] +
+            modelview[6] * chunk->centre[1] +
+            modelview[10] * chunk->centre[2] + modelview[14];
+    float w = projection[11] * z + projection[15] -
+            chunk->radius * fabs(projection[11]);
+
+    int level = top;
+    if (w > 0.0) {
+        float pixels = chunk->largest * fabs(projection[5]) *
+                viewportHeight / 2.0 / w;
+        if (pixels < 1.0) return 0;
+        level = 1;
+        while (level < top && sphereDetail(level) < pixels) level++;
+    }
+
+    if (chunk->shape == AgentChunk::Sphere) {
+        while (level > 1 && static_cast<qint64>(chunk->agents.count()) *
+                (sphereDetail(level) + 1) * (sphereDetail(level) + 1) >
+                sphereVertexBudget)
+            level--;
+    }
+    return level;
+}
+
+/*! \brief Build the batch of one level of a chunk.
+ *  \param chunk The chunk
+ *  \param level The level
+ *  \return The batch, uploaded if the GL supports buffer objects
+ */
+AgentBatch * AgentRenderer::buildLevel(const AgentChunk * chunk, int level) {
+    AgentBatch * batch = new AgentBatch;
+    batch->transparent = chunk->transparent;
+
+    if (level == 0) {
+        batch->primitive = GL_POINTS;
+        batch->pointSize = (chunk->shape == AgentChunk::Point) ?
+                chunk->pointSize : 1.0;
+        batch->vertices.reserve(chunk->agents.count());
+        for (int i = 0; i < chunk->agents.count(); i++) {
+            const ChunkAgent & a = chunk->agents.at(i);
+            RenderVertex v;
+            v.x = a.x;
+            v.y = a.y;
+            v.z = a.z;
+            v.nx = 0.0;
+            v.ny = 0.0;
+            v.nz = 1.0;
+            v.r = a.r;
+            v.g = a.g;
+            v.b = a.b;
+            v.a = a.a;
+            batch->vertices.append(v);
+        }
+    } else if (chunk->shape == AgentChunk::Cube) {
+        batch->primitive = GL_QUADS;
+        for (int i = 0; i < chunk->agents.count(); i++)
+            addCube(batch, chunk->agents.at(i));
+    } else {
+        batch->primitive = GL_TRIANGLES;
+        if (sphereMeshes[level].isEmpty())
+            sphereMesh(sphereDetail(level), &sphereMeshes[level],
+                    &sphereMeshIndices[level]);
+        for (int i = 0; i < chunk->agents.count(); i++)
+            addSphere(batch, chunk->agents.at(i), level);
+    }
+
+    if (chunk->transparent) orderBatch(batch, chunk, level);
+    upload(batch);
+    return batch;
+}
+
+/*! \brief A unit sphere as an indexed triangle mesh.
+ *  \param detail The number of slices and stacks
+ *  \param mesh The vertices, normals are the same as positions
+ *  \param meshIndices The triangle indices, counter clockwise from outside
+ */
+void AgentRenderer::sphereMesh(int detail, QVector<RenderVertex> * mesh,
+        QVector<GLuint> * meshIndices) {
+    for (int i = 0; i <= detail; i++) {
+        double phi = M_PI * i / detail;
+        for (int j = 0; j <= detail; j++) {
+            double theta = 2.0 * M_PI * j / detail;
+            RenderVertex v;
+            v.nx = v.x = sin(phi) * cos(theta);
+            v.ny = v.y = sin(phi) * sin(theta);
+            v.nz = v.z = cos(phi);
+            v.r = v.g = v.b = v.a = 255;
+            mesh->append(v);
+        }
+    }
+    for (int i = 0; i < detail; i++) {
+        for (int j = 0; j < detail; j++) {
+            GLuint a = i * (detail + 1) + j;
+            GLuint b = a + detail + 1;
+            meshIndices->append(a);
+            meshIndices->append(b);
+            meshIndices->append(a + 1);
+            meshIndices->append(a + 1);
+            meshIndices->append(b);
+            meshIndices->append(b + 1);
+        }
+    }
+}
+
+void AgentRenderer::addSphere(AgentBatch * batch, const ChunkAgent & a,
+        int level) {
+    const QVector<RenderVertex> & mesh = sphereMeshes[level];
+    const QVector<GLuint> & meshIndices = sphereMeshIndices[level];
+
+    GLuint first = batch->vertices.count();
+    for (int i = 0; i < mesh.count(); i++) {
+        RenderVertex v = mesh.at(i);
+        v.x = a.x + v.x * a.sx;
+        v.y = a.y + v.y * a.sx;
+        v.z = a.z + v.z * a.sx;
+        v.r = a.r;
+        v.g = a.g;
+        v.b = a.b;
+        v.a = a.a;
+        batch->vertices.append(v);
+    }
+    for (int i = 0; i < meshIndices.count(); i++)
+        batch->indices.append(first + meshIndices.at(i));
+}
+
+void AgentRenderer::addCube(AgentBatch * batch, const ChunkAgent & a) {
+    /* Corners and normals of the six faces as drawCube drew them */
+    static const float faces[6][4][3] = {
+        {{ 1,  1, -1}, {-1,  1, -1}, {-1,  1,  1}, { 1,  1,  1}},
+        {{ 1, -1,  1}, {-1, -1,  1}, {-1, -1, -1}, { 1, -1, -1}},
+        {{ 1,  1,  1}, {-1,  1,  1}, {-1, -1,  1}, { 1, -1,  1}},
+        {{ 1, -1, -1}, {-1, -1, -1}, {-1,  1, -1}, { 1,  1, -1}},
+        {{-1,  1,  1}, {-1,  1, -1}, {-1, -1, -1}, {-1, -1,  1}},
+        {{ 1,  1, -1}, { 1,  1,  1}, { 1, -1,  1}, { 1, -1, -1}}
+    };
+    static const float normals[6][3] = {
+        {0.0f, 0.5f, 0.0f}, {0.0f, -0.5f, 0.0f}, {0.0f, 0.0f, 0.5f},
+        {0.0f, 0.0f, -0.5f}, {-0.5f, 0.0f, 0.0f}, {0.5f, 0.0f, 0.0f}
+    };
+
+    for (int f = 0; f < 6; f++) {
+        for (int k = 0; k < 4; k++) {
+            RenderVertex v;
+            v.x = a.x + faces[f][k][0] * a.sx;
+            v.y = a.y + faces[f][k][1] * a.sy;
+            v.z = a.z + faces[f][k][2] * a.sz;
+            v.nx = normals[f][0];
+            v.ny = normals[f][1];
+            v.nz = normals[f][2];
+            v.r = a.r;
+            v.g = a.g;
+            v.b = a.b;
+            v.a = a.a;
+            batch->vertices.append(v);
+        }
+    }
+}
+
+/*! \brief Copy a batch into buffer objects if the GL supports them, and
+ *  then free the copy in client memory.
+ */
+void AgentRenderer::upload(AgentBatch * batch) {
+    batch->vertexCount = batch->vertices.count();
+    batch->indexCount = batch->indices.count();
+    if (batch->vertexCount == 0) return;
+
+    if (!batch->vertexBuffer.create()) return;
+    batch->vertexBuffer.setUsagePattern(QGLBuffer::StaticDraw);
+    batch->vertexBuffer.bind();
+    batch->vertexBuffer.allocate(batch->vertices.constData(),
+            batch->vertexCount * sizeof(RenderVertex));
+    batch->vertexBuffer.release();
+
+    if (batch->indexCount > 0) {
+        if (!batch->indexBuffer.create()) {
+            batch->vertexBuffer.destroy();
+            return;
+        }
+        /* The agents of transparent batches are sorted again */
+        batch->indexBuffer.setUsagePattern(batch->transparent ?
+                QGLBuffer::DynamicDraw : QGLBuffer::StaticDraw);
+        batch->indexBuffer.bind();
+        batch->indexBuffer.allocate(batch->indices.constData(),
+                batch->indexCount * sizeof(GLuint));
+        batch->indexBuffer.release();
+    }
+
+    batch->buffered = true;
+    batch->vertices.clear();
+    batch->indices.clear();
+}
+
+/*! \brief Draw the chunks inside the view frustum, opaque first and then
+ *  transparent from back to front without writing depth.
+ *  \param light True if lighting is used
+ *  \param frustum The six frustum planes of the current modelview and
+ *  projection
+ */
+void AgentRenderer::draw(bool light, const float frustum[6][4]) {
+    float modelview[16];
+    float projection[16];
+    GLint viewport[4];
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    /* Only a new view changes the order */
+    if (!transparentChunks.isEmpty() && (!sorted ||
+            memcmp(sortedView, modelview, sizeof(sortedView)) != 0)) {
+        sortBackToFront(&transparentChunks, modelview);
+        memcpy(sortedView, modelview, sizeof(sortedView));
+        sorted = true;
+        viewGeneration++;
+    }
+
+    frame++;
+    drawnVertices = 0;
+    drawnChunks = 0;
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
+    glEnable(GL_COLOR_MATERIAL);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+    glDisable(GL_BLEND);
+
+    int opaqueCount = opaqueChunks.count();
+    for (int i = 0; i < opaqueCount + transparentChunks.count(); i++) {
+        if (i == opaqueCount) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            /* Hidden by opaque agents but not by each other */
+            glDepthMask(GL_FALSE);
+        }
+        AgentChunk * chunk = (i < opaqueCount) ? opaqueChunks.at(i) :
+                transparentChunks.at(i - opaqueCount);
+        AgentBatch * batch = visibleLevel(chunk, frustum, modelview,
+                projection, viewport[3]);
+        if (batch == 0 || batch->vertexCount == 0) continue;
+
+        if (batch->primitive == GL_POINTS) {
+            glDisable(GL_LIGHTING);
+            glPointSize(batch->pointSize);
+            drawBatch(batch);
+            if (light) glEnable(GL_LIGHTING);
+        } else {
+            glEnable(GL_CULL_FACE);
+            drawBatch(batch);
+            glDisable(GL_CULL_FACE);
+        }
+    }
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_COLOR_MATERIAL);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    evict();
+}
+
+/*! \brief The batch to draw a chunk with, built if needed.  The agents of
+ *  a transparent chunk are sorted back to front first if the view changed.
+ *  \return 0 if the chunk is outside the view frustum
+ */
+AgentBatch * AgentRenderer::visibleLevel(AgentChunk * chunk,
+        const float frustum[6][4], const float modelview[16],
+        const float projection[16], int viewportHeight) {
+    if (!sphereInFrustum(frustum, chunk->centre, chunk->radius)) return 0;
+    int level = chooseLevel(chunk, modelview, projection, viewportHeight);
+    if (chunk->transparent && chunk->sortedView != viewGeneration)
+        sortAgents(chunk, modelview);
+    if (chunk->levels[level] == 0) {
+        chunk->levels[level] = buildLevel(chunk, level);
+        cachedVertices += chunk->levels[level]->vertexCount;
+    } else if (chunk->transparent &&
+            chunk->levels[level]->orderVersion != chunk->orderVersion) {
+        orderBatch(chunk->levels[level], chunk, level);
+    }
+    chunk->lastDrawn[level] = frame;
+    drawnVertices += chunk->levels[level]->vertexCount;
+    drawnChunks++;
+    return chunk->levels[level];
+}
+
+/*! \brief Sort the agents of a transparent chunk from the furthest to the
+ *  nearest for the current view.
+ *  \param chunk The chunk
+ *  \param modelview The modelview matrix
+ */
+void AgentRenderer::sortAgents(AgentChunk * chunk,
+        const float modelview[16]) {
+    QVector<QPair<float, int> > depths(chunk->agents.count());
+    for (int i = 0; i < chunk->agents.count(); i++) {
+        const ChunkAgent & a = chunk->agents.at(i);
+        depths[i] = qMakePair(modelview[2] * a.x + modelview[6] * a.y +
+                modelview[10] * a.z + modelview[14], i);
+    }
+    qSort(depths);
+
+    QVector<int> order(depths.count());
+    for (int i = 0; i < depths.count(); i++) order[i] = depths.at(i).second;
+    chunk->sortedView = viewGeneration;
+    if (order == chunk->order) return;
+    chunk->order = order;
+    chunk->orderVersion++;
+}
+
+/*! \brief Set the indices of a transparent batch to draw its agents in
+ *  the order of its chunk, rewriting its index buffer if uploaded.
+ *  \param batch The batch
+ *  \param chunk The chunk of the batch
+ *  \param level The level of the batch
+ */
+void AgentRenderer::orderBatch(AgentBatch * batch, const AgentChunk * chunk,
+        int level) {
+    batch->orderVersion = chunk->orderVersion;
+    if (chunk->order.isEmpty()) return;
+
+    /* The indices of one agent and its number of vertices */
+    QVector<GLuint> pattern;
+    GLuint stride;
+    if (batch->primitive == GL_TRIANGLES) {
+        pattern = sphereMeshIndices[level];
+        stride = sphereMeshes[level].count();
+    } else {
+        stride = (batch->primitive == GL_QUADS) ? 24 : 1;
+        for (GLuint i = 0; i < stride; i++) pattern.append(i);
+    }
+
+    QVector<GLuint> ordered;
+    ordered.reserve(chunk->order.count() * pattern.count());
+    for (int k = 0; k < chunk->order.count(); k++) {
+        GLuint first = chunk->order.at(k) * stride;
+        for (int i = 0; i < pattern.count(); i++)
+            ordered.append(first + pattern.at(i));
+    }
+
+    if (batch->buffered) {
+        /* Only uploaded with an index buffer if it had indices */
+        if (batch->indexCount != ordered.count()) return;
+        batch->indexBuffer.bind();
+        batch->indexBuffer.write(0, ordered.constData(),
+                ordered.count() * sizeof(GLuint));
+        batch->indexBuffer.release();
+    } else {
+        batch->indices = ordered;
+        batch->indexCount = ordered.count();
+    }
+}
+
+/*! \brief Sort chunks from the furthest to the nearest centre.
+ *
+ * An insertion sort, quick when the chunks are still nearly in order from
+ * the last view, and stable so chunks at the same depth keep their order.
+ *  \param sortChunks The chunks
+ *  \param modelview The modelview matrix
+ */
+void AgentRenderer::sortBackToFront(QList<AgentChunk *> * sortChunks,
+        const float modelview[16]) {
+    for (int i = 0; i < sortChunks->count(); i++) {
+        AgentChunk * chunk = sortChunks->at(i);
+        /* The eye looks down -z so the furthest has the lowest z */
+        chunk->depth = modelview[2] * chunk->centre[0] +
+                modelview[6] * chunk->centre[1] +
+                modelview[10] * chunk->centre[2] + modelview[14];
+    }
+    for (int i = 1; i < sortChunks->count(); i++) {
+        AgentChunk * chunk = sortChunks->at(i);
+        int j = i;
+        while (j > 0 && sortChunks->at(j - 1)->depth > chunk->depth) {
+            (*sortChunks)[j] = sortChunks->at(j - 1);
+            j--;
+        }
+        (*sortChunks)[j] = chunk;
+    }
+}
+
+/*! \brief Free the levels not drawn in the last frame if the built levels
+ *  hold too many vertices, the GL context must be current.
+ */
+void AgentRenderer::evict() {
+    if (cachedVertices <= cacheVertexBudget) return;
+    for (int i = 0; i < chunks.count(); i++) {
+        AgentChunk * chunk = chunks.at(i);
+        for (int l = 0; l < AgentChunk::levelCount; l++) {
+            if (chunk->levels[l] == 0 || chunk->lastDrawn[l] == frame)
+                continue;
+            cachedVertices -= chunk->levels[l]->vertexCount;
+            delete chunk->levels[l];
+            chunk->levels[l] = 0;
+        }
+    }
+}
+
+void AgentRenderer::drawBatch(AgentBatch * batch) {
+    const char * base = 0;
+    if (batch->buffered)
+        batch->vertexBuffer.bind();
+    else
+        base = reinterpret_cast<const char *>(batch->vertices.constData());
+
+    glVertexPointer(3, GL_FLOAT, sizeof(RenderVertex),
+            base + offsetof(RenderVertex, x));
+    glNormalPointer(GL_FLOAT, sizeof(RenderVertex),
+            base + offsetof(RenderVertex, nx));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(RenderVertex),
+            base + offsetof(RenderVertex, r));
+
+    if (batch->buffered && batch->indexCount > 0) batch->indexBuffer.bind();
+    if (batch->transparent && batch->primitive != GL_POINTS) {
+        /* Back faces behind front faces, drawn while the batch is bound */
+        glCullFace(GL_FRONT);
+        drawPrimitives(batch);
+    }
+    glCullFace(GL_BACK);
+    drawPrimitives(batch);
+    if (batch->buffered && batch->indexCount > 0) batch->indexBuffer.release();
+
+    if (batch->buffered) batch->vertexBuffer.release();
+}
+
+/*! \brief Draw a batch whose vertex and index arrays are set.
+ */
+void AgentRenderer::drawPrimitives(const AgentBatch * batch) {
+    if (batch->indexCount > 0)
+        glDrawElements(batch->primitive, batch->indexCount, GL_UNSIGNED_INT,
+                batch->buffered ? 0 : batch->indices.constData());
+    else
+        glDrawArrays(batch->primitive, 0, batch->vertexCount);
+}
@@ -0,0 +1,161 @@
+/*!
+ * \file agentrenderer.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for agent renderer
+ */
+#ifndef AGENTRENDERER_H_
+#define AGENTRENDERER_H_
+
+#include <QGLBuffer>
+#include <QList>
+#include <QVector>
+#include "./visualsettingsmodel.h"
+#include "./dimension.h"
+
+/*! \brief One vertex of a batch, interleaved for vertex arrays */
+struct RenderVertex {
+    GLfloat x, y, z;
+    GLfloat nx, ny, nz;
+    GLubyte r, g, b, a;
+};
+
+/*! \brief Every agent of one rule drawn with one primitive in one call */
+class AgentBatch {
+  public:
+    AgentBatch();
+
+    GLenum primitive;  /*!< \brief GL_TRIANGLES, GL_QUADS or GL_POINTS */
+    bool transparent;
+    float pointSize;
+    QVector<RenderVertex> vertices;
+    QVector<GLuint> indices;  /*!< \brief Used by spheres only */
+    int vertexCount;
+    int indexCount;
+    bool buffered;  /*!< \brief True if drawn from buffer objects */
+    /*! \brief The chunk agent order of the indices, -1 for build order */
+    int orderVersion;
+    QGLBuffer vertexBuffer;
+    QGLBuffer indexBuffer;
+};
+
+/*! \brief One agent of a chunk, what is needed to build any level */
+struct ChunkAgent {
+    GLfloat x, y, z;
+    GLfloat sx, sy, sz;  /*!< \brief Half size, sx is the sphere radius */
+    GLubyte r, g, b, a;
+};
+
+/*! \brief The agents of one rule in one cell of space.
+ *
+ * A chunk is culled as a whole against the view frustum and drawn at one
+ * level of detail, chosen from the projected size of its largest agent.
+ * The batch of each level is built the first time the level is drawn.
+ */
+class AgentChunk {
+  public:
+    enum Shape { Sphere, Cube, Point };
+    /*! \brief Level 0 draws every agent as a point, level n a sphere of
+     *  detail 2 to the power n + 1 or a cube */
+    static const int levelCount = 6;
+
+    AgentChunk();
+    ~AgentChunk();
+
+    Shape shape;
+    bool transparent;
+    float pointSize;
+    QVector<ChunkAgent> agents;
+    float centre[3];  /*!< \brief Bounding sphere centre */
+    float radius;  /*!< \brief Bounding sphere radius */
+    float largest;  /*!< \brief Largest agent half size */
+    float depth;  /*!< \brief Eye z of the centre when last sorted */
+    /*! \brief Transparent agents back to front for the sorted view */
+    QVector<int> order;
+    int orderVersion;  /*!< \brief Changed every time order changes */
+    int sortedView;  /*!< \brief The view generation order is for */
+    AgentBatch * levels[levelCount];
+    int lastDrawn[levelCount];  /*!< \brief The frame each level was drawn */
+};
+
+/*! \brief Draws the agents of the visual rules from vertex buffers.
+ *
+ * When the iteration, the rules or the axes restriction change the rule
+ * agents are sorted into chunks, one per rule (and point size) and cell of
+ * a grid over the agents.  Each frame the chunks outside the view frustum
+ * are skipped and the rest are drawn at a level of detail from the pixel
+ * radius of their largest agent: spheres as an indexed mesh of 4 to 64
+ * slices, cubes as quads, and agents under a pixel as points.  The batch
+ * of a level is built when first drawn and uploaded to a buffer object if
+ * the GL supports them, otherwise drawn from client memory.  The fixed
+ * function pipeline used by the visual window has no instancing so spheres
+ * and cubes are pretransformed.  Levels not drawn recently are freed when
+ * the batches hold too many vertices.
+ *
+ * Opaque and transparent chunks are kept apart when built, so a frame goes
+ * once over the opaque chunks and then the transparent ones, which are
+ * drawn without writing depth, back faces and then front faces.  When the
+ * view has changed the transparent chunks are sorted back to front by an
+ * insertion sort of the last order, as a small camera move leaves it
+ * nearly sorted.  The agents of a transparent chunk are sorted when it is
+ * next drawn and its batch indices rewritten in that order.
+ */
+class AgentRenderer {
+  public:
+    AgentRenderer();
+    ~AgentRenderer();
+
+    void invalidate() { valid = false; }
+    bool needsBuild(const Dimension * limits) const;
+    void build(VisualSettingsModel * model, const Dimension * limits);
+    void draw(bool light, const float frustum[6][4]);
+    void clear();
+    int vertexCount() const { return drawnVertices; }
+    int chunkCount() const { return chunks.count(); }
+    int drawnChunkCount() const { return drawnChunks; }
+
+    static void sortBackToFront(QList<AgentChunk *> * sortChunks,
+            const float modelview[16]);
+
+  private:
+    void addChunks(const QList<RuleAgent *> & ruleAgents,
+            AgentChunk::Shape shape, bool transparent, float pointSize,
+            const QColor & colour, const Dimension * limits);
+    int chooseLevel(const AgentChunk * chunk, const float modelview[16],
+            const float projection[16], int viewportHeight) const;
+    AgentBatch * visibleLevel(AgentChunk * chunk, const float frustum[6][4],
+            const float modelview[16], const float projection[16],
+            int viewportHeight);
+    AgentBatch * buildLevel(const AgentChunk * chunk, int level);
+    void addSphere(AgentBatch * batch, const ChunkAgent & a, int level);
+    void addCube(AgentBatch * batch, const ChunkAgent & a);
+    void upload(AgentBatch * batch);
+    void drawBatch(AgentBatch * batch);
+    static void drawPrimitives(const AgentBatch * batch);
+    void sortAgents(AgentChunk * chunk, const float modelview[16]);
+    void orderBatch(AgentBatch * batch, const AgentChunk * chunk, int level);
+    void evict();
+    static bool sphereInFrustum(const float frustum[6][4], const float c[3],
+            float radius);
+    static void sphereMesh(int detail, QVector<RenderVertex> * mesh,
+            QVector<GLuint> * meshIndices);
+    QList<AgentChunk *> chunks;
+    QList<AgentChunk *> opaqueChunks;
+    /*! \brief Back to front for the sorted view */
+    QList<AgentChunk *> transparentChunks;
+    float sortedView[16];  /*!< \brief The modelview last sorted for */
+    bool sorted;  /*!< \brief True if sortedView is set */
+    int viewGeneration;  /*!< \brief Changed every time the view changes */
+    QVector<RenderVertex> sphereMeshes[AgentChunk::levelCount];
+    QVector<GLuint> sphereMeshIndices[AgentChunk::levelCount];
+    int frame;  /*!< \brief The number of frames drawn */
+    int cachedVertices;  /*!< \brief Vertices held by all built levels */
+    int drawnVertices;  /*!< \brief Vertices drawn in the last frame */
+    int drawnChunks;  /*!< \brief Chunks drawn in the last frame */
+    bool valid;
+    bool restricted;  /*!< \brief True if built with the axes restricted */
+    Dimension restriction;  /*!< \brief The axes restriction built with */
+};
+
+#endif  // AGENTRENDERER_H_
@@ -0,0 +1,165 @@
+/*!
+ * \file agentstore.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of agent store
+ */
+#include "./agentstore.h"
+
+/*! \brief Add a memory variable column, filled with zero for existing agents.
+ *  \param variable The variable name
+ *  \return The column index of the variable
+ */
+int AgentColumns::addVariable(const QString & variable) {
+    int index = variableIndex(variable);
+    if (index != -1) return index;
+
+    index = variables.count();
+    variables.append(variable);
+    indices.insert(variable, index);
+    columns.append(QVector<double>(count, 0.0));
+    texts.append(QHash<int, QString>());
+    return index;
+}
+
+/*! \brief Add a row for a new agent with every variable set to zero.
+ *  \return The row of the new agent
+ */
+int AgentColumns::appendAgent() {
+    for (int i = 0; i < columns.count(); i++)
+        columns[i].append(0.0);
+    return count++;
+}
+
+/*! \brief Note a variable that was not read.
+ *  \param variable The variable name
+ */
+void AgentColumns::addSkipped(const QString & variable) {
+    if (!skipped.contains(variable)) skipped.append(variable);
+}
+
+/*! \brief Set a value from the text read in from an iteration file.
+ *  \param variable The column index
+ *  \param row The agent row
+ *  \param text The value text
+ */
+void AgentColumns::setValue(int variable, int row, const QString & text) {
+    bool ok;
+    double d = text.toDouble(&ok);
+    /* Non numbers are zero as before, keep the text for display */
+    columns[variable][row] = d;
+    if (!ok) texts[variable].insert(row, text);
+}
+
+/*! \brief The value as text for display.
+ *  \param variable The column index
+ *  \param row The agent row
+ *  \return The original text if not a number otherwise the number
+ */
+QString AgentColumns::text(int variable, int row) const {
+    QHash<int, QString>::const_iterator i = texts.at(variable).find(row);
+    if (i != texts.at(variable).constEnd()) return i.value();
+    return QString::number(value(variable, row), 'g', 15);
+}
+
+/*! \brief Append the agents of another store of the same agent type.
+ *
+ * Variables not yet known are added after the existing ones in the order
+ * of the other store, so appending the parts of a file in order gives the
+ * same columns as reading the whole file.
+ *  \param other The agents to append
+ */
+void AgentColumns::append(const AgentColumns & other) {
+    QVector<int> map(other.variables.count());
+    for (int i = 0; i < other.variables.count(); i++)
+        map[i] = addVariable(other.variables.at(i));
+
+    int offset = count;
+    count += other.count;
+    for (int i = 0; i < columns.count(); i++)
+        columns[i].resize(count);
+    /* Agents of the other store without a variable have it as zero */
+    QVector<bool> filled(columns.count(), false);
+    for (int i = 0; i < map.count(); i++) {
+        double * to = columns[map.at(i)].data() + offset;
+        const double * from = other.column(i);
+        for (int j = 0; j < other.count; j++) to[j] = from[j];
+        filled[map.at(i)] = true;
+
+        QHash<int, QString>::const_iterator k;
+        for (k = other.texts.at(i).constBegin();
+                k != other.texts.at(i).constEnd(); ++k)
+            texts[map.at(i)].insert(k.key() + offset, k.value());
+    }
+    for (int i = 0; i < columns.count(); i++) {
+        if (filled.at(i)) continue;
+        double * to = columns[i].data() + offset;
+        for (int j = 0; j < other.count; j++) to[j] = 0.0;
+    }
+    if (other.isEnvironment) isEnvironment = true;
+    for (int i = 0; i < other.skipped.count(); i++)
+        addSkipped(other.skipped.at(i));
+}
+
+/*! \brief Remove all agents and agent types.
+ */
+void AgentStore::clear() {
+    types.clear();
+    typeIndices.clear();
+}
+
+/*! \brief Add an agent type if not already known.
+ *  \param name The agent type name
+ *  \return The index of the agent type
+ */
+int AgentStore::addType(const QString & name) {
+    int index = typeIndex(name);
+    if (index != -1) return index;
+
+    index = types.count();
+    types.append(AgentColumns(name));
+    typeIndices.insert(name, index);
+    return index;
+}
+
+/*! \brief Append the agents of another store, adding agent types not yet
+ *  known in the order of the other store.
+ *  \param other The agents to append
+ */
+void AgentStore::append(const AgentStore & other) {
+    for (int t = 0; t < other.typeCount(); t++) {
+        const AgentColumns & columns = other.type(t);
+        int index = typeIndex(columns.name);
+        if (index == -1) {
+            /* New type, share the columns rather than copy them */
+            typeIndices.insert(columns.name, types.count());
+            types.append(columns);
+        } else {
+            types[index].append(columns);
+        }
+    }
+}
+
+/*! \brief The total number of agents of all types.
+ */
+int AgentStore::agentCount() const {
+    int total = 0;
+    for (int i = 0; i < types.count(); i++)
+        total += types.at(i).count;
+    return total;
+}
+
+/*! \brief An estimate of the memory held by the agents in bytes.
+ */
+qint64 AgentStore::memoryUsage() const {
+    qint64 bytes = 0;
+    for (int i = 0; i < types.count(); i++) {
+        const AgentColumns & columns = types.at(i);
+        bytes += static_cast<qint64>(columns.count) *
+                columns.variables.count() * sizeof(double);
+        for (int j = 0; j < columns.texts.count(); j++)
+            bytes += columns.texts.at(j).count() * 64;
+    }
+    return bytes;
+}
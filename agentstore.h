@@ -0,0 +1,91 @@
+/*!
+ * \file agentstore.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for agent store
+ */
+#ifndef AGENTSTORE_H_
+#define AGENTSTORE_H_
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QList>
+
+/*! \brief The memory of every agent of one agent type held as columns.
+ *
+ * Each memory variable of the agent type has one contiguous column of
+ * doubles with one row per agent.  Values that are not numbers (for
+ * example static arrays) are kept as text alongside the column so they can
+ * still be shown in the agent dialog.
+ */
+class AgentColumns {
+  public:
+    AgentColumns() { count = 0; isEnvironment = false; }
+    explicit AgentColumns(QString n) {
+        name = n;
+        count = 0;
+        isEnvironment = false;
+    }
+
+    int variableIndex(const QString & variable) const {
+        return indices.value(variable, -1);
+    }
+    int addVariable(const QString & variable);
+    int appendAgent();
+    void addSkipped(const QString & variable);
+    /*! \brief True if memory variables were skipped when read */
+    bool isProjected() const { return !skipped.isEmpty(); }
+    double value(int variable, int row) const {
+        return columns.at(variable).at(row);
+    }
+    const double * column(int variable) const {
+        return columns.at(variable).constData();
+    }
+    void setValue(int variable, int row, const QString & text);
+    void setValue(int variable, int row, double d) {
+        columns[variable][row] = d;
+    }
+    QString text(int variable, int row) const;
+    void append(const AgentColumns & other);
+
+    QString name;  /*!< \brief The agent type name */
+    QStringList variables;  /*!< \brief The schema, one name per column */
+    QVector<QVector<double> > columns;  /*!< \brief One column per variable */
+    /*! \brief Original text of values that are not numbers */
+    QVector<QHash<int, QString> > texts;
+    int count;  /*!< \brief The number of agents (rows) */
+    bool isEnvironment;
+    /*! \brief Variables skipped when read, known by name only */
+    QStringList skipped;
+
+  private:
+    QHash<QString, int> indices;
+};
+
+/*! \brief The agents of one iteration stored by agent type.
+ */
+class AgentStore {
+  public:
+    AgentStore() {}
+
+    void clear();
+    int typeCount() const { return types.count(); }
+    int typeIndex(const QString & name) const {
+        return typeIndices.value(name, -1);
+    }
+    int addType(const QString & name);
+    AgentColumns & type(int t) { return types[t]; }
+    const AgentColumns & type(int t) const { return types.at(t); }
+    int agentCount() const;
+    qint64 memoryUsage() const;
+    void append(const AgentStore & other);
+
+  private:
+    QList<AgentColumns> types;
+    QHash<QString, int> typeIndices;
+};
+
+#endif  // AGENTSTORE_H_
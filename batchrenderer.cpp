@@ -0,0 +1,268 @@
+/*!
+ * \file batchrenderer.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of batch renderer
+ */
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QThread>
+#include <QGLPixelBuffer>
+#include <QtConcurrentRun>
+#include <stdio.h>
+#include "./batchrenderer.h"
+#include "./configxmlreader.h"
+#include "./graphsettingsmodel.h"
+#include "./timescale.h"
+#include "./iterationloader.h"
+#include "./agentrenderer.h"
+#include "./glwidget.h"
+#include "./imagewriter.h"
+
+BatchRenderer::BatchRenderer(const BatchOptions & o)
+    : options(o), log(stderr) {
+    failedWrites = 0;
+    xoffset = 0.0;
+    yoffset = 0.0;
+    zoffset = 0.0;
+    ratio = 1.0;
+    xrotate = 0.0;
+    yrotate = 0.0;
+    xmove = 0.0;
+    ymove = 0.0;
+    zmove = -3.0;
+    orthoZoom = 1.0;
+    visual_dimension = 3;
+    background = Qt::white;
+}
+
+BatchRenderer::~BatchRenderer() {
+    for (int i = 0; i < scenes.count(); i++) {
+        scenes.at(i)->future.waitForFinished();
+        delete scenes.at(i);
+    }
+    for (int i = 0; i < writes.count(); i++)
+        writes[i].waitForFinished();
+}
+
+/*! \brief Render every iteration of the range to an image file.
+ *  \return 0 success, 1 error opening config, 2 error reading config,
+ *  3 no offscreen rendering, 4 error reading an iteration,
+ *  5 error writing an image, 6 the last iteration is before the first
+ */
+int BatchRenderer::run() {
+    if (options.jobs < 1) options.jobs = qMax(1, QThread::idealThreadCount());
+    if (options.last < options.first) {
+        error = QString("The last iteration %1 is before the first %2").
+                arg(options.last).arg(options.first);
+        return 6;
+    }
+
+    /* One copy of the rules per job */
+    for (int i = 0; i < options.jobs; i++) {
+        BatchScene * scene = new BatchScene();
+        scenes.append(scene);
+        int rc = readConfig(scene->model);
+        if (rc != 0) return rc;
+    }
+
+    outputDirectory = options.outputDirectory;
+    if (outputDirectory.isEmpty())
+        outputDirectory = QFileInfo(options.configFile).absolutePath();
+    if (!QDir().mkpath(outputDirectory)) {
+        error = QString("Cannot create directory %1").arg(outputDirectory);
+        return 5;
+    }
+
+    int rc = calcViewpoint();
+    if (rc != 0) return rc;
+
+    if (!QGLPixelBuffer::hasOpenGLPbuffers()) {
+        error = "Offscreen rendering with pixel buffers is not supported";
+        return 3;
+    }
+    QGLFormat format;
+    format.setDepth(true);
+    QGLPixelBuffer pbuffer(options.width, options.height, format);
+    if (!pbuffer.isValid() || !pbuffer.makeCurrent()) {
+        error = "Cannot create an offscreen pixel buffer";
+        return 3;
+    }
+
+    GLWidget::setupLighting(background);
+    GLWidget::setupProjection(visual_dimension, options.width,
+            options.height, orthoZoom, 0.1f);
+
+    rc = renderAll(&pbuffer);
+    pbuffer.doneCurrent();
+    return rc;
+}
+
+/*! \brief Read the rules, camera and results location of the config file.
+ *  \param model The rules to fill
+ *  \return 0 success, 1 error opening file, 2 error reading file
+ */
+int BatchRenderer::readConfig(VisualSettingsModel * model) {
+    QFile file(options.configFile);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        error = QString("Cannot read file %1:\n%2.").
+                arg(options.configFile).arg(file.errorString());
+        return 1;
+    }
+
+    GraphSettingsModel graphs;
+    TimeScale timeScale;
+    QString resultsData;
+    int delayTime = 0;
+    int prefetchDepth = 0;
+    int prefetchMemory = 0;
+    ConfigXMLReader reader(model, &graphs, &resultsData, &timeScale, &ratio,
+            &xrotate, &yrotate, &xmove, &ymove, &zmove, &delayTime,
+            &orthoZoom, &visual_dimension, &background,
+            &prefetchDepth, &prefetchMemory);
+    if (!reader.read(&file)) {
+        error = QString("Parse error in file %1 at line %2, column %3:\n%4").
+                arg(options.configFile).
+                arg(reader.lineNumber()).
+                arg(reader.columnNumber()).
+                arg(reader.errorString());
+        return 2;
+    }
+
+    resultsDirectory = QFileInfo(file).absolutePath();
+    resultsDirectory.append("/");
+    resultsDirectory.append(resultsData);
+    return 0;
+}
+
+/*! \brief Work out the offset and ratio of the scene from the first
+ *  iteration, as the visual window does when it is opened, so every image
+ *  uses the same viewpoint.
+ *  \return 0 success, 4 error reading the first iteration
+ */
+int BatchRenderer::calcViewpoint() {
+    BatchScene * scene = scenes.first();
+    scene->iteration = options.first;
+    scene->fileName = QString("%1/%2.xml").
+            arg(resultsDirectory).arg(options.first);
+    if (populate(scene, 0.0, 0.0, 0.0, 1.0) != 0) {
+        error = QString("Cannot read iteration file %1").arg(scene->fileName);
+        return 4;
+    }
+    scene->model->calcPositionOffsetAndRatio(&xoffset, &yoffset, &zoffset,
+            &ratio);
+    return 0;
+}
+
+/*! \brief Start reading and populating an iteration on a worker thread.
+ *  \param scene The scene to fill, which must not be in use
+ *  \param iteration The iteration
+ */
+void BatchRenderer::prepare(BatchScene * scene, int iteration) {
+    scene->iteration = iteration;
+    scene->fileName = QString("%1/%2.xml").
+            arg(resultsDirectory).arg(iteration);
+    scene->future = QtConcurrent::run(BatchRenderer::populate, scene,
+            xoffset, yoffset, zoffset, ratio);
+}
+
+/*! \brief Read an iteration and populate the rules of a scene.
+ *  \return The return code of the read, 0 success
+ */
+int BatchRenderer::populate(BatchScene * scene, double xoffset,
+        double yoffset, double zoffset, double ratio) {
+    /* Only the variables the rules use are read */
+    AgentProjection projection(false);
+    for (int i = 0; i < scene->model->rowCount(); i++)
+        projection.addRule(scene->model->getRule(i));
+    delete scene->data;
+    scene->data = IterationLoader::load(scene->fileName,
+            scene->iteration, projection);
+    scene->model->populate(&scene->data->agents, &scene->dimension,
+            xoffset, yoffset, zoffset, ratio);
+    return scene->data->rc;
+}
+
+/*! \brief Draw every iteration in order while the following ones are
+ *  prepared, one per scene.
+ *  \param pbuffer The current offscreen buffer to draw into
+ */
+int BatchRenderer::renderAll(QGLPixelBuffer * pbuffer) {
+    int count = options.last - options.first + 1;
+    int next = options.first;
+    for (int i = 0; i < scenes.count() && next <= options.last; i++)
+        prepare(scenes.at(i), next++);
+
+    AgentRenderer renderer;
+    float frustum[6][4];
+    int rc = 0;
+    for (int i = 0; i < count; i++) {
+        BatchScene * scene = scenes.at(i % scenes.count());
+        int iteration = scene->iteration;
+        if (scene->future.result() != 0) {
+            log << QString("Cannot read iteration file %1.xml").
+                    arg(iteration) << endl;
+            rc = 4;
+        } else {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glLoadIdentity();
+            GLWidget::setupCamera(xrotate, yrotate, xmove, ymove, zmove);
+            GLWidget::ExtractFrustum(frustum);
+            renderer.invalidate();
+            renderer.build(scene->model, 0);
+            renderer.draw(true, frustum);
+            glFinish();
+            writeImage(pbuffer->toImage(), iteration);
+        }
+
+        /* The scene has been drawn so can take the next iteration */
+        if (next <= options.last) prepare(scene, next++);
+    }
+    renderer.clear();
+
+    finishWrites(0);
+    if (rc == 4) {
+        error = "Some iteration files could not be read";
+    } else if (failedWrites > 0) {
+        error = QString("%1 images could not be written to %2").
+                arg(failedWrites).arg(outputDirectory);
+        rc = 5;
+    }
+    return rc;
+}
+
+/*! \brief Write an image on a worker thread, waiting for the oldest write
+ *  if as many are pending as there are jobs.
+ */
+void BatchRenderer::writeImage(const QImage & image, int iteration) {
+    QString fileName = QString("%1/%2.%3").arg(outputDirectory).
+            arg(iteration).arg(options.format);
+    writes.append(QtConcurrent::run(ImageWriter::save, image, fileName,
+            static_cast<QString *>(0)));
+    writeFiles.append(fileName);
+    finishWrites(options.jobs);
+}
+
+/*! \brief Wait for image writes until no more than some are pending,
+ *  logging each against its file and counting those that failed.
+ *  \param pending The writes left running
+ *  \return 0 success, 5 error writing an image
+ */
+int BatchRenderer::finishWrites(int pending) {
+    int rc = 0;
+    while (writes.count() > pending) {
+        QString fileName = writeFiles.takeFirst();
+        if (writes.takeFirst().result()) {
+            log << QString("Rendered %1").arg(fileName) << endl;
+        } else {
+            log << QString("Cannot write image file %1").arg(fileName) <<
+                    endl;
+            failedWrites++;
+            rc = 5;
+        }
+    }
+    return rc;
+}
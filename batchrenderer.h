@@ -0,0 +1,121 @@
+/*!
+ * \file batchrenderer.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for batch renderer
+ */
+#ifndef BATCHRENDERER_H_
+#define BATCHRENDERER_H_
+
+#include <QString>
+#include <QColor>
+#include <QList>
+#include <QStringList>
+#include <QFuture>
+#include <QTextStream>
+#include <QImage>
+#include "./visualsettingsmodel.h"
+#include "./iterationdata.h"
+#include "./dimension.h"
+
+class QGLPixelBuffer;
+
+/*! \brief The settings of a batch render given on the command line */
+struct BatchOptions {
+    BatchOptions() {
+        first = 0;
+        last = 0;
+        width = 800;
+        height = 800;
+        jobs = 0;
+        format = "jpg";
+    }
+
+    QString configFile;  /*!< \brief The config file of the visual rules */
+    int first;  /*!< \brief The first iteration to render */
+    int last;  /*!< \brief The last iteration to render */
+    /*! \brief The directory of the images, the config directory if empty */
+    QString outputDirectory;
+    int width;  /*!< \brief The image width in pixels */
+    int height;  /*!< \brief The image height in pixels */
+    int jobs;  /*!< \brief Iterations prepared at once, 0 for the cores */
+    QString format;  /*!< \brief jpg, png or ppm */
+};
+
+/*! \brief One iteration being read and turned into rule agents.
+ *
+ * Each scene has its own copy of the visual rules so several iterations
+ * can be populated at once on worker threads.
+ */
+class BatchScene {
+  public:
+    BatchScene() {
+        model = new VisualSettingsModel();
+        data = 0;
+        iteration = -1;
+    }
+    ~BatchScene() {
+        delete data;
+        delete model;
+    }
+
+    VisualSettingsModel * model;  /*!< \brief The rules of this scene */
+    IterationData * data;  /*!< \brief The agents read */
+    Dimension dimension;  /*!< \brief The agent scene dimension */
+    int iteration;  /*!< \brief The iteration of the scene */
+    QString fileName;  /*!< \brief The iteration file */
+    QFuture<int> future;  /*!< \brief The read and populate */
+};
+
+/*! \brief Renders a range of iterations to image files without a window.
+ *
+ * The rules and camera of a config file are drawn into an offscreen pixel
+ * buffer with the renderer of the visual window.  The next iterations are
+ * read and populated on worker threads while the current one is drawn and
+ * the images are written on worker threads too.  Images are always drawn
+ * in iteration order, so the output is the same whatever the number of
+ * jobs.
+ */
+class BatchRenderer {
+  public:
+    explicit BatchRenderer(const BatchOptions & o);
+    ~BatchRenderer();
+
+    int run();
+    QString errorString() const { return error; }
+
+  private:
+    int readConfig(VisualSettingsModel * model);
+    int calcViewpoint();
+    void prepare(BatchScene * scene, int iteration);
+    int renderAll(QGLPixelBuffer * pbuffer);
+    void writeImage(const QImage & image, int iteration);
+    int finishWrites(int pending);
+    static int populate(BatchScene * scene, double xoffset, double yoffset,
+            double zoffset, double ratio);
+    BatchOptions options;
+    QString error;  /*!< \brief The reason run failed */
+    QTextStream log;  /*!< \brief Progress is written to standard error */
+    QList<BatchScene *> scenes;
+    QList<QFuture<bool> > writes;  /*!< \brief Images being written */
+    QStringList writeFiles;  /*!< \brief The file of each write */
+    int failedWrites;  /*!< \brief Images that could not be written */
+    QString resultsDirectory;
+    QString outputDirectory;
+    /* Camera and scene read from the config file */
+    double xoffset;
+    double yoffset;
+    double zoffset;
+    double ratio;
+    float xrotate;
+    float yrotate;
+    float xmove;
+    float ymove;
+    float zmove;
+    float orthoZoom;
+    int visual_dimension;
+    QColor background;
+};
+
+#endif  // BATCHRENDERER_H_
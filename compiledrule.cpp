@@ -0,0 +1,95 @@
+/*!
+ * \file compiledrule.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of compiled rule
+ */
+#include "./compiledrule.h"
+#include "./visualsettingsitem.h"
+
+/*! \brief Resolve a variable to its column, null if unused or missing.
+ */
+static const double * resolveColumn(const AgentColumns & columns,
+        bool use, const QString & variable) {
+    if (!use) return 0;
+    int index = columns.variableIndex(variable);
+    if (index == -1) return 0;
+    return columns.column(index);
+}
+
+/*! \brief Compile a rule for the agents held in a store.
+ *  \param rule The visual rule
+ *  \param store The agents of the iteration
+ */
+CompiledRule::CompiledRule(VisualSettingsItem * rule,
+        const AgentStore & store) {
+    Condition condition = rule->condition();
+    Position px = rule->x();
+    Position py = rule->y();
+    Position pz = rule->z();
+    Shape shape = rule->shape();
+
+    type = store.typeIndex(rule->agentType());
+    count = 0;
+    isPoint = (shape.getShape() == "point");
+    conditionEnabled = condition.enable;
+    op = condition.getOperator();
+    conditionValue = condition.value;
+    x = px.opValue;
+    y = py.opValue;
+    z = pz.opValue;
+    d = shape.getDimension();
+    dy = shape.getDimensionY();
+    dz = shape.getDimensionZ();
+    fromCentreX = shape.getFromCentreX();
+    fromCentreY = shape.getFromCentreY();
+    fromCentreZ = shape.getFromCentreZ();
+    conditionColumn = 0;
+    xColumn = 0;
+    yColumn = 0;
+    zColumn = 0;
+    dColumn = 0;
+    dyColumn = 0;
+    dzColumn = 0;
+
+    if (type == -1) return;
+
+    const AgentColumns & columns = store.type(type);
+    count = columns.count;
+    conditionColumn = resolveColumn(columns, condition.enable,
+            condition.variable);
+    xColumn = resolveColumn(columns, px.useVariable, px.positionVariable);
+    yColumn = resolveColumn(columns, py.useVariable, py.positionVariable);
+    zColumn = resolveColumn(columns, pz.useVariable, pz.positionVariable);
+    dColumn = resolveColumn(columns, shape.getUseVariable(),
+            shape.getDimensionVariable());
+    dyColumn = resolveColumn(columns, shape.getUseVariableY(),
+            shape.getDimensionVariableY());
+    dzColumn = resolveColumn(columns, shape.getUseVariableZ(),
+            shape.getDimensionVariableZ());
+}
+
+/*! \brief Calculate the model space position and size of an agent.
+ *  \param row The agent row
+ *  \param ruleagent The rule agent to set
+ */
+void CompiledRule::drawData(int row, RuleAgent * ruleagent) const {
+    ruleagent->x = x;
+    ruleagent->y = y;
+    ruleagent->z = z;
+    ruleagent->shapeDimension  = d;
+    ruleagent->shapeDimensionY = dy;
+    ruleagent->shapeDimensionZ = dz;
+
+    if (xColumn)  ruleagent->x += xColumn[row];
+    if (yColumn)  ruleagent->y += yColumn[row];
+    if (zColumn)  ruleagent->z += zColumn[row];
+    if (dColumn)  ruleagent->shapeDimension  += dColumn[row];
+    if (dyColumn) ruleagent->shapeDimensionY += dyColumn[row];
+    if (dzColumn) ruleagent->shapeDimensionZ += dzColumn[row];
+
+    if (fromCentreX) ruleagent->shapeDimension  *= 2.0;
+    if (fromCentreY) ruleagent->shapeDimensionY *= 2.0;
+    if (fromCentreZ) ruleagent->shapeDimensionZ *= 2.0;
+}
@@ -0,0 +1,56 @@
+/*!
+ * \file compiledrule.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for compiled rule
+ */
+#ifndef COMPILEDRULE_H_
+#define COMPILEDRULE_H_
+
+#include "./agentstore.h"
+#include "./condition.h"
+#include "./ruleagent.h"
+
+class VisualSettingsItem;
+
+/*! \brief A visual rule resolved against the agents of one iteration.
+ *
+ * The agent type and every variable the rule uses are resolved to columns
+ * of the AgentStore and the condition operator to an enum, so evaluating
+ * an agent needs no string comparisons.
+ */
+class CompiledRule {
+  public:
+    CompiledRule(VisualSettingsItem * rule, const AgentStore & store);
+
+    /*! \brief True if the agent in row passes the rule condition */
+    bool pass(int row) const {
+        if (!conditionEnabled) return true;
+        if (conditionColumn == 0) return false;
+        return Condition::compare(op, conditionColumn[row], conditionValue);
+    }
+    void drawData(int row, RuleAgent * ruleagent) const;
+
+    int type;  /*!< \brief The agent type index, -1 if none in the store */
+    int count;  /*!< \brief The number of agents of the type */
+    bool isPoint;  /*!< \brief Points are not scaled by the ratio */
+
+  private:
+    bool conditionEnabled;
+    Condition::Operator op;
+    double conditionValue;
+    /* Columns used by the rule, null if not used or missing */
+    const double * conditionColumn;
+    const double * xColumn;
+    const double * yColumn;
+    const double * zColumn;
+    const double * dColumn;
+    const double * dyColumn;
+    const double * dzColumn;
+    double x, y, z;
+    double d, dy, dz;
+    bool fromCentreX, fromCentreY, fromCentreZ;
+};
+
+#endif  // COMPILEDRULE_H_
@@ -28,6 +28,19 @@ QString Condition::getString() const {
     return text;
 }
 
+/*! \brief Resolve the operator string to an Operator.
+ *  \return The operator, Unknown if not recognised
+ */
+Condition::Operator Condition::getOperator() const {
+    if (op == "==") return Equal;
+    if (op == "!=") return NotEqual;
+    if (op == ">")  return Greater;
+    if (op == "<")  return Less;
+    if (op == ">=") return GreaterEqual;
+    if (op == "<=") return LessEqual;
+    return Unknown;
+}
+
 void Condition::paint(QPainter *painter, const QRect &rect,
                        const QPalette &/*palette*/, EditMode /*mode*/) const {
     painter->save();
@@ -14,9 +14,26 @@
 class Condition {
   public:
     enum EditMode { Editable, ReadOnly };
+    /*! \brief The comparison operators, Unknown never passes */
+    enum Operator { Equal, NotEqual, Greater, Less, GreaterEqual, LessEqual,
+                    Unknown };
 
     Condition();
     QString getString() const;
+    Operator getOperator() const;
+    /*! \brief Compare a value against the condition value with an operator
+     *  resolved once by getOperator() */
+    static bool compare(Operator o, double lhs, double rhs) {
+        switch (o) {
+            case Equal:        return lhs == rhs;
+            case NotEqual:     return lhs != rhs;
+            case Greater:      return lhs >  rhs;
+            case Less:         return lhs <  rhs;
+            case GreaterEqual: return lhs >= rhs;
+            case LessEqual:    return lhs <= rhs;
+            default:           return false;
+        }
+    }
     void paint(QPainter *painter, const QRect &rect,
                         const QPalette &palette, EditMode mode) const;
 
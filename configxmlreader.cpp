@@ -14,7 +14,8 @@
 ConfigXMLReader::ConfigXMLReader(VisualSettingsModel *vsm,
         GraphSettingsModel *gsm, QString *rD, TimeScale * ts, double *r,
              float * xr, float *yr, float *xm, float * ym, float * zm,
-             int * delay, float * oz, int * vd, QColor * vbg) {
+             int * delay, float * oz, int * vd, QColor * vbg,
+             int * pd, int * pm) {
     vsmodel = vsm;
     gsmodel = gsm;
     resultsData = rD;
@@ -29,6 +30,8 @@ ConfigXMLReader::ConfigXMLReader(VisualSettingsModel *vsm,
     orthoZoom = oz;
     visual_dimension = vd;
     backgroundColour = vbg;
+    prefetchDepth = pd;
+    prefetchMemory = pm;
 }
 
 bool ConfigXMLReader::read(QIODevice * device) {
@@ -175,6 +178,10 @@ void ConfigXMLReader::readAnimation() {
          if (isStartElement()) {
              if (name() == "delay") {
                  *delayTime = readElementText().toInt();
+             } else if (name() == "prefetchDepth") {
+                 *prefetchDepth = readElementText().toInt();
+             } else if (name() == "prefetchMemory") {
+                 *prefetchMemory = readElementText().toInt();
              } else {
                  readUnknownElement();
              }
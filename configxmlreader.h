@@ -20,7 +20,8 @@ class ConfigXMLReader : public QXmlStreamReader {
     ConfigXMLReader(VisualSettingsModel * vsm, GraphSettingsModel * gsm,
         QString * rD, TimeScale * ts, double * r,
         float * xr, float *yr, float *xm, float * ym, float * zm,
-        int * delay, float * oz, int * vd, QColor *vbg);
+        int * delay, float * oz, int * vd, QColor *vbg,
+        int * pd, int * pm);
 
     bool read(QIODevice * device);
 
@@ -58,6 +59,8 @@ class ConfigXMLReader : public QXmlStreamReader {
     float * orthoZoom;
     int * visual_dimension;
     QColor * backgroundColour;
+    int * prefetchDepth;
+    int * prefetchMemory;
 };
 
 #endif  // CONFIGXMLREADER_H_
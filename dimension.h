@@ -25,6 +25,52 @@ class Dimension {
         zmaxon = false;
     }
 
+    /*! \brief Reset to an empty range ready to be expanded */
+    void reset() {
+        xmin =  999999.9;
+        xmax = -999999.9;
+        ymin =  999999.9;
+        ymax = -999999.9;
+        zmin =  999999.9;
+        zmax = -999999.9;
+    }
+
+    /*! \brief Expand the range to include a point */
+    void expand(double x, double y, double z) {
+        if (xmin > x) xmin = x;
+        if (xmax < x) xmax = x;
+        if (ymin > y) ymin = y;
+        if (ymax < y) ymax = y;
+        if (zmin > z) zmin = z;
+        if (zmax < z) zmax = z;
+    }
+
+    /*! \brief Expand the range to include another range */
+    void merge(const Dimension & d) {
+        if (xmin > d.xmin) xmin = d.xmin;
+        if (xmax < d.xmax) xmax = d.xmax;
+        if (ymin > d.ymin) ymin = d.ymin;
+        if (ymax < d.ymax) ymax = d.ymax;
+        if (zmin > d.zmin) zmin = d.zmin;
+        if (zmax < d.zmax) zmax = d.zmax;
+    }
+
+    bool operator==(const Dimension & d) const {
+        return xmin == d.xmin && xmax == d.xmax && ymin == d.ymin &&
+                ymax == d.ymax && zmin == d.zmin && zmax == d.zmax &&
+                xminon == d.xminon && xmaxon == d.xmaxon &&
+                yminon == d.yminon && ymaxon == d.ymaxon &&
+                zminon == d.zminon && zmaxon == d.zmaxon;
+    }
+    bool operator!=(const Dimension & d) const { return !(*this == d); }
+
+    /*! \brief True if a point is inside the enabled limits */
+    bool contains(double x, double y, double z) const {
+        return (!xminon || x > xmin) && (!xmaxon || x < xmax) &&
+                (!yminon || y > ymin) && (!ymaxon || y < ymax) &&
+                (!zminon || z > zmin) && (!zmaxon || z < zmax);
+    }
+
     double xmin;
     double xmax;
     double ymin;
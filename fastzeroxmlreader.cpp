@@ -0,0 +1,385 @@
+/*!
+ * \file fastzeroxmlreader.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of fast zero XML reader
+ */
+#include <string.h>
+#include "./fastzeroxmlreader.h"
+
+/*! \brief Powers of ten that are exact as doubles */
+static const double exactPowers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+/*! \brief True if text needs more than a byte copy to become a QString
+ *  the way QXmlStreamReader would make it.
+ */
+static bool isPlainText(const char * text, int length) {
+    for (int i = 0; i < length; i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '&' || c == '\r' || c == '>' || c >= 0x80) return false;
+    }
+    return true;
+}
+
+FastZeroXMLReader::FastZeroXMLReader(AgentStore *a,
+        QHash<QString, int> *atc) {
+    agents = a;
+    agentTypeCounts = atc;
+    projection = 0;
+    abort = 0;
+    p = 0;
+    end = 0;
+}
+
+/*! \brief Convert a decimal number.
+ *
+ * Numbers with at most 15 significant digits and a small exponent are
+ * converted exactly with one multiply or divide, which gives the same
+ * double as QString::toDouble.  Anything else returns false.
+ *  \param begin The first byte of the text
+ *  \param end One past the last byte of the text
+ *  \param d The number
+ *  \return False if the text is not a number this can convert
+ */
+bool FastZeroXMLReader::parseNumber(const char * begin, const char * end,
+        double * d) {
+    const char * c = begin;
+    while (c < end && isSpace(*c)) c++;
+    while (end > c && isSpace(*(end - 1))) end--;
+    if (c == end) return false;
+
+    bool negative = false;
+    if (*c == '-' || *c == '+') {
+        negative = (*c == '-');
+        c++;
+    }
+
+    quint64 mantissa = 0;
+    int digits = 0;  /* Significant digits */
+    int exponent = 0;
+    bool any = false;
+    for (; c < end && *c >= '0' && *c <= '9'; c++) {
+        any = true;
+        if (mantissa == 0 && *c == '0') continue;
+        if (++digits > 15) return false;
+        mantissa = mantissa * 10 + (*c - '0');
+    }
+    if (c < end && *c == '.') {
+        for (c++; c < end && *c >= '0' && *c <= '9'; c++) {
+            any = true;
+            exponent--;
+            if (mantissa == 0 && *c == '0') continue;
+            if (++digits > 15) return false;
+            mantissa = mantissa * 10 + (*c - '0');
+        }
+    }
+    if (!any) return false;
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        c++;
+        bool negativeExponent = false;
+        if (c < end && (*c == '-' || *c == '+')) {
+            negativeExponent = (*c == '-');
+            c++;
+        }
+        if (c == end || *c < '0' || *c > '9') return false;
+        int e = 0;
+        for (; c < end && *c >= '0' && *c <= '9'; c++) {
+            if (e > 1000) return false;
+            e = e * 10 + (*c - '0');
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+    if (c != end) return false;
+
+    double value = static_cast<double>(mantissa);
+    if (mantissa != 0) {
+        if (exponent > 22 || exponent < -22) return false;
+        if (exponent > 0) value *= exactPowers[exponent];
+        else if (exponent < 0) value /= exactPowers[-exponent];
+    }
+    *d = negative ? -value : value;
+    return true;
+}
+
+/*! \brief Read agents from file data.
+ *  \param data The file data
+ *  \param size The size of the data
+ *  \param first True if the data starts the file, before the states tag
+ *  \param last True if the data ends the file, after the states end tag
+ *  \return False if anything unexpected was found
+ */
+bool FastZeroXMLReader::read(const char * data, qint64 size, bool first,
+        bool last) {
+    p = data;
+    end = data + size;
+    bool inStates = !first;
+    bool done = false;
+    int agentsRead = 0;
+
+    skipSpace();
+    if (first && startsWith("<?xml", 5)) {
+        const char * q = p;
+        while (q + 1 < end && !(q[0] == '?' && q[1] == '>')) q++;
+        if (q + 1 >= end) return false;
+        p = q + 2;
+    }
+
+    while (true) {
+        skipSpace();
+        if (p == end) break;
+        if (*p != '<' || done) return false;
+
+        if (!inStates) {
+            if (!startsWith("<states>", 8)) return false;
+            p += 8;
+            inStates = true;
+        } else if (startsWith("</states>", 9)) {
+            if (!last) return false;
+            p += 9;
+            done = true;
+        } else if (startsWith("<xagent>", 8)) {
+            p += 8;
+            if (!readAgent()) return false;
+            if (++agentsRead % abortInterval == 0 && isAborted())
+                return false;
+        } else if (startsWith("<environment>", 13)) {
+            p += 13;
+            if (!readEnvironment()) return false;
+        } else {
+            /* Other elements such as itno are skipped */
+            const char * name;
+            const char * text;
+            int nameLength, textLength;
+            if (!readElement(&name, &nameLength, &text, &textLength))
+                return false;
+        }
+    }
+    if (last && !done) return false;
+    if (first && !inStates) return false;
+
+    for (int t = 0; t < typeCounts.count(); t++) {
+        if (typeCounts.at(t) == 0) continue;
+        const QString & name = agents->type(t).name;
+        agentTypeCounts->insert(name,
+                agentTypeCounts->value(name) + typeCounts.at(t));
+    }
+    return true;
+}
+
+/*! \brief Read the environment as an 'agent' with type environment.
+ */
+bool FastZeroXMLReader::readEnvironment() {
+    int type = addType("environment", 11);
+    /* The environment is read whatever the rules, only its variables are
+     * projected */
+    typeWanted[type] = true;
+    AgentColumns & columns = agents->type(type);
+    int row = columns.appendAgent();
+    columns.isEnvironment = true;
+    /* Make environment count one for iteration info */
+    agentTypeCounts->insert("environment", 1);
+
+    while (true) {
+        skipSpace();
+        if (startsWith("</environment>", 14)) {
+            p += 14;
+            return true;
+        }
+        const char * name;
+        const char * text;
+        int nameLength, textLength;
+        if (!readElement(&name, &nameLength, &text, &textLength))
+            return false;
+
+        int variable = variableColumns.at(type).at(
+                addVariable(type, name, nameLength));
+        if (variable == -1) continue;
+        double d;
+        if (parseNumber(text, text + textLength, &d)) {
+            columns.setValue(variable, row, d);
+        } else {
+            if (!isPlainText(text, textLength)) return false;
+            columns.setValue(variable, row,
+                    QString::fromLatin1(text, textLength));
+        }
+    }
+}
+
+/*! \brief Read an xagent after its start tag.
+ */
+bool FastZeroXMLReader::readAgent() {
+    AgentColumns * columns = 0;
+    int type = -1;
+    int row = -1;
+    /* Column expected next, agents of a type list variables in order */
+    int expected = 0;
+
+    while (true) {
+        skipSpace();
+        if (startsWith("</xagent>", 9)) {
+            p += 9;
+            return true;
+        }
+        const char * name;
+        const char * text;
+        int nameLength, textLength;
+        if (!readElement(&name, &nameLength, &text, &textLength))
+            return false;
+
+        if (nameLength == 4 && memcmp(name, "name", 4) == 0) {
+            // Agent type
+            if (!isPlainText(text, textLength)) return false;
+            type = addType(text, textLength);
+            columns = &agents->type(type);
+            typeCounts[type]++;
+            if (!typeWanted.at(type)) {
+                /* No enabled rule or plot uses the agent type, once its
+                 * variable names are known the rest is not looked at */
+                if (!variableNames.at(type).isEmpty()) return skipAgent();
+                continue;
+            }
+            row = columns->appendAgent();
+        } else if (columns != 0) {
+            // Agent memory variable
+            const QList<QByteArray> & names = variableNames.at(type);
+            int index;
+            if (expected < names.count() &&
+                    names.at(expected).size() == nameLength &&
+                    memcmp(names.at(expected).constData(), name,
+                        nameLength) == 0) {
+                index = expected;
+            } else {
+                index = addVariable(type, name, nameLength);
+            }
+            expected = index + 1;
+            int variable = variableColumns.at(type).at(index);
+            /* Not used by any rule or plot */
+            if (variable == -1) continue;
+
+            double d;
+            if (parseNumber(text, text + textLength, &d)) {
+                columns->setValue(variable, row, d);
+            } else {
+                if (!isPlainText(text, textLength)) return false;
+                columns->setValue(variable, row,
+                        QString::fromLatin1(text, textLength));
+            }
+        }
+        /* Memory before the agent type is known cannot be stored */
+    }
+}
+
+/*! \brief Read an element holding only text, such as <x>1.5</x>.
+ *  \return False if the element is anything else
+ */
+bool FastZeroXMLReader::readElement(const char ** name, int * nameLength,
+        const char ** text, int * textLength) {
+    if (p == end || *p != '<') return false;
+    const char * n = p + 1;
+    const char * q = n;
+    while (q < end && *q != '>') {
+        char c = *q;
+        if (isSpace(c) || c == '/' || c == '<' || c == '!' || c == '?' ||
+                c == ':' || c == '&' ||
+                static_cast<unsigned char>(c) >= 0x80) return false;
+        q++;
+    }
+    if (q == end || q == n) return false;
+    *name = n;
+    *nameLength = static_cast<int>(q - n);
+
+    *text = q + 1;
+    const char * t = static_cast<const char *>(
+            memchr(*text, '<', end - *text));
+    if (t == 0) return false;
+    *textLength = static_cast<int>(t - *text);
+
+    /* The end tag must close the element */
+    p = t;
+    if (end - p < *nameLength + 3 || p[1] != '/' ||
+            memcmp(p + 2, n, *nameLength) != 0 || p[*nameLength + 2] != '>')
+        return false;
+    p += *nameLength + 3;
+    return true;
+}
+
+/*! \brief Add an agent type if not already known.
+ *  \return The index of the agent type in the agent store
+ */
+int FastZeroXMLReader::addType(const char * name, int length) {
+    int type = typeIndices.value(QByteArray::fromRawData(name, length), -1);
+    if (type != -1) return type;
+
+    type = agents->addType(QString::fromLatin1(name, length));
+    typeIndices.insert(QByteArray(name, length), type);
+    while (variableNames.count() <= type) {
+        /* Types already in the store keep their variables */
+        QList<QByteArray> names;
+        QVector<int> variables;
+        const AgentColumns & columns = agents->type(variableNames.count());
+        for (int i = 0; i < columns.variables.count(); i++) {
+            names.append(columns.variables.at(i).toLatin1());
+            variables.append(i);
+        }
+        variableNames.append(names);
+        variableColumns.append(variables);
+        typeCounts.append(0);
+        typeWanted.append(!projection ||
+                projection->wantsType(columns.name));
+    }
+    return type;
+}
+
+/*! \brief Add a variable name of an agent type if not already known,
+ *  with a column if the projection reads it.
+ *  \return The index of the name in the variable names of the type
+ */
+int FastZeroXMLReader::addVariable(int type, const char * name, int length) {
+    const QList<QByteArray> & names = variableNames.at(type);
+    for (int i = 0; i < names.count(); i++)
+        if (names.at(i).size() == length &&
+                memcmp(names.at(i).constData(), name, length) == 0) return i;
+
+    AgentColumns & columns = agents->type(type);
+    QString variable = QString::fromLatin1(name, length);
+    int column = -1;
+    if (!projection || (typeWanted.at(type) &&
+            projection->wantsVariable(columns.name, variable)))
+        column = columns.addVariable(variable);
+    else
+        columns.addSkipped(variable);
+    variableNames[type].append(QByteArray(name, length));
+    variableColumns[type].append(column);
+    return variableNames.at(type).count() - 1;
+}
+
+/*! \brief Skip the rest of an xagent without reading its elements.
+ */
+bool FastZeroXMLReader::skipAgent() {
+    while (true) {
+        const char * t = static_cast<const char *>(memchr(p, '<', end - p));
+        if (t == 0) return false;
+        p = t;
+        if (startsWith("</xagent>", 9)) {
+            p += 9;
+            return true;
+        }
+        p++;
+    }
+}
+
+void FastZeroXMLReader::skipSpace() {
+    while (p < end && isSpace(*p)) p++;
+}
+
+bool FastZeroXMLReader::startsWith(const char * tag, int length) const {
+    return end - p >= length && memcmp(p, tag, length) == 0;
+}
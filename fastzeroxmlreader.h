@@ -0,0 +1,71 @@
+/*!
+ * \file fastzeroxmlreader.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for fast zero XML reader
+ */
+#ifndef FASTZEROXMLREADER_H_
+#define FASTZEROXMLREADER_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QAtomicInt>
+#include "./agentstore.h"
+#include "./agentprojection.h"
+
+/*! \brief Reads iteration files of the usual FLAME shape straight from
+ *  mapped memory.
+ *
+ * Only states, itno style elements, environment and xagent elements with
+ * plain text values are understood.  Tags are found with memchr and
+ * numbers are converted from the bytes without building strings.  Anything
+ * else, including comments, attributes, entities and malformed tags, makes
+ * read() return false so the caller can use ZeroXMLReader instead.
+ */
+class FastZeroXMLReader {
+  public:
+    FastZeroXMLReader(AgentStore * a, QHash<QString, int> * atc);
+    bool read(const char * data, qint64 size, bool first, bool last);
+    void setProjection(const AgentProjection * p) { projection = p; }
+    void setAbort(const QAtomicInt * a) { abort = a; }
+    bool isAborted() const { return abort && *abort != 0; }
+
+    /*! \brief How many agents are read between checks for abort */
+    static const int abortInterval = 1024;
+
+    static bool parseNumber(const char * begin, const char * end, double * d);
+
+  private:
+    bool readEnvironment();
+    bool readAgent();
+    bool skipAgent();
+    bool readElement(const char ** name, int * nameLength,
+            const char ** text, int * textLength);
+    int addType(const char * name, int length);
+    int addVariable(int type, const char * name, int length);
+    void skipSpace();
+    bool startsWith(const char * tag, int length) const;
+    AgentStore * agents;
+    QHash<QString, int> * agentTypeCounts;
+    /*! \brief The variables to read, 0 for every variable */
+    const AgentProjection * projection;
+    /*! \brief Stops reading when set, 0 if never stopped */
+    const QAtomicInt * abort;
+    const char * p;  /*!< \brief The current position */
+    const char * end;  /*!< \brief The end of the data */
+    /*! \brief Agent type by name bytes */
+    QHash<QByteArray, int> typeIndices;
+    /*! \brief Variable names as bytes, one list per agent type */
+    QList<QList<QByteArray> > variableNames;
+    /*! \brief The column of each variable name, -1 if not read */
+    QList<QVector<int> > variableColumns;
+    /*! \brief Agents read of each agent type */
+    QVector<int> typeCounts;
+    /*! \brief False for agent types that are only counted */
+    QVector<bool> typeWanted;
+};
+
+#endif  // FASTZEROXMLREADER_H_
@@ -24,6 +24,7 @@ lessThan(QT_VER_MIN, 8):lessThan(QT_VER_MAJ, 5) {
 
 macx:ICON = flame_icon_v.icns
 win32:RC_FILE = flame-v.rc
+win32:LIBS += -lpsapi
 
 SOURCES += main.cpp
 
@@ -61,7 +62,28 @@ SOURCES += mainwindow.cpp \
     agentdialog.cpp \
     restrictaxesdialog.cpp \
     iterationinfodialog.cpp \
-    timescale.cpp
+    timescale.cpp \
+    agentstore.cpp \
+    compiledrule.cpp \
+    iterationloader.cpp \
+    parallelzeroxmlreader.cpp \
+    fastzeroxmlreader.cpp \
+    iterationcache.cpp \
+    agentrenderer.cpp \
+    agentpicker.cpp \
+    graphaggregator.cpp \
+    graphbackfill.cpp \
+    batchrenderer.cpp \
+    framegrabber.cpp \
+    imagewriter.cpp \
+    framestream.cpp \
+    iterationindex.cpp \
+    iterationfollower.cpp \
+    ruleagentarena.cpp \
+    memoryusage.cpp \
+    ruleupdater.cpp \
+    agentprojection.cpp \
+    iterationscrubber.cpp
 
 HEADERS  += mainwindow.h \
     glwidget.h \
@@ -94,7 +116,30 @@ HEADERS  += mainwindow.h \
     restrictaxesdialog.h \
     dimension.h \
     iterationinfodialog.h \
-    ruleagent.h
+    ruleagent.h \
+    agentstore.h \
+    compiledrule.h \
+    iterationloader.h \
+    iterationdata.h \
+    parallelzeroxmlreader.h \
+    fastzeroxmlreader.h \
+    iterationcache.h \
+    agentrenderer.h \
+    agentpicker.h \
+    graphaggregator.h \
+    graphbackfill.h \
+    batchrenderer.h \
+    framegrabber.h \
+    imagewriter.h \
+    framestream.h \
+    iterationindex.h \
+    iterationfollower.h \
+    ruleagentarena.h \
+    memoryusage.h \
+    ruleupdater.h \
+    agentprojection.h \
+    iterationscrubber.h \
+    textsearch.h
 
 FORMS    += mainwindow.ui \
     positiondialog.ui \
@@ -0,0 +1,110 @@
+/*!
+ * \file framegrabber.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of frame grabber
+ */
+#include <string.h>
+#include "./framegrabber.h"
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+#ifndef GL_UNSIGNED_INT_8_8_8_8_REV
+#define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#endif
+
+FrameGrabber::FrameGrabber() {
+    for (int i = 0; i < bufferCount; i++) {
+        buffers[i] = new QGLBuffer(QGLBuffer::PixelPackBuffer);
+        bufferSize[i] = 0;
+    }
+    next = 0;
+    unsupported = false;
+}
+
+FrameGrabber::~FrameGrabber() {
+    for (int i = 0; i < bufferCount; i++) delete buffers[i];
+}
+
+/*! \brief Start reading the current frame of the current context.
+ *
+ * If both buffers are in use the caller takes the oldest image first.
+ *  \param width The frame width
+ *  \param height The frame height
+ *  \param fileName The file the image will be written to
+ */
+void FrameGrabber::grab(int width, int height, const QString & fileName) {
+    Readback r;
+    r.buffer = -1;
+    r.width = width;
+    r.height = height;
+    r.fileName = fileName;
+
+    /* The rows of a 32 bit image are always 4 byte aligned */
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    QGLBuffer * buffer = buffers[next];
+    int size = width * height * 4;
+    if (!unsupported && !buffer->isCreated() && !buffer->create())
+        unsupported = true;
+    if (!unsupported) {
+        buffer->bind();
+        if (bufferSize[next] != size) {
+            buffer->setUsagePattern(QGLBuffer::StreamRead);
+            buffer->allocate(size);
+            bufferSize[next] = size;
+        }
+        /* Returns at once, the copy is made by the GL into the buffer */
+        glReadPixels(0, 0, width, height, GL_BGRA,
+                GL_UNSIGNED_INT_8_8_8_8_REV, 0);
+        buffer->release();
+        r.buffer = next;
+        next = (next + 1) % bufferCount;
+    } else {
+        r.image = QImage(width, height, QImage::Format_RGB32);
+        glReadPixels(0, 0, width, height, GL_BGRA,
+                GL_UNSIGNED_INT_8_8_8_8_REV, r.image.bits());
+    }
+    pending.append(r);
+}
+
+/*! \brief Take the oldest grabbed frame, waiting for its copy to finish.
+ *  \param fileName The file the image will be written to
+ *  \return The image, null if none is pending
+ */
+QImage FrameGrabber::take(QString * fileName) {
+    if (pending.isEmpty()) return QImage();
+    Readback r = pending.takeFirst();
+    *fileName = r.fileName;
+
+    if (r.buffer != -1) {
+        QGLBuffer * buffer = buffers[r.buffer];
+        r.image = QImage(r.width, r.height, QImage::Format_RGB32);
+        buffer->bind();
+        const uchar * data = static_cast<const uchar *>(
+                buffer->map(QGLBuffer::ReadOnly));
+        if (data) {
+            int row = r.width * 4;
+            for (int y = 0; y < r.height; y++)
+                memcpy(r.image.scanLine(y), data + row * y, row);
+            buffer->unmap();
+        } else {
+            r.image = QImage();
+        }
+        buffer->release();
+    }
+    /* GL rows start at the bottom */
+    return r.image.mirrored();
+}
+
+/*! \brief Free the buffers, with the context they were created in current.
+ */
+void FrameGrabber::clear() {
+    pending.clear();
+    for (int i = 0; i < bufferCount; i++) {
+        buffers[i]->destroy();
+        bufferSize[i] = 0;
+    }
+}
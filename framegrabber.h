@@ -0,0 +1,53 @@
+/*!
+ * \file framegrabber.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for frame grabber
+ */
+#ifndef FRAMEGRABBER_H_
+#define FRAMEGRABBER_H_
+
+#include <QGLBuffer>
+#include <QImage>
+#include <QString>
+#include <QList>
+
+/*! \brief Reads frames back from the GL without waiting for them.
+ *
+ * A grab starts copying the frame into one of two pixel buffer objects and
+ * returns straight away, so the GL carries on while the copy is made.  The
+ * image is taken later, after the next event, when the copy has finished.
+ * With two buffers a second grab can start before the first is taken.  If
+ * the GL has no pixel buffer objects the frame is read at once.
+ */
+class FrameGrabber {
+  public:
+    FrameGrabber();
+    ~FrameGrabber();
+
+    void grab(int width, int height, const QString & fileName);
+    bool isPending() const { return !pending.isEmpty(); }
+    bool isBusy() const { return pending.count() >= bufferCount; }
+    QImage take(QString * fileName);
+    void clear();
+
+    static const int bufferCount = 2;
+
+  private:
+    /*! \brief A frame being read back */
+    struct Readback {
+        int buffer;  /*!< \brief The buffer read into, -1 if read at once */
+        int width;
+        int height;
+        QString fileName;
+        QImage image;  /*!< \brief The frame if read at once */
+    };
+    QGLBuffer * buffers[bufferCount];
+    int bufferSize[bufferCount];  /*!< \brief Bytes allocated to a buffer */
+    int next;  /*!< \brief The buffer of the next grab */
+    bool unsupported;  /*!< \brief True if buffers could not be created */
+    QList<Readback> pending;
+};
+
+#endif  // FRAMEGRABBER_H_
@@ -0,0 +1,199 @@
+/*!
+ * \file framestream.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of frame stream
+ */
+#include <QObject>
+#include <QAtomicInt>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "./framestream.h"
+
+/*! \brief Set once standard output has been streamed to */
+static QBasicAtomicInt stdoutUsed = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+FrameStream::FrameStream(const QString & t, Format f)
+    : target(t), format(f) {
+#ifdef Q_OS_UNIX
+    /* A reader that exits gives EPIPE instead of killing the process */
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    if (target != "-") file.setFileName(target);
+    fd = -1;
+    width = 0;
+    height = 0;
+    frames = 0;
+}
+
+FrameStream::~FrameStream() {
+    close();
+}
+
+/*! \brief Write a frame, opening the stream and writing its header first
+ *  if this is the first frame.
+ *  \param image The frame
+ *  \param error The reason if the frame could not be written
+ *  \return True if the frame was written
+ */
+bool FrameStream::writeFrame(const QImage & image, QString * error) {
+    if (!file.isOpen()) {
+        if (!open(error)) return false;
+        width = image.width();
+        height = image.height();
+        if (format == Y4M && file.write(y4mHeader(width, height)) == -1) {
+            if (error) *error = writeError();
+            return false;
+        }
+    }
+
+    QImage frame = image;
+    if (frame.width() != width || frame.height() != height)
+        frame = image.scaled(width, height, Qt::IgnoreAspectRatio,
+                Qt::SmoothTransformation);
+
+    QByteArray data = (format == Y4M) ? y4mFrame(frame) : ppmFrame(frame);
+    if (file.write(data) != data.size() || !file.flush()) {
+        if (error) *error = writeError();
+        return false;
+    }
+    frames++;
+    return true;
+}
+
+/*! \brief Open the target, without waiting for a named pipe to have a
+ *  reader.
+ *  \param error The reason if the target could not be opened
+ *  \return True if the target was opened
+ */
+bool FrameStream::open(QString * error) {
+    if (target == "-") {
+        /* Closed at the end of the first stream */
+        if (!stdoutUsed.testAndSetOrdered(0, 1)) {
+            if (error) *error = QObject::tr(
+                    "Standard output has already been streamed to");
+            return false;
+        }
+        fd = fileno(stdout);
+    }
+#ifdef Q_OS_UNIX
+    struct stat info;
+    QByteArray path = QFile::encodeName(target);
+    if (fd == -1 && stat(path.constData(), &info) == 0 &&
+            S_ISFIFO(info.st_mode)) {
+        fd = ::open(path.constData(), O_WRONLY | O_NONBLOCK);
+        if (fd == -1) {
+            if (error) *error = (errno == ENXIO) ?
+                    QObject::tr("Nothing is reading the named pipe") :
+                    QString::fromLocal8Bit(strerror(errno));
+            return false;
+        }
+        /* Frames are written whole, waiting for the reader */
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    }
+#endif
+
+    bool opened = (fd != -1) ? file.open(fd, QIODevice::WriteOnly) :
+            file.open(QIODevice::WriteOnly);
+    if (!opened) {
+        if (error) *error = file.errorString();
+#ifdef Q_OS_UNIX
+        if (fd != -1 && target != "-") ::close(fd);
+#endif
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+/*! \brief The reason the last write failed.
+ */
+QString FrameStream::writeError() const {
+    if (errno == EPIPE) return QObject::tr("The stream reader has exited");
+    return file.errorString();
+}
+
+/*! \brief Close the stream so the reader sees its end.
+ */
+void FrameStream::close() {
+    if (!file.isOpen()) return;
+    file.close();
+    /* QFile does not close a descriptor it was given */
+    if (target == "-") {
+        fclose(stdout);
+    } else if (fd != -1) {
+#ifdef Q_OS_UNIX
+        ::close(fd);
+#endif
+    }
+    fd = -1;
+}
+
+/*! \brief The header of a Y4M stream.
+ */
+QByteArray FrameStream::y4mHeader(int width, int height) {
+    return QString("YUV4MPEG2 W%1 H%2 F25:1 Ip A1:1 C444\n").
+            arg(width).arg(height).toAscii();
+}
+
+/*! \brief A Y4M frame, the planes of BT.601 video range Y, Cb and Cr.
+ */
+QByteArray FrameStream::y4mFrame(const QImage & image) {
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    int w = rgb.width();
+    int h = rgb.height();
+    int plane = w * h;
+    QByteArray data("FRAME\n");
+    int start = data.size();
+    data.resize(start + 3 * plane);
+    uchar * y = reinterpret_cast<uchar *>(data.data()) + start;
+    uchar * u = y + plane;
+    uchar * v = u + plane;
+
+    for (int j = 0; j < h; j++) {
+        const QRgb * line = reinterpret_cast<const QRgb *>(rgb.scanLine(j));
+        for (int i = 0; i < w; i++) {
+            int r = qRed(line[i]);
+            int g = qGreen(line[i]);
+            int b = qBlue(line[i]);
+            *y++ = static_cast<uchar>(
+                    16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+            /* The 128 offset is added first so only positives are shifted */
+            *u++ = static_cast<uchar>(
+                    (-38 * r - 74 * g + 112 * b + 32896) >> 8);
+            *v++ = static_cast<uchar>(
+                    (112 * r - 94 * g - 18 * b + 32896) >> 8);
+        }
+    }
+    return data;
+}
+
+/*! \brief A binary PPM image.
+ */
+QByteArray FrameStream::ppmFrame(const QImage & image) {
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    int w = rgb.width();
+    int h = rgb.height();
+    QByteArray data = QString("P6\n%1 %2\n255\n").arg(w).arg(h).toAscii();
+    int start = data.size();
+    data.resize(start + 3 * w * h);
+    uchar * p = reinterpret_cast<uchar *>(data.data()) + start;
+
+    for (int j = 0; j < h; j++) {
+        const QRgb * line = reinterpret_cast<const QRgb *>(rgb.scanLine(j));
+        for (int i = 0; i < w; i++) {
+            *p++ = static_cast<uchar>(qRed(line[i]));
+            *p++ = static_cast<uchar>(qGreen(line[i]));
+            *p++ = static_cast<uchar>(qBlue(line[i]));
+        }
+    }
+    return data;
+}
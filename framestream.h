@@ -0,0 +1,57 @@
+/*!
+ * \file framestream.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for frame stream
+ */
+#ifndef FRAMESTREAM_H_
+#define FRAMESTREAM_H_
+
+#include <QFile>
+#include <QImage>
+#include <QString>
+#include <QByteArray>
+
+/*! \brief Writes frames one after another as an uncompressed video stream.
+ *
+ * The stream goes to a file, a named pipe or standard output, so a video
+ * encoder can read the frames as they are drawn without any image files.
+ * Y4M is written as 8 bit 4:4:4 YCbCr at 25 frames per second and PPM as
+ * a run of binary PPM images.  Every frame has the size of the first, a
+ * frame of another size is scaled.  The file is opened when the first
+ * frame is written.  A named pipe with no reader fails to open rather
+ * than waiting, and a reader that exits gives a write error rather than
+ * SIGPIPE.  Standard output is closed at the end of the stream so its
+ * reader sees the end, and so can only be streamed to once.
+ */
+class FrameStream {
+  public:
+    enum Format { Y4M, PPM };
+
+    FrameStream(const QString & t, Format f);
+    ~FrameStream();
+
+    QString getTarget() const { return target; }
+    Format getFormat() const { return format; }
+    int frameCount() const { return frames; }
+    bool writeFrame(const QImage & image, QString * error);
+    void close();
+
+    static QByteArray y4mHeader(int width, int height);
+    static QByteArray y4mFrame(const QImage & image);
+    static QByteArray ppmFrame(const QImage & image);
+
+  private:
+    bool open(QString * error);
+    QString writeError() const;
+    QString target;  /*!< \brief The file or pipe, - for standard output */
+    Format format;
+    QFile file;
+    int fd;  /*!< \brief The descriptor opened for file, -1 if by name */
+    int width;  /*!< \brief The size of every frame */
+    int height;
+    int frames;  /*!< \brief The number of frames written */
+};
+
+#endif  // FRAMESTREAM_H_
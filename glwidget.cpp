@@ -17,11 +17,13 @@
 #include "./visualsettingsitem.h"
 #include "./condition.h"
 #include "./agentdialog.h"
+#include "./memoryusage.h"
 
 GLWidget::GLWidget(float * xr, float * yr, float * xm, float * ym, float * zm,
         Dimension * rd, float * oz, bool *ani, QWidget *parent)
     : QGLWidget(parent) {
     agents = 0;
+    agentsFileName = 0;
     setMouseTracking(true);
     xrotate = xr;
     yrotate = yr;
@@ -44,7 +46,9 @@ GLWidget::GLWidget(float * xr, float * yr, float * xm, float * ym, float * zm,
     animation = ani;
     locked = false;
     animationImages = false;
-    imageLock = false;
+    snapshotRequested = false;
+    imagesFormat = "jpg";
+    imagesStream = "-";
     pickOn = false;
     zNear = 0.1f;
     clippingOn = false;
@@ -56,6 +60,17 @@ GLWidget::GLWidget(float * xr, float * yr, float * xm, float * ym, float * zm,
     delayTime = 0;
     orthoZoom = oz;
     background = Qt::white;
+    renderer = new AgentRenderer();
+    picker = new AgentPicker();
+    grabber = new FrameGrabber();
+    imageWriter = new ImageWriter(this);
+    connect(imageWriter, SIGNAL(imageStatus(QString)),
+            this, SIGNAL(imageStatus(QString)));
+    connect(imageWriter, SIGNAL(queueDepthChanged(int)),
+            this, SIGNAL(imageQueueChanged(int)));
+    debugOverlay = false;
+    redrawCount = 0;
+    frameTime = 0;
 
     time = QTime::currentTime();
     timer = new QTimer(this);
@@ -72,8 +87,13 @@ GLWidget::GLWidget(float * xr, float * yr, float * xm, float * ym, float * zm,
 }
 
 GLWidget::~GLWidget() {
-    // Delete display lists
-    glDeleteLists(nPartsList, 5);
+    // Delete vertex buffers while the context is current
+    makeCurrent();
+    delete renderer;
+    delete picker;
+    writeSnapshots();
+    grabber->clear();
+    delete grabber;
     emit(visual_window_closed());
 }
 
@@ -85,6 +105,7 @@ void GLWidget::closeEvent(QCloseEvent *event) {
 void GLWidget::setBackgroundColour(QColor b) {
     background = b;
     initializeGL();
+    update();
 }
 
 void GLWidget::updateDelayTime(int d) {
@@ -94,6 +115,7 @@ void GLWidget::updateDelayTime(int d) {
 
 void GLWidget::unlockDelayTime() {
     delayLock = false;
+    update();
 }
 
 void GLWidget::updateImagesLocation(QString s) {
@@ -106,52 +128,119 @@ void GLWidget::setDimension(int d) {
     if (d == 3) resize(800, 600);
 }
 
+/*! \brief Take a snapshot of the next frame drawn.
+ */
 void GLWidget::takeSnapshot() {
-    imageLock = true;
-
-    QString filepath;
-    filepath.append(*configpath);
-    filepath.append("/");
-    filepath.append(imagesLocation);
-
-    QDir filedir(filepath);
-
-    QString filename = filedir.canonicalPath();
-    filename.append("/");
-    filename.append(QString("%1").arg(*iteration));
-    filename.append(".jpg");
-
-    QImage i = this->grabFrameBuffer();
-    QImageWriter writer(filename, "JPG");
-    writer.setQuality(90);
-    if (!writer.write(i)) {
-        qDebug() << writer.errorString() << filename;
-        emit(imageStatus(QString("Error: %1 %2").
-                arg(writer.errorString(), filename)));
+    snapshotRequested = true;
+    update();
+}
+
+/*! \brief Start reading back the frame just drawn to write it as the image
+ *  of the current iteration, or as the next frame of the stream.  The image
+ *  is taken and queued for writing once control returns to the event loop.
+ */
+void GLWidget::grabSnapshot() {
+    QString filename;
+    if (imagesFormat.endsWith(" stream")) {
+        QString target = imagesStream;
+        if (target != "-")
+            target = QDir(*configpath).absoluteFilePath(imagesStream);
+        imageWriter->setStream(target, imagesFormat.startsWith("y4m") ?
+                FrameStream::Y4M : FrameStream::PPM);
+        filename = QString("%1").arg(*iteration);
     } else {
-        emit(imageStatus(QString("Saved: %1").arg(filename)));
+        QString filepath;
+        filepath.append(*configpath);
+        filepath.append("/");
+        filepath.append(imagesLocation);
+
+        QDir filedir(filepath);
+
+        filename = filedir.canonicalPath();
+        filename.append("/");
+        filename.append(QString("%1").arg(*iteration));
+        filename.append(".");
+        filename.append(imagesFormat);
+    }
+
+    if (grabber->isBusy()) writeSnapshots();
+    grabber->grab(width(), height(), filename);
+    QTimer::singleShot(0, this, SLOT(writeSnapshots()));
+}
+
+/*! \brief Take the frames read back and queue them to be written.
+ */
+void GLWidget::writeSnapshots() {
+    if (!grabber->isPending()) return;
+    makeCurrent();
+    while (grabber->isPending()) {
+        QString filename;
+        QImage image = grabber->take(&filename);
+        imageWriter->write(image, filename);
     }
-    imageLock = false;
+}
+
+/*! \brief Set the image format, jpg, png or ppm files, or a y4m or ppm
+ *  stream.  Changing from a stream closes it.
+ */
+void GLWidget::updateImagesFormat(QString s) {
+    writeSnapshots();
+    if (s != imagesFormat) imageWriter->closeStream();
+    imagesFormat = s;
+}
+
+/*! \brief Set the file or named pipe streams are written to, - for
+ *  standard output.
+ */
+void GLWidget::updateImagesStream(QString s) {
+    writeSnapshots();
+    if (s != imagesStream) imageWriter->closeStream();
+    imagesStream = s;
 }
 
 void GLWidget::takeAnimation(bool b) {
     animationImages = b;
+    /* The end of the snapshots of an animation ends the video */
+    if (!b) {
+        writeSnapshots();
+        imageWriter->closeStream();
+    }
 }
 
 void GLWidget::iterationLoaded() {
     locked = false;
+    renderer->invalidate();
+    picker->invalidate();
+    update();
+}
+
+/*! \brief The rule agents have changed so the vertex buffers are rebuilt
+ *  before the next frame and the pick grid before the next pick.
+ */
+void GLWidget::agentsChanged() {
+    renderer->invalidate();
+    picker->invalidate();
+    update();
 }
 
 void GLWidget::nextIteration() {
     emit(increase_iteration());
 }
 
-void GLWidget::update_agents(QList<Agent *> *a) {
+void GLWidget::update_agents(AgentStore *a) {
     agents = a;
 }
 
 void GLWidget::set_rules(VisualSettingsModel * m) {
     model = m;
+    connect(model, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+            this, SLOT(agentsChanged()));
+    connect(model, SIGNAL(rowsInserted(QModelIndex, int, int)),
+            this, SLOT(agentsChanged()));
+    connect(model, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+            this, SLOT(agentsChanged()));
+    renderer->invalidate();
+    picker->invalidate();
 }
 
 void GLWidget::reset_camera() {
@@ -165,7 +254,11 @@ void GLWidget::reset_camera() {
         resizeGL(windowWidth, windowHeight);
 }
 
-void GLWidget::initializeGL() {
+/*! \brief Set the clear colour and lighting of the current GL context, as
+ *  the visual window uses them.
+ *  \param background The background colour
+ */
+void GLWidget::setupLighting(const QColor & background) {
     /* Reflectivness properties of material */
     GLfloat mat_specular[] = { 0.0, 0.0, 0.0, 1.0 };
     /* Size & Brightness of highlight, 0-128 */
@@ -207,284 +300,85 @@ void GLWidget::initializeGL() {
     glEnable(GL_LIGHT0);
     // glEnable(GL_BLEND);
     // glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // Display lists
-    nPartsList = glGenLists(5);
-    SPHERE_4  = nPartsList;
-    SPHERE_8  = nPartsList+1;
-    SPHERE_16 = nPartsList+2;
-    SPHERE_32 = nPartsList+3;
-    SPHERE_64 = nPartsList+4;
-    dl_qobj = gluNewQuadric();
-    glNewList(SPHERE_4, GL_COMPILE);
-        gluSphere(dl_qobj, 1.0, 4, 4);
-    glEndList();
-    glNewList(SPHERE_8, GL_COMPILE);
-        gluSphere(dl_qobj, 1.0, 8, 8);
-    glEndList();
-    glNewList(SPHERE_16, GL_COMPILE);
-        gluSphere(dl_qobj, 1.0, 16, 16);
-    glEndList();
-    glNewList(SPHERE_32, GL_COMPILE);
-        gluSphere(dl_qobj, 1.0, 32, 32);
-    glEndList();
-    glNewList(SPHERE_64, GL_COMPILE);
-        gluSphere(dl_qobj, 1.0, 64, 64);
-    glEndList();
 }
 
-void GLWidget::resizeGL(int w, int h) {
-    window_ratio = (GLfloat)(static_cast<float>(w)/static_cast<float>(h));
-    windowWidth = w;
-    windowHeight = h;
+void GLWidget::initializeGL() {
+    setupLighting(background);
+}
 
+/*! \brief Set the viewport and projection of the current GL context.
+ *  \param d The visual dimension, 2 for orthogonal or 3 for perspective
+ *  \param w The width in pixels
+ *  \param h The height in pixels
+ *  \param zoom The orthogonal zoom
+ *  \param zn The near clipping plane
+ */
+void GLWidget::setupProjection(int d, int w, int h, float zoom, float zn) {
     glViewport(0, 0, w, h);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    if (dimension == 2) {
+    if (d == 2) {
         glViewport(0, 0, qMax(w, h), qMax(w, h));
-        glOrtho(-1*(*orthoZoom), 1*(*orthoZoom),
-                -1*(*orthoZoom), 1*(*orthoZoom), zNear, 20);
+        glOrtho(-1*zoom, 1*zoom, -1*zoom, 1*zoom, zn, 20);
     }
-    if (dimension == 3) {
-        gluPerspective(45.0f, window_ratio, zNear, 20.0f);
+    if (d == 3) {
+        gluPerspective(45.0f, static_cast<float>(w)/static_cast<float>(h),
+                zn, 20.0f);
     }
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
 }
 
+/*! \brief Move and rotate the scene in the current modelview matrix.
+ */
+void GLWidget::setupCamera(float xr, float yr, float xm, float ym, float zm) {
+    glTranslatef(xm, ym, zm);
+    glRotatef(yr, 1.0f, 0.0f, 0.0f);
+    glRotatef(xr, 0.0f, 0.0f, 1.0f);
+}
+
+void GLWidget::resizeGL(int w, int h) {
+    window_ratio = (GLfloat)(static_cast<float>(w)/static_cast<float>(h));
+    windowWidth = w;
+    windowHeight = h;
+
+    setupProjection(dimension, w, h, *orthoZoom, zNear);
+}
+
 void GLWidget::paintGL() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glPushMatrix();
 
-    glTranslatef(*xmove, *ymove, *zmove);
-    glRotatef(*yrotate, 1.0f, 0.0f, 0.0f);
-    glRotatef(*xrotate, 0.0f, 0.0f, 1.0f);
+    setupCamera(*xrotate, *yrotate, *xmove, *ymove, *zmove);
 
-    // Does not include translation and rotation of scene
-    // at the moment so leave out
-    // ExtractFrustum();
+    // Includes the translation and rotation of the scene
+    ExtractFrustum(frustum);
 
-    drawAgents(GL_RENDER);
+    Dimension * limits = restrictAxesOn ? restrictDimension : 0;
+    if (renderer->needsBuild(limits)) renderer->build(model, limits);
+    renderer->draw(light, frustum);
 
     glPopMatrix();
 }
 
-void GLWidget::drawSphere(double size) {
-    if (size > 0.4)
-        glCallList(SPHERE_64);
-    else
-        glCallList(SPHERE_16);
-}
-
-void GLWidget::drawAgents(GLenum mode) {
-    double size = 0.0;
-    double sizeY = 0.0;
-    double sizeZ = 0.0;
-    // int grade;
-    int name = 0;
-    GLfloat mat_ambientA[4];
-    nameAgents.clear();
-    /*int style = 0;
-    GLUquadricObj * qobj = gluNewQuadric();
-
-    if (style == 0) {
-        gluQuadricDrawStyle(qobj, GLU_FILL); // smooth shaded
-        gluQuadricNormals(qobj, GLU_SMOOTH);
-    } else if (style == 1) {
-        gluQuadricDrawStyle(qobj, GLU_FILL); // flat shaded
-        gluQuadricNormals(qobj, GLU_FLAT);
-    } else if (style == 2) {
-        gluQuadricDrawStyle(qobj, GLU_LINE); // all polygons wireframe
-        gluQuadricNormals(qobj, GLU_NONE);
-    }*/
-
-    for (int pass = 1; pass < 4; pass++) {
-        if (pass == 1) {
-            // if first pass
-            glEnable(GL_DEPTH_TEST);
-            glDepthFunc(GL_LEQUAL);
-            glDisable(GL_BLEND);
-        } else if (pass == 2) {
-            // if second pass
-            glEnable(GL_DEPTH_TEST);
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        }
-
-        /* For every rule */
-        for (int j = 0; j < model->getRules().count(); j++) {
-            VisualSettingsItem * rule = model->getRules()[j];
-
-            /* For every agent associated with the current rule */
-            for (int i = 0; i < rule->agents.size(); i++) {
-                /* Check the restrict dimensions */
-                if (!restrictAxesOn || (restrictAxesOn &&
-                ( (!restrictDimension->xminon ||
-                        (restrictDimension->xminon && rule->agents.at(i)->x >
-                            restrictDimension->xmin)) &&
-                    (!restrictDimension->xmaxon ||
-                        (restrictDimension->xmaxon && rule->agents.at(i)->x <
-                            restrictDimension->xmax)) &&
-                    (!restrictDimension->yminon ||
-                        (restrictDimension->yminon && rule->agents.at(i)->y >
-                            restrictDimension->ymin)) &&
-                    (!restrictDimension->ymaxon ||
-                        (restrictDimension->ymaxon && rule->agents.at(i)->y <
-                            restrictDimension->ymax)) &&
-                    (!restrictDimension->zminon ||
-                        (restrictDimension->zminon && rule->agents.at(i)->z >
-                            restrictDimension->zmin)) &&
-                    (!restrictDimension->zmaxon ||
-                        (restrictDimension->zmaxon && rule->agents.at(i)->z <
-                            restrictDimension->zmax)) ))) {
-                    /* If the object is opaque and first pass, or
-                       if the object is transparent and is the second or third pass */
-                    if (((rule->colour().alphaF() >= 0.95 && pass == 1) ||
-                            (rule->colour().alphaF() < 0.95 && pass >= 2))) {
-                        glPushMatrix();
-
-                        glTranslatef(rule->agents.at(i)->x,
-                                     rule->agents.at(i)->y,
-                                     rule->agents.at(i)->z);
-
-                        if (rule->agents.at(i)->isPicked) {
-                            mat_ambientA[0] = 1.0-rule->colour().redF();
-                            mat_ambientA[1] = 1.0-rule->colour().greenF();
-                            mat_ambientA[2] = 1.0-rule->colour().blueF();
-                            mat_ambientA[3] = rule->colour().alphaF();
-                        } else {
-                            mat_ambientA[0] = rule->colour().redF();
-                            mat_ambientA[1] = rule->colour().greenF();
-                            mat_ambientA[2] = rule->colour().blueF();
-                            mat_ambientA[3] = rule->colour().alphaF();
-                        }
-
-                        if (light)
-                            glMaterialfv(GL_FRONT,
-                                    GL_AMBIENT_AND_DIFFUSE, mat_ambientA);
-                        else
-                            glColor4fv(mat_ambientA);
-
-                        size = rule->agents.at(i)->shapeDimension/2.0;
-                        sizeY = rule->agents.at(i)->shapeDimensionY/2.0;
-                        sizeZ = rule->agents.at(i)->shapeDimensionZ/2.0;
-
-                        if (QString::compare("sphere", rule->shape().
-                                getShape()) == 0) {
-                            glEnable(GL_CULL_FACE);
-                            if (pass == 2) {
-                                if (mode == GL_SELECT) glLoadName(0);
-                                // Draw back face
-                                glCullFace(GL_FRONT);
-                                glPushMatrix();
-                                glScalef(size, size, size);
-                                glEnable(GL_NORMALIZE);
-                                drawSphere(size);
-                                glDisable(GL_NORMALIZE);
-                                glPopMatrix();
-                            } else {
-                                if (mode == GL_SELECT) {
-                                    glLoadName(++name);
-                                    nameAgents.insert(name, rule->agents.at(i));
-                                }
-                                // Draw front face
-                                glCullFace(GL_BACK);
-                                glPushMatrix();
-                                glScalef(size, size, size);
-                                glEnable(GL_NORMALIZE);
-                                drawSphere(size);
-                                glDisable(GL_NORMALIZE);
-                                glPopMatrix();
-                            }
-                            glDisable(GL_CULL_FACE);
-                        } else if (QString::compare("point", rule->shape().
-                                getShape()) == 0) {
-                            if (pass != 2) {
-                                if (mode == GL_SELECT) {
-                                    glLoadName(++name);
-                                    nameAgents.insert(name, rule->agents[i]);
-                                }
-
-                                glDisable(GL_LIGHTING);
-                                glColor4fv(mat_ambientA);
-                                glPointSize(static_cast<int>
-                                    (rule->agents.at(i)->shapeDimension));
-                                glBegin(GL_POINTS);
-                                glVertex3f(0.0, 0.0, 0.0);
-                                glEnd();
-                                glEnable(GL_LIGHTING);
-                            }
-                        } else if (QString::compare("cube", rule->shape().
-                                getShape()) == 0) {
-                            glEnable(GL_CULL_FACE);
-                            if (pass == 2) {
-                                if (mode == GL_SELECT) glLoadName(0);
-                                // Draw back face
-                                glCullFace(GL_FRONT);
-                                drawCube(size, sizeY, sizeZ);
-                            } else {
-                                if (mode == GL_SELECT) {
-                                    glLoadName(++name);
-                                    nameAgents.insert(name, rule->agents[i]);
-                                }
-                                // Draw front face
-                                glCullFace(GL_BACK);
-                                drawCube(size, sizeY, sizeZ);
-                            }
-                            glDisable(GL_CULL_FACE);
-                        }
-
-                        // if(mode == GL_SELECT) glPopName();
-                        glPopMatrix();
-                    }
-                }
-            }
-        }
-    }
-}
-
-void GLWidget::drawCube(float size, float sizeY, float sizeZ) {
-    glBegin(GL_QUADS);  // Draw using quads, T-Top B-Bottom
-    glNormal3f(0.0f, 0.5f, 0.0f);
-    glVertex3f(size, sizeY, -sizeZ);  // T-right of the quad (T)
-    glVertex3f(-size, sizeY, -sizeZ);  // T-left of the quad (T)
-    glVertex3f(-size, sizeY,  sizeZ);  // B-left of the quad (T)
-    glVertex3f(size, sizeY,  sizeZ);  // B-right of the quad (T)
-
-    glNormal3f(0.0f, -0.5f, 0.0f);
-    glVertex3f(size, -sizeY,  sizeZ);  // T-right of the quad (B)
-    glVertex3f(-size, -sizeY,  sizeZ);  // T-left of the quad (B)
-    glVertex3f(-size, -sizeY, -sizeZ);  // B-left of the quad (B)
-    glVertex3f(size, -sizeY, -sizeZ);  // B-right of the quad (B)
-
-    glNormal3f(0.0f, 0.0f, 0.5f);
-    glVertex3f(size,  sizeY, sizeZ);  // T-right of the quad (F)
-    glVertex3f(-size,  sizeY, sizeZ);  // T-left of the quad (F)
-    glVertex3f(-size, -sizeY, sizeZ);  // B-left of the quad (F)
-    glVertex3f(size, -sizeY, sizeZ);  // B-right of the quad (F)
-
-    glNormal3f(0.0f, 0.0f, -0.5f);
-    glVertex3f(size, -sizeY, -sizeZ);  // B-left of the quad (B)
-    glVertex3f(-size, -sizeY, -sizeZ);  // B-right of the quad (B)
-    glVertex3f(-size,  sizeY, -sizeZ);  // T-right of the quad (B)
-    glVertex3f(size,  sizeY, -sizeZ);  // T-left of the quad (B)
-
-    glNormal3f(-0.5f, 0.0f, 0.0f);
-    glVertex3f(-size,  sizeY,  sizeZ);  // T-right of the quad (L)
-    glVertex3f(-size,  sizeY, -sizeZ);  // T-left of the quad (L)
-    glVertex3f(-size, -sizeY, -sizeZ);  // B-left of the quad (L)
-    glVertex3f(-size, -sizeY,  sizeZ);  // B-right of the quad (L)
-
-    glNormal3f(0.5f, 0.0f, 0.0f);
-    glVertex3f(size,  sizeY, -sizeZ);  // T-right of the quad (R)
-    glVertex3f(size,  sizeY,  sizeZ);  // T-left of the quad (R)
-    glVertex3f(size, -sizeY,  sizeZ);  // B-left of the quad (R)
-    glVertex3f(size, -sizeY, -sizeZ);  // B-right of the quad (R)
-    glEnd();   // Done drawing the color cube
+/*! \brief True if the scene changes without any event, when spinning or
+ *  animating, so frames are drawn on a timer.
+ */
+bool GLWidget::isAnimating() const {
+    return spinup || spindown || spinleft || spinright || *animation;
 }
 
+/*! \brief Draw a frame.
+ *
+ * Frames are drawn when something calls update(), for example a camera
+ * move, an iteration load or a rule edit.  The frame timer is only started
+ * while spinning or animating, so an idle window draws nothing.
+ */
 void GLWidget::paintEvent(QPaintEvent */*event*/) {
+    QTime frameStart;
+    frameStart.start();
+    redrawCount++;
+
     paintGL();
 
     QPainter painter(this);
@@ -500,17 +394,37 @@ void GLWidget::paintEvent(QPaintEvent */*event*/) {
                 windowSize.height()-bbox.height(), *timeString);
     }
 
-    if (drawNameAgent) {
-        for (int i = 0; i < nameAgent.tags.size(); i++) {
+    if (drawNameAgent && nameAgent.type < agents->typeCount() &&
+            nameAgent.row < agents->type(nameAgent.type).count) {
+        const AgentColumns & columns = agents->type(nameAgent.type);
+        for (int i = 0; i < columns.variables.size(); i++) {
             painter.drawText(10, 20*(i+1), QString("%1\t%2").
-                    arg(nameAgent.tags[i], nameAgent.values[i]));
+                    arg(columns.variables[i],
+                        columns.text(i, nameAgent.row)));
         }
     }
 
+    if (debugOverlay) {
+        painter.setFont(QFont("Courier", 12));
+        painter.drawText(10, height() - 10, QString(
+                "frame %1 ms  redraws %2  vertices %3  chunks %4/%5  "
+                "peak %6 MB").
+                arg(frameTime).arg(redrawCount).
+                arg(renderer->vertexCount()).
+                arg(renderer->drawnChunkCount()).
+                arg(renderer->chunkCount()).
+                arg(peakMemoryUsage() / (1024 * 1024)));
+    }
+
     painter.end();
 
     glFlush();
 
+    if (snapshotRequested) {
+        snapshotRequested = false;
+        grabSnapshot();
+    }
+
     if (spinup)    *yrotate -= 1.0;
     if (spindown)  *yrotate += 1.0;
     if (spinleft)  *xrotate -= 1.0;
@@ -521,14 +435,17 @@ void GLWidget::paintEvent(QPaintEvent */*event*/) {
     if (delay == 0) delay = 1;
     time = QTime::currentTime();
     /* Start the timer with timeout units of milliseconds */
-    timer->start(qMax(0, 20 - delay));
+    if (isAnimating()) timer->start(qMax(0, 20 - delay));
+    frameTime = frameStart.elapsed();
 
+    /* Wait for the image writer to catch up before the next iteration */
+    bool imageLock = animationImages && imageWriter->isFull();
     if (*animation && !locked && !imageLock && !delayLock) {
         if (delayTime > 0) {
             delayLock = true;
             delayTimer->start(delayTime);
         }
-        if (animationImages) takeSnapshot();
+        if (animationImages) grabSnapshot();
         emit(increase_iteration());
     }
 }
@@ -567,7 +484,8 @@ void GLWidget::mouseMoveEvent(QMouseEvent *event) {
 
     x_last_position = event->x();
     y_last_position = event->y();
-    update();
+    /* Moving the mouse without a button changes nothing */
+    if (event->buttons() & (Qt::LeftButton | Qt::RightButton)) update();
 }
 
 void GLWidget::wheelEvent(QWheelEvent * event) {
@@ -588,15 +506,19 @@ void GLWidget::keyPressEvent(QKeyEvent* event) {
             break;
         case Qt::Key_Left:
             spinleft = true;
+            update();
             break;
         case Qt::Key_Right:
             spinright = true;
+            update();
             break;
         case Qt::Key_Up:
             spinup = true;
+            update();
             break;
         case Qt::Key_Down:
             spindown = true;
+            update();
             break;
         case Qt::Key_Z:
             emit(decrease_iteration());
@@ -606,6 +528,11 @@ void GLWidget::keyPressEvent(QKeyEvent* event) {
             break;
         case Qt::Key_A:
             emit(signal_toggleAnimation());
+            update();
+            break;
+        case Qt::Key_D:
+            debugOverlay = !debugOverlay;
+            update();
             break;
         case Qt::Key_P:
             pickOn = true;
@@ -651,113 +578,84 @@ void GLWidget::keyReleaseEvent(QKeyEvent* event) {
     }
 }
 
-/* The buffer size for picking objects */
-#define BUFSIZE 512
+/*! \brief Pick the agent under the mouse and show its memory.
+ *
+ * The mouse position is unprojected onto the near and far planes and the
+ * ray between them is cast through the agent picker.  A pixel step is
+ * unprojected too so points can be picked within a few pixels.
+ *  \param mx The mouse x position
+ *  \param my The mouse y position
+ */
 void GLWidget::processSelection(int mx, int my) {
-    GLuint select_buf[BUFSIZE];  // selection buffer
-    GLint hits;  // number of hits
-    GLint  viewport[4];
-
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLdouble modelview[16];
+    GLdouble projection[16];
+    GLint viewport[4];
 
-    glSelectBuffer(BUFSIZE, select_buf);
-    glRenderMode(GL_SELECT);
-    glInitNames();
-    glPushName(0);
-
-    // glViewport(0, 0, windowWidth, windowHeight);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPickMatrix((GLdouble) mx, (GLdouble) (viewport[3] - my),
-            5.0, 5.0, viewport);
-    gluPerspective(45.0f, window_ratio, zNear, 20.0f);
+    makeCurrent();
     glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glPushMatrix();
-
-    glTranslatef(*xmove, *ymove, *zmove);
-    glRotatef(*yrotate, 1.0f, 0.0f, 0.0f);
-    glRotatef(*xrotate, 0.0f, 0.0f, 1.0f);
-
-    drawAgents(GL_SELECT);
-
+    glLoadIdentity();
+    setupCamera(*xrotate, *yrotate, *xmove, *ymove, *zmove);
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
     glPopMatrix();
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
 
-    hits = glRenderMode(GL_RENDER);
+    /* Window y is from the bottom */
+    GLdouble wx = mx;
+    GLdouble wy = windowHeight - my;
+    GLdouble nearPoint[3], farPoint[3], nearStep[3], farStep[3];
+    gluUnProject(wx, wy, 0.0, modelview, projection, viewport,
+            &nearPoint[0], &nearPoint[1], &nearPoint[2]);
+    gluUnProject(wx, wy, 1.0, modelview, projection, viewport,
+            &farPoint[0], &farPoint[1], &farPoint[2]);
+    gluUnProject(wx + 1.0, wy, 0.0, modelview, projection, viewport,
+            &nearStep[0], &nearStep[1], &nearStep[2]);
+    gluUnProject(wx + 1.0, wy, 1.0, modelview, projection, viewport,
+            &farStep[0], &farStep[1], &farStep[2]);
+    double nearPixel = sqrt(
+            (nearStep[0]-nearPoint[0])*(nearStep[0]-nearPoint[0]) +
+            (nearStep[1]-nearPoint[1])*(nearStep[1]-nearPoint[1]) +
+            (nearStep[2]-nearPoint[2])*(nearStep[2]-nearPoint[2]));
+    double farPixel = sqrt(
+            (farStep[0]-farPoint[0])*(farStep[0]-farPoint[0]) +
+            (farStep[1]-farPoint[1])*(farStep[1]-farPoint[1]) +
+            (farStep[2]-farPoint[2])*(farStep[2]-farPoint[2]));
+
+    Dimension * limits = restrictAxesOn ? restrictDimension : 0;
+    if (picker->needsBuild(limits)) picker->build(model, limits);
+    RuleAgent * a = picker->pick(nearPoint, farPoint, nearPixel, farPixel);
 
     drawNameAgent = false;
 
-    int i, j;
-    int nitems, zmin, item = 0;
-    //  int zmax;
-    int minimumDepth = 0;
-    int pickItem = -1;
-
-    // qDebug() << "hits = " << hits;
-    int index = 0;
-    for (i = 0; i < hits; i++) {
-        nitems = select_buf[index++];
-        zmin = select_buf[index++];
-        //  zmax = select_buf[index++];
-        index++;
-
-        // qDebug() << zmin << zmax;
-        for (j = 0; j < nitems; j++) {
-            item = select_buf[index++];
-            // qDebug() << j << item ;
-        }
-
-        /* Ignore item=0 as these are the backside of objects if transparent */
-        if (item > 0) {
-            // qDebug() << item << zmin << zmax;
-
-            if (i == 0) {
-                minimumDepth = zmin;
-                pickItem = item;
-            } else if (zmin < minimumDepth) {
-                minimumDepth = zmin;
-                pickItem = item;
-            }
-        }
-    }
-    if (pickItem != -1) {
-        RuleAgent * a = nameAgents.value(pickItem);
-        nameAgent.tags = QStringList(a->agent->tags);
-        nameAgent.values = QStringList(a->agent->values);
+    if (a != 0) {
+        nameAgent = a->agent;
         drawNameAgent = false;  // true;
 
         a->isPicked = true;
+        renderer->invalidate();
+        update();
 
         /* Release of button p is not caught because the focus is given to the
          * agent dialog */
         pickOn = false;
         /* Create dialog */
-        AgentDialog * agentDialog = new AgentDialog(a->agent, this);
+        AgentDialog * agentDialog = new AgentDialog(agents, a->agent,
+                agentsFileName ? *agentsFileName : QString(), this);
         agentDialog->show();
     }
-
-    resizeGL(windowWidth, windowHeight);
 }
 
 void GLWidget::restrictAxes(bool b) {
     restrictAxesOn = b;
+    update();
 }
 
-float GLWidget::SphereInFrustum(float x, float y, float z, float radius) {
-    int p;
-    float d;
-
-    for (p = 0; p < 6; p++) {
-        d = frustum[p][0] * x + frustum[p][1] * y +
-            frustum[p][2] * z + frustum[p][3];
-        if (d <= -radius) return 0;
-    }
-    return d + radius;
-}
-
-void GLWidget::ExtractFrustum() {
+/*! \brief The six planes of the view frustum of the current projection and
+ *  modelview matrices, normalised.
+ *  \param frustum The planes
+ */
+void GLWidget::ExtractFrustum(float frustum[6][4]) {
     float   proj[16];
     float   modl[16];
     float   clip[16];
@@ -19,10 +19,14 @@
         #include <GL/glu.h>
     #endif
 #endif
-#include "./agent.h"
+#include "./agentstore.h"
 #include "./visualsettingsmodel.h"
 #include "./dimension.h"
 #include "./timescale.h"
+#include "./agentrenderer.h"
+#include "./agentpicker.h"
+#include "./framegrabber.h"
+#include "./imagewriter.h"
 
 class QTimer;
 
@@ -33,25 +37,33 @@ class GLWidget : public QGLWidget {
     GLWidget(float * xr, float * yr, float * xm, float * ym, float * zm,
             Dimension * rd, float * oz, bool * ani, QWidget *parent = 0);
     ~GLWidget();
-    void update_agents(QList<Agent*> * a);
+    void update_agents(AgentStore * a);
     void set_rules(VisualSettingsModel * m);
     void reset_camera();
     QString getName() { return name; }
     void setName(QString n) { name = n; }
     void setIteration(int * i) { iteration = i; }
     void setConfigPath(QString * cp) { configpath = cp; }
+    void setAgentsFileName(QString * f) { agentsFileName = f; }
     void setTimeScale(TimeScale * ts) { timeScale = ts; }
     void setTimeString(QString * t) { timeString = t; }
     void setDimension(int d);
     QColor getBackgroundColour() { return background; }
     void setBackgroundColour(QColor b);
+    static void setupLighting(const QColor & background);
+    static void setupProjection(int d, int w, int h, float zoom, float zn);
+    static void setupCamera(float xr, float yr, float xm, float ym, float zm);
+    static void ExtractFrustum(float frustum[6][4]);
 
   public slots:
     void iterationLoaded();
+    void agentsChanged();
     void nextIteration();
     void takeSnapshot();
     void takeAnimation(bool);
     void updateImagesLocation(QString);
+    void updateImagesFormat(QString);
+    void updateImagesStream(QString);
     void restrictAxes(bool);
     void updateDelayTime(int);
 
@@ -60,6 +72,7 @@ class GLWidget : public QGLWidget {
     void decrease_iteration();
     void visual_window_closed();
     void imageStatus(QString);
+    void imageQueueChanged(int);
     void signal_toggleAnimation();
 
   protected:
@@ -77,16 +90,14 @@ class GLWidget : public QGLWidget {
 
   private slots:
     void unlockDelayTime();
+    void writeSnapshots();
 
   private:
+    bool isAnimating() const;
     void processSelection(int mx, int my);
-    void drawAgents(GLenum mode);
-    void drawCube(float sizeX, float sizeY, float sizeZ);
-    void drawSphere(double size);
-    float SphereInFrustum(float x, float y, float z, float radius);
-    void ExtractFrustum();
+    void grabSnapshot();
     QString name;
-    QList<Agent*> * agents;
+    AgentStore * agents;
     bool block;
     float * xrotate;
     float * yrotate;
@@ -109,9 +120,13 @@ class GLWidget : public QGLWidget {
     bool * animation;
     bool locked;
     bool animationImages;
-    bool imageLock;
+    bool snapshotRequested;  /*!< \brief Grab the next frame drawn */
     QString imagesLocation;
+    QString imagesFormat;  /*!< \brief jpg, png, ppm or a stream */
+    QString imagesStream;  /*!< \brief The stream file, - for stdout */
     QString * configpath;
+    /*! \brief The iteration file the agents were read from */
+    QString * agentsFileName;
     bool pickOn;
     float window_ratio;
     TimeScale * timeScale;
@@ -119,8 +134,7 @@ class GLWidget : public QGLWidget {
     float zNear;  /*!< \brief The near clipping plane */
     bool clippingOn;
     int windowWidth, windowHeight;
-    QHash<int, RuleAgent*> nameAgents;
-    Agent nameAgent;  /*!< \brief A copy of the picked agent */
+    Agent nameAgent;  /*!< \brief The picked agent */
     bool drawNameAgent;
     bool moveOn;
     Dimension * restrictDimension;
@@ -128,15 +142,19 @@ class GLWidget : public QGLWidget {
     bool delayLock;
     int delayTime;
     int dimension;
-    GLuint nPartsList; /*!< \brief Use with display lists */
-    GLuint SPHERE_4;  /*!< \brief Sphere with grade 4 */
-    GLuint SPHERE_8;  /*!< \brief Sphere with grade 8 */
-    GLuint SPHERE_16;  /*!< \brief Sphere with grade 16 */
-    GLuint SPHERE_32;  /*!< \brief Sphere with grade 32 */
-    GLuint SPHERE_64;  /*!< \brief Sphere with grade 64 */
-    GLUquadricObj * dl_qobj;
     float frustum[6][4];
     QColor background;
+    /*! \brief Draws the rule agents from vertex buffers */
+    AgentRenderer * renderer;
+    /*! \brief Finds the rule agent under the mouse */
+    AgentPicker * picker;
+    /*! \brief Reads snapshots back without waiting */
+    FrameGrabber * grabber;
+    /*! \brief Encodes snapshots on worker threads */
+    ImageWriter * imageWriter;
+    bool debugOverlay;  /*!< \brief Show frame time and redraw count */
+    int redrawCount;  /*!< \brief The number of frames drawn */
+    int frameTime;  /*!< \brief The time to draw the last frame in ms */
 };
 
 #endif  // GLWIDGET_H_
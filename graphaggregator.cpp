@@ -0,0 +1,134 @@
+/*!
+ * \file graphaggregator.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of graph aggregator
+ */
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include "./graphaggregator.h"
+#include "./condition.h"
+
+/*! \brief The conditions of the plots of one agent type, resolved to
+ *  columns.
+ */
+struct TypeConditions {
+    int rows;
+    QList<GraphSettingsItem *> plots;
+    QVector<const double *> columns;
+    QVector<Condition::Operator> ops;
+    QVector<double> values;
+};
+
+/*! \brief Counts the agents passing each condition of one type in a range
+ *  of rows, on a worker thread.
+ */
+class RangeCounter : public QRunnable {
+  public:
+    RangeCounter(const TypeConditions * c, int b, int e) {
+        conditions = c;
+        begin = b;
+        end = e;
+        counts.fill(0, c->plots.count());
+        setAutoDelete(false);
+    }
+
+    void run() {
+        int n = counts.count();
+        const double * const * columns = conditions->columns.constData();
+        const Condition::Operator * ops = conditions->ops.constData();
+        const double * values = conditions->values.constData();
+        int * c = counts.data();
+        for (int row = begin; row < end; row++)
+            for (int k = 0; k < n; k++)
+                if (Condition::compare(ops[k], columns[k][row], values[k]))
+                    c[k]++;
+    }
+
+    const TypeConditions * conditions;
+    QVector<int> counts;
+
+  private:
+    int begin;
+    int end;
+};
+
+GraphAggregator::GraphAggregator() {
+    threadCount = 0;
+}
+
+/*! \brief Count the agents of each plot.
+ *  \param agents The agents of the iteration
+ *  \param plots The plots, a plot may be given more than once
+ *  \return The count of each plot
+ */
+PlotCounts GraphAggregator::aggregate(const AgentStore & agents,
+        const QList<GraphSettingsItem *> & plots) const {
+    PlotCounts counts;
+    QHash<int, TypeConditions> types;
+
+    for (int j = 0; j < plots.count(); j++) {
+        GraphSettingsItem * plot = plots.at(j);
+        if (counts.contains(plot)) continue;
+        counts.insert(plot, 0);
+
+        /* Only agents of the plot agent type */
+        int type = agents.typeIndex(plot->getYaxis());
+        if (type == -1) continue;
+        const AgentColumns & columns = agents.type(type);
+        Condition condition = plot->condition();
+        /* If a condition is enabled then it is counted in the pass */
+        if (condition.enable) {
+            int variable = columns.variableIndex(condition.variable);
+            if (variable != -1) {
+                TypeConditions & c = types[type];
+                c.rows = columns.count;
+                c.plots.append(plot);
+                c.columns.append(columns.column(variable));
+                c.ops.append(condition.getOperator());
+                c.values.append(condition.value);
+            }
+        } else {
+            counts[plot] = columns.count;
+        }
+    }
+    if (types.isEmpty()) return counts;
+
+    /* Split the rows of each type into ranges for the worker threads */
+    int threads = (threadCount > 0) ? threadCount :
+            qMax(QThread::idealThreadCount(), 1);
+    QList<RangeCounter *> counters;
+    QHash<int, TypeConditions>::const_iterator i;
+    for (i = types.constBegin(); i != types.constEnd(); ++i) {
+        const TypeConditions & c = i.value();
+        int ranges = qBound(1, c.rows / minimumRows, threads);
+        for (int r = 0; r < ranges; r++)
+            counters.append(new RangeCounter(&c,
+                    static_cast<int>(static_cast<qint64>(c.rows) * r /
+                        ranges),
+                    static_cast<int>(static_cast<qint64>(c.rows) * (r + 1) /
+                        ranges)));
+    }
+
+    if (counters.count() == 1) {
+        counters.at(0)->run();
+    } else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(qMin(counters.count(), threads));
+        for (int r = 0; r < counters.count(); r++) pool.start(counters.at(r));
+        pool.waitForDone();
+    }
+
+    for (int r = 0; r < counters.count(); r++) {
+        const RangeCounter * counter = counters.at(r);
+        for (int k = 0; k < counter->counts.count(); k++)
+            counts[counter->conditions->plots.at(k)] +=
+                    counter->counts.at(k);
+    }
+
+    qDeleteAll(counters);
+    return counts;
+}
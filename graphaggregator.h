@@ -0,0 +1,42 @@
+/*!
+ * \file graphaggregator.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for graph aggregator
+ */
+#ifndef GRAPHAGGREGATOR_H_
+#define GRAPHAGGREGATOR_H_
+
+#include <QHash>
+#include <QList>
+#include "./agentstore.h"
+#include "./graphsettingsitem.h"
+
+/*! \brief The agent count of each plot for one iteration */
+typedef QHash<GraphSettingsItem *, int> PlotCounts;
+
+/*! \brief Counts the agents of every plot of the open graph windows.
+ *
+ * Plots are grouped by agent type.  A plot without a condition is the
+ * type count.  The plots of a type with conditions are counted together
+ * in one pass over the rows of the type, split into ranges over worker
+ * threads when there are many rows, so each agent is read once whatever
+ * the number of plots and graph windows.
+ */
+class GraphAggregator {
+  public:
+    GraphAggregator();
+
+    void setThreadCount(int t) { threadCount = t; }
+    PlotCounts aggregate(const AgentStore & agents,
+            const QList<GraphSettingsItem *> & plots) const;
+
+    /*! \brief The fewest rows given to one worker thread */
+    static const int minimumRows = 1 << 16;
+
+  private:
+    int threadCount;  /*!< \brief Worker threads, 0 for one per core */
+};
+
+#endif  // GRAPHAGGREGATOR_H_
@@ -0,0 +1,292 @@
+/*!
+ * \file graphbackfill.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of graph backfill
+ */
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QByteArray>
+#include <QStringList>
+#include <QtConcurrentMap>
+#include <ctype.h>
+#include <string.h>
+#include "./graphbackfill.h"
+#include "./fastzeroxmlreader.h"
+#include "./iterationindex.h"
+#include "./textsearch.h"
+
+/*! \brief How many agents are counted between checks for cancel */
+static const int abortInterval = 1024;
+
+/*! \brief Find the text of an element between begin and end.
+ *  \param tag The start tag, for example <name>
+ *  \return False if the element is not there
+ */
+static bool elementText(const char * begin, const char * end,
+        const QByteArray & tag, const char ** text, const char ** textEnd) {
+    const char * t = findText(begin, end, tag.constData(), tag.size());
+    if (t == 0) return false;
+    *text = t + tag.size();
+    const char * c = static_cast<const char *>(
+            memchr(*text, '<', end - *text));
+    if (c == 0) return false;
+    *textEnd = c;
+    return true;
+}
+
+/*! \brief The number in element text, zero if not a number as when read */
+static double elementValue(const char * begin, const char * end) {
+    double d;
+    if (FastZeroXMLReader::parseNumber(begin, end, &d)) return d;
+    bool ok;
+    d = QString::fromUtf8(begin, end - begin).toDouble(&ok);
+    return ok ? d : 0.0;
+}
+
+/*! \brief Count one agent for the plots of its type.
+ *  \param begin The start of the agent element
+ *  \param end The end of the agent element
+ *  \param indices The plots of the agent type
+ *  \param specs The plots
+ *  \param tags The start tag of each plot condition variable
+ *  \param counts The count of each plot
+ */
+static void countAgent(const char * begin, const char * end,
+        const QList<int> & indices, const QList<PlotSpec> & specs,
+        const QVector<QByteArray> & tags, QVector<int> * counts) {
+    for (int i = 0; i < indices.count(); i++) {
+        int k = indices.at(i);
+        const PlotSpec & spec = specs.at(k);
+        if (!spec.conditional) {
+            (*counts)[k]++;
+            continue;
+        }
+        const char * text;
+        const char * textEnd;
+        if (!elementText(begin, end, tags.at(k), &text, &textEnd)) continue;
+        if (Condition::compare(spec.op, elementValue(text, textEnd),
+                spec.value))
+            (*counts)[k]++;
+    }
+}
+
+/*! \brief Counts one iteration file for QtConcurrent::mapped.
+ */
+class FileCounter {
+  public:
+    typedef IterationCounts result_type;
+
+    FileCounter(const QString & d, const QList<PlotSpec> & s,
+            const QAtomicInt * a) {
+        directory = d;
+        specs = s;
+        abort = a;
+    }
+
+    IterationCounts operator()(int iteration) const {
+        IterationCounts result;
+        result.iteration = iteration;
+        result.ok = GraphBackfill::countFile(
+                QString("%1/%2.xml").arg(directory).arg(iteration),
+                specs, abort, &result.counts);
+        return result;
+    }
+
+  private:
+    QString directory;
+    QList<PlotSpec> specs;
+    const QAtomicInt * abort;
+};
+
+GraphBackfill::GraphBackfill(QObject * parent)
+    : QObject(parent) {
+    watcher = 0;
+    aborted = 0;
+    done = 0;
+    total = 0;
+}
+
+GraphBackfill::~GraphBackfill() {
+    cancel();
+    /* Files being counted use the abort flags */
+    for (int i = 0; i < stopped.count(); i++)
+        stopped.at(i)->waitForFinished();
+    qDeleteAll(stoppedFlags);
+}
+
+/*! \brief The iterations of the results directory, from the N.xml files.
+ *  \param directory The results directory
+ *  \return The iterations in order
+ */
+QList<int> GraphBackfill::iterations(const QString & directory) {
+    return IterationIndex::scan(directory).toList();
+}
+
+/*! \brief Count the agents of each plot in an iteration file.
+ *  \param fileName The iteration file
+ *  \param specs The plots
+ *  \param abort Stops counting when set
+ *  \param counts The count of each plot
+ *  \return False if the file could not be counted, is partly written or
+ *  counting was stopped
+ */
+bool GraphBackfill::countFile(const QString & fileName,
+        const QList<PlotSpec> & specs, const QAtomicInt * abort,
+        QVector<int> * counts) {
+    counts->fill(0, specs.count());
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) return false;
+    qint64 size = file.size();
+    if (size <= 0) return false;
+    QByteArray contents;
+    uchar * mapped = file.map(0, size);
+    const char * data = reinterpret_cast<const char *>(mapped);
+    if (data == 0) {
+        contents = file.readAll();
+        data = contents.constData();
+        size = contents.size();
+    }
+    const char * end = data + size;
+
+    /* The plots of each agent type and the tags of their variables */
+    QHash<QByteArray, QList<int> > types;
+    QVector<QByteArray> tags(specs.count());
+    for (int k = 0; k < specs.count(); k++) {
+        types[specs.at(k).type.toUtf8()].append(k);
+        tags[k] = "<" + specs.at(k).variable.toUtf8() + ">";
+    }
+
+    bool ok = true;
+    /* The environment is counted as one agent of type environment */
+    QHash<QByteArray, QList<int> >::const_iterator environment =
+            types.constFind("environment");
+    if (environment != types.constEnd()) {
+        const char * e = findText(data, end, "<environment>", 13);
+        const char * eEnd = e ? findText(e, end, "</environment>", 14) : 0;
+        if (eEnd) countAgent(e, eEnd, environment.value(), specs, tags,
+                counts);
+    }
+
+    static const QByteArray nameTag("<name>");
+    const char * p = data;
+    int agents = 0;
+    while ((p = findText(p, end, "<xagent>", 8)) != 0) {
+        if (++agents % abortInterval == 0 && *abort != 0) {
+            ok = false;
+            break;
+        }
+        const char * agentEnd = findText(p, end, "</xagent>", 9);
+        if (agentEnd == 0) {
+            /* Partly written */
+            ok = false;
+            break;
+        }
+
+        const char * name;
+        const char * nameEnd;
+        if (elementText(p, agentEnd, nameTag, &name, &nameEnd)) {
+            while (name < nameEnd && isspace(static_cast<uchar>(*name)))
+                name++;
+            while (nameEnd > name &&
+                    isspace(static_cast<uchar>(*(nameEnd - 1))))
+                nameEnd--;
+            QHash<QByteArray, QList<int> >::const_iterator type =
+                    types.constFind(QByteArray::fromRawData(name,
+                        nameEnd - name));
+            if (type != types.constEnd())
+                countAgent(p, agentEnd, type.value(), specs, tags, counts);
+        }
+        p = agentEnd + 9;
+    }
+
+    if (mapped) file.unmap(mapped);
+    return ok;
+}
+
+/*! \brief Count every iteration file for the plots, stopping any count
+ *  already running.
+ *  \param directory The results directory
+ *  \param its The iterations of the results directory
+ *  \param plotList The plots of the open graph windows
+ */
+void GraphBackfill::start(const QString & directory, const QList<int> & its,
+        const QList<GraphSettingsItem *> & plotList) {
+    cancel();
+
+    plots.clear();
+    QList<PlotSpec> specs;
+    for (int j = 0; j < plotList.count(); j++) {
+        GraphSettingsItem * plot = plotList.at(j);
+        if (plots.contains(plot)) continue;
+        plots.append(plot);
+        Condition condition = plot->condition();
+        PlotSpec spec;
+        spec.type = plot->getYaxis();
+        spec.conditional = condition.enable;
+        spec.variable = condition.variable;
+        spec.op = condition.getOperator();
+        spec.value = condition.value;
+        specs.append(spec);
+    }
+    if (plots.isEmpty()) return;
+
+    done = 0;
+    total = its.count();
+    aborted = new QAtomicInt(0);
+    watcher = new QFutureWatcher<IterationCounts>(this);
+    connect(watcher, SIGNAL(resultReadyAt(int)),
+            this, SLOT(resultReady(int)));
+    connect(watcher, SIGNAL(finished()), this, SLOT(watcherFinished()));
+    watcher->setFuture(QtConcurrent::mapped(its,
+            FileCounter(directory, specs, aborted)));
+}
+
+/*! \brief Stop counting without waiting.  Files being counted stop within
+ *  a few agents and the run is freed by stoppedFinished.
+ */
+void GraphBackfill::cancel() {
+    if (!watcher) return;
+    disconnect(watcher, 0, this, 0);
+    *aborted = 1;
+    watcher->cancel();
+    if (watcher->isFinished()) {
+        watcher->deleteLater();
+        delete aborted;
+    } else {
+        stopped.append(watcher);
+        stoppedFlags.append(aborted);
+        connect(watcher, SIGNAL(finished()), this, SLOT(stoppedFinished()));
+    }
+    watcher = 0;
+    aborted = 0;
+}
+
+void GraphBackfill::stoppedFinished() {
+    QFutureWatcher<IterationCounts> * w =
+            static_cast<QFutureWatcher<IterationCounts> *>(sender());
+    int i = stopped.indexOf(w);
+    if (i == -1) return;
+    delete stoppedFlags.takeAt(i);
+    stopped.removeAt(i);
+    w->deleteLater();
+}
+
+void GraphBackfill::resultReady(int index) {
+    IterationCounts result = watcher->resultAt(index);
+    done++;
+    if (result.ok) {
+        PlotCounts counts;
+        for (int k = 0; k < plots.count() && k < result.counts.count(); k++)
+            counts.insert(plots.at(k), result.counts.at(k));
+        emit(countsReady(result.iteration, counts));
+    }
+    emit(progress(done, total));
+}
+
+void GraphBackfill::watcherFinished() {
+    emit(finished());
+}
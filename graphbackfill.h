@@ -0,0 +1,90 @@
+/*!
+ * \file graphbackfill.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for graph backfill
+ */
+#ifndef GRAPHBACKFILL_H_
+#define GRAPHBACKFILL_H_
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include "./graphsettingsitem.h"
+#include "./graphaggregator.h"
+#include "./condition.h"
+
+/*! \brief What is needed to count one plot, copied so worker threads never
+ *  touch the plot itself */
+struct PlotSpec {
+    QString type;  /*!< \brief The agent type */
+    bool conditional;
+    QString variable;
+    Condition::Operator op;
+    double value;
+};
+
+/*! \brief The plot counts of one iteration file */
+struct IterationCounts {
+    int iteration;
+    bool ok;  /*!< \brief False if the file could not be counted */
+    QVector<int> counts;  /*!< \brief One count per plot spec */
+};
+
+/*! \brief Fills the graphs with every iteration of the run in the
+ *  background.
+ *
+ * The iteration files of the results directory are counted in parallel on
+ * the global thread pool.  Counting does not build an agent store: each
+ * xagent is looked at only for its name and the variables used by plot
+ * conditions of its type, and agents of types no plot uses are skipped.
+ * The counts of each file are passed on as soon as the file is done.
+ * Cancelling stops any file being counted within a few agents, without
+ * waiting for them, and the counts of a cancelled run are never passed on.
+ */
+class GraphBackfill : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit GraphBackfill(QObject * parent = 0);
+    ~GraphBackfill();
+
+    void start(const QString & directory, const QList<int> & its,
+            const QList<GraphSettingsItem *> & plots);
+    void cancel();
+    bool isRunning() const { return watcher && watcher->isRunning(); }
+
+    static QList<int> iterations(const QString & directory);
+    static bool countFile(const QString & fileName,
+            const QList<PlotSpec> & specs, const QAtomicInt * abort,
+            QVector<int> * counts);
+
+  signals:
+    /*! \brief The plot counts of one iteration are ready */
+    void countsReady(int iteration, const PlotCounts & counts);
+    /*! \brief The number of iteration files counted so far */
+    void progress(int done, int total);
+    void finished();
+
+  private slots:
+    void resultReady(int index);
+    void watcherFinished();
+    void stoppedFinished();
+
+  private:
+    /*! \brief Watches the run counting, 0 if none */
+    QFutureWatcher<IterationCounts> * watcher;
+    QList<GraphSettingsItem *> plots;  /*!< \brief Keys only, never used */
+    QAtomicInt * aborted;  /*!< \brief Set to stop files being counted */
+    /*! \brief Cancelled runs still counting, with their abort flags */
+    QList<QFutureWatcher<IterationCounts> *> stopped;
+    QList<QAtomicInt *> stoppedFlags;
+    int done;
+    int total;
+};
+
+#endif  // GRAPHBACKFILL_H_
@@ -9,17 +9,24 @@
 #include <QDebug>
 #include <QtGui/QMouseEvent>
 #include <QMenuBar>
+#include <limits.h>
 #include "./graphwidget.h"
 #include "./condition.h"
 
-GraphWidget::GraphWidget(QList<Agent*> *a, int * gs,
-    TimeScale * ts, QWidget *parent)
+GraphWidget::GraphWidget(int * gs, TimeScale * ts, QWidget *parent)
     : QWidget(parent) {
-    agents = a;
     topValue = 0;
     topIteration = 0;
     style = gs;
     timeScale = ts;
+    cacheStyle = -1;
+    cacheIteration = -1;
+    axisValue = 1;
+    axisIterations = 1;
+    xleft = 0;
+    xright = 1;
+    ytop = 0;
+    ybottom = 1;
     setFocus();
 }
 
@@ -36,7 +43,11 @@ void GraphWidget::addPlot(GraphSettingsItem *gsi) {
 
 int GraphWidget::removePlot(GraphSettingsItem *gsi) {
     for (int i = 0; i < plots.count(); i++) {
-        if (plots.at(i) == gsi) plots.removeAt(i);
+        if (plots.at(i) == gsi) {
+            plots.removeAt(i);
+            data.removeAt(i);
+            i--;
+        }
     }
 
     return plots.count();
@@ -77,8 +88,66 @@ void GraphWidget::drawStylePoint(int type, int size, int x1, int y1,
     }
 }
 
-void GraphWidget::paintEvent(QPaintEvent */*event*/) {
-    QPainter painter(this);
+/*! \brief The smallest of 1, 2 or 5 times a power of ten not below a
+ *  value, so the axes only change scale now and then as a run grows.
+ */
+static int niceCeiling(int value) {
+    int step = 1;
+    while (true) {
+        if (value <= step) return step;
+        if (value <= 2 * step) return 2 * step;
+        if (value <= 5 * step) return 5 * step;
+        if (step > INT_MAX / 10) return value;
+        step *= 10;
+    }
+}
+
+/*! \brief A key of the legend, when it changes the cache is redrawn */
+QString GraphWidget::legendKey() {
+    QString key = QString("%1").arg(plots.count());
+    for (int j = 0; j < plots.count(); j ++) {
+        key.append(QString("|%1|%2|%3").arg(plots[j]->getYaxis(),
+                plots[j]->condition().enable ?
+                    plots[j]->condition().getString() : QString(),
+                QString::number(plots[j]->getColour().rgba())));
+    }
+    return key;
+}
+
+/*! \brief True if the cached image can be drawn as it is.
+ */
+bool GraphWidget::cacheCurrent() {
+    return !cache.isNull() && cache.size() == size() &&
+            cacheStyle == *style && cacheKey == legendKey() &&
+            topValue <= axisValue && topIteration <= axisIterations;
+}
+
+/*! \brief The window x of an iteration */
+int GraphWidget::xPosition(int iteration) const {
+    return xleft+( (iteration/static_cast<double>(axisIterations))*
+            (xright-xleft));
+}
+
+/*! \brief The window y of a plot value */
+int GraphWidget::yPosition(int value) const {
+    return ybottom-( ((value/static_cast<double>(axisValue)))*
+            (ybottom-ytop) );
+}
+
+/*! \brief Draw the legend, axes and every data point into the cache.
+ *
+ * Iterations that fall in the same pixel column are drawn as one vertical
+ * line from their lowest to their highest value, so the cost depends on
+ * the window width rather than the number of iterations.
+ */
+void GraphWidget::drawCache() {
+    cache = QImage(size(), QImage::Format_RGB32);
+    cacheStyle = *style;
+    cacheKey = legendKey();
+    axisValue = niceCeiling(qMax(topValue, 1));
+    axisIterations = niceCeiling(qMax(topIteration, 1));
+
+    QPainter painter(&cache);
 
     // painter.setWindow( 0, 0, 800, 200 );
 
@@ -89,10 +158,10 @@ void GraphWidget::paintEvent(QPaintEvent */*event*/) {
     QSize windowSize = size();
     int width = windowSize.width();
     int height = windowSize.height();
-    int xleft = 0;
-    int xright = width-40;
-    int ytop = 20;
-    int ybottom = height-40;
+    xleft = 0;
+    xright = width-40;
+    ytop = 20;
+    ybottom = height-40;
 
     painter.fillRect(0, 0, width, height, QBrush(Qt::white));
 
@@ -119,62 +188,144 @@ void GraphWidget::paintEvent(QPaintEvent */*event*/) {
         if (xright > (width-bbox.width()-10)) xright = width-bbox.width()-10;
     }
 
-    // Use topValue to position xright and xleft
+    // Use axisValue to position xright and xleft
     const QRect bbox(painter.boundingRect(QRect(0, 0, 0, 0),
-            Qt::AlignLeft, QString("%1").arg(topValue)));
+            Qt::AlignLeft, QString("%1").arg(axisValue)));
     xright -= bbox.width() + 10;
     xleft += bbox.width() + 15;
+    if (xright <= xleft) xright = xleft + 1;
 
     painter.setPen(QPen(Qt::black));
     /* Draw graph markers */
     // Y-axis
     painter.drawText(5, ytop-5, bbox.width(), 10,
-            Qt::AlignRight | Qt::AlignVCenter, QString("%1").arg(topValue));
+            Qt::AlignRight | Qt::AlignVCenter, QString("%1").arg(axisValue));
     painter.drawLine(xleft, ytop, xleft-5, ytop);
-    /*int mod = 1;
-    int tp = topValue;
-    while(mod != 0 && tp > 0) {
-        mod = tp%10;
-        if(mod != 0) tp--;
-    }
-    qDebug() << tp;
-    if(tp > 9) {
-        int tip = ybottom-(((tp/static_cast<double>(topValue)))*(ybottom-ytop));
-        painter.drawLine(xleft, tip, xleft-5, tip);
-        painter.drawText(5, tip+5, QString("%1").arg(tp));
-        int tip5 = ybottom-((((tp/2.0)/static_cast<double>(topValue)))*(ybottom-ytop));
-        painter.drawLine(xleft, tip5, xleft-5, tip5);
-        painter.drawText(5, tip5+5, QString("%1").arg(tp/2.0));
-
-    }*/
     painter.drawText(5, ybottom-5, bbox.width(), 10,
             Qt::AlignRight | Qt::AlignVCenter, QString("0"));
     painter.drawLine(xleft, ybottom, xleft-5, ybottom);
 
-
     // X-axis
     // 0
     painter.drawLine(xleft, ybottom, xleft, ybottom+5);
     painter.drawText(xleft-15, ybottom+10, bbox.width(), 10,
                      Qt::AlignCenter, QString("0"));
-    // tics
-    /*if (timeScale->days >= 4) {
-        int mod = 1;
-        int topDays = timeScale->days;
-        while(mod != 0 && topDays > 0) {
-            mod = topDays%4;
-            if(mod != 0) topDays--;
-        }
-
-        int mdays = topDays/2.0;
-        int x1 = xleft+( ((mdays)/static_cast<double>(topIteration))*(xright-xleft));
-        painter.drawLine(x1, ybottom, x1, ybottom+5);
-        const QRect bbox(painter.boundingRect(QRect(0, 0, 0, 0),
-                Qt::AlignLeft, QString("%1").arg(mdays)));
-        painter.drawText(x1-bbox.width(), ybottom+10, bbox.width(), 10, Qt::AlignCenter, QString("%1").arg(mdays));
-    }*/
     // end
     painter.drawLine(xright, ybottom, xright, ybottom+5);
+
+    /* Draw data, one column of the window at a time */
+    int columns = xright - xleft + 1;
+    QVector<bool> has(columns);
+    QVector<int> low(columns), high(columns), first(columns), last(columns);
+    lastPoints.fill(QPoint(), plots.count());
+    for (int j = 0; j < plots.count(); j ++) {
+        painter.setPen(QPen(plots.at(j)->getColour()));
+        has.fill(false);
+        for (int i = 0; i < data.at(j).count(); i++) {
+            if (!dataExists[i]) continue;
+            int x = qBound(0, xPosition(i) - xleft, columns - 1);
+            int y = yPosition(data.at(j).at(i));
+            if (!has[x]) {
+                has[x] = true;
+                low[x] = high[x] = first[x] = y;
+            }
+            if (y < low[x]) low[x] = y;
+            if (y > high[x]) high[x] = y;
+            last[x] = y;
+            lastPoints[j] = QPoint(xleft + x, y);
+        }
+
+        int previous = -1;
+        for (int x = 0; x < columns; x++) {
+            if (!has[x]) continue;
+            int x1 = xleft + x;
+            /* lines style */
+            if (*style == 0 || *style == 2) {
+                if (previous == -1)
+                    painter.drawPoint(x1, first[x]);
+                else
+                    painter.drawLine(x1, first[x], xleft + previous,
+                            last[previous]);
+                if (low[x] != high[x])
+                    painter.drawLine(x1, low[x], x1, high[x]);
+            }
+            /* points style */
+            if (*style == 1 || *style == 2) {
+                drawStylePoint(j%6, 2, x1, low[x], &painter);
+                if (low[x] != high[x])
+                    drawStylePoint(j%6, 2, x1, high[x], &painter);
+            }
+            /* dots style */
+            if (*style == 3) {
+                if (low[x] == high[x])
+                    painter.drawPoint(x1, low[x]);
+                else
+                    painter.drawLine(x1, low[x], x1, high[x]);
+            }
+            previous = x;
+        }
+    }
+
+    cacheIteration = -1;
+    for (int i = dataExists.count() - 1; i >= 0; i--) {
+        if (dataExists[i]) {
+            cacheIteration = i;
+            break;
+        }
+    }
+
+    drawSides(&painter);
+}
+
+/*! \brief Draw the segment of a new iteration into the cache, from the
+ *  last iteration drawn.
+ *  \param it The new iteration, later than any drawn
+ */
+void GraphWidget::drawSegment(int it) {
+    QPainter painter(&cache);
+    for (int j = 0; j < plots.count(); j ++) {
+        painter.setPen(QPen(plots.at(j)->getColour()));
+        QPoint point(xPosition(it), yPosition(data.at(j).at(it)));
+        bool found = !lastPoints.at(j).isNull();
+        /* lines style */
+        if (*style == 0 || *style == 2) {
+            if (found)
+                painter.drawLine(point, lastPoints.at(j));
+            else
+                painter.drawPoint(point);
+        }
+        /* points style */
+        if (*style == 1 || *style == 2) {
+            drawStylePoint(j%6, 2, point.x(), point.y(), &painter);
+        }
+        /* dots style */
+        if (*style == 3) {
+            painter.drawPoint(point);
+        }
+        lastPoints[j] = point;
+    }
+    cacheIteration = it;
+
+    drawSides(&painter);
+}
+
+/*! \brief Draw graph sides over any data */
+void GraphWidget::drawSides(QPainter * painter) {
+    painter->setPen(QPen(Qt::black));
+    painter->drawLine(xleft, ytop, xleft, ybottom);
+    painter->drawLine(xleft, ybottom, xright, ybottom);
+}
+
+/*! \brief Draw the cached graph and the labels that change every
+ *  iteration.
+ */
+void GraphWidget::paintEvent(QPaintEvent */*event*/) {
+    if (!cacheCurrent()) drawCache();
+
+    QPainter painter(this);
+    painter.drawImage(0, 0, cache);
+
+    painter.setPen(QPen(Qt::black));
     if (plotsContainTimeScale()) {
         // Time
         const QRect bbox(painter.boundingRect(QRect(0, 0, 0, 0),
@@ -184,63 +335,18 @@ void GraphWidget::paintEvent(QPaintEvent */*event*/) {
     } else {
         // Iterations
         const QRect bbox(painter.boundingRect(QRect(0, 0, 0, 0),
-                Qt::AlignLeft, QString("%1 iterations").arg(topIteration)));
+                Qt::AlignLeft, QString("%1 iterations").arg(axisIterations)));
         painter.drawText(xright-5, ybottom+10, bbox.width(), bbox.height(),
-            Qt::AlignCenter, QString("%1 iterations").arg(topIteration));
+            Qt::AlignCenter, QString("%1 iterations").arg(axisIterations));
     }
 
-    int last_valid_x;
-    int last_valid_y;
-    bool found_valid_point;
-    /* Draw data */
+    /* Latest value of each plot */
     for (int j = 0; j < plots.count(); j ++) {
+        if (data.at(j).isEmpty()) continue;
         painter.setPen(QPen(plots.at(j)->getColour()));
-        last_valid_x = 0;
-        last_valid_y = 0;
-        found_valid_point = false;
-        for (int i = 0; i < data.at(j).count(); i++) {
-            /* First point is current data point */
-            int x1 = xleft+( (i/static_cast<double>(topIteration))*
-                    (xright-xleft));
-            int y1 = ybottom-( ((data.at(j).at(i)/
-                    static_cast<double>(topValue)))*(ybottom-ytop) );
-
-            if (!found_valid_point && dataExists[i]) {
-                last_valid_x = x1;
-                last_valid_y = y1;
-                found_valid_point = true;
-            }
-
-            /* Second point is last data point */
-            if (dataExists[i]) {
-                /* lines style */
-                if (*style == 0 || *style == 2) {
-                    if (i == 0)
-                        painter.drawPoint(x1, y1);
-                    else
-                        painter.drawLine(x1, y1, last_valid_x, last_valid_y);
-                    last_valid_x = x1;
-                    last_valid_y = y1;
-                }
-                /* points style */
-                if (*style == 1 || *style == 2) {
-                    drawStylePoint(j%6, 2, x1, y1, &painter);
-                }
-                /* dots style */
-                if (*style == 3) {
-                    painter.drawPoint(x1, y1);
-                }
-            }
-        }
-        painter.drawText(xright+5, ybottom-(((data[j].back()/
-                static_cast<double>(topValue)))*(ybottom-ytop))+5,
+        painter.drawText(xright+5, yPosition(data[j].back())+5,
                 QString("%1").arg(data[j].back()));
     }
-
-    /* Draw graph sides */
-    painter.setPen(QPen(Qt::black));
-    painter.drawLine(xleft, ytop, xleft, ybottom);
-    painter.drawLine(xleft, ybottom, xright, ybottom);
 }
 
 bool GraphWidget::plotsContainTimeScale() {
@@ -251,58 +357,39 @@ bool GraphWidget::plotsContainTimeScale() {
     return ts;
 }
 
-void GraphWidget::updateData(int it) {
+/*! \brief Store the plot counts of an iteration and redraw.
+ *  \param it The iteration
+ *  \param counts The counts of every plot from the graph aggregator
+ */
+void GraphWidget::updateData(int it, const PlotCounts & counts) {
     int count;
+    bool changed = false;
 
     if (it > topIteration) topIteration = it;
 
     for (int j = 0; j < plots.count(); j++) {
-        count = 0;
-
-        for (int i = 0; i < agents->count(); i++) {
-            if (QString::compare(agents->at(i)->agentType,
-                    plots.at(j)->getYaxis()) == 0) {
-                /* If a condition is enabled then check it */
-                if (plots.at(j)->condition().enable) {
-                    for (int k = 0; k < agents->at(i)->tags.count(); k++) {
-                        if (QString::compare(plots.at(j)->condition().variable,
-                                agents->at(i)->tags.at(k)) == 0) {
-                            if (plots.at(j)->condition().op == "==" &&
-                                    agents->at(i)->values.at(k).toDouble() ==
-                                    plots.at(j)->condition().value) count++;
-                            else if (plots.at(j)->condition().op == "!=" &&
-                                    agents->at(i)->values.at(k).toDouble() !=
-                                    plots.at(j)->condition().value) count++;
-                            else if (plots.at(j)->condition().op == ">" &&
-                                    agents->at(i)->values.at(k).toDouble() >
-                            plots.at(j)->condition().value) count++;
-                            else if (plots.at(j)->condition().op == "<" &&
-                                    agents->at(i)->values.at(k).toDouble() <
-                                    plots.at(j)->condition().value) count++;
-                            else if (plots.at(j)->condition().op == ">=" &&
-                                    agents->at(i)->values.at(k).toDouble() >=
-                                    plots.at(j)->condition().value) count++;
-                            else if (plots.at(j)->condition().op == "<=" &&
-                                    agents->at(i)->values.at(k).toDouble() <=
-                                    plots.at(j)->condition().value) count++;
-                        }
-                    }
-                } else {
-                    count++;
-                }
-            }
-        }
+        count = counts.value(plots.at(j), 0);
 
         while (data.at(j).count() < it+1) data[j].append(0);
+        if (data[j][it] != count) changed = true;
         data[j][it] = count;
 
         if (count > topValue) topValue = count;
     }
 
     while (dataExists.count() < it+1) dataExists.append(false);
+    if (!dataExists[it]) changed = true;
     dataExists[it] = true;
 
-    repaint();
+    /* Only the new segment is drawn unless the graph has to be redrawn */
+    if (cacheCurrent()) {
+        if (it > cacheIteration)
+            drawSegment(it);
+        else if (changed)
+            cache = QImage();
+    }
+
+    update();
 }
 
 void GraphWidget::keyPressEvent(QKeyEvent* event) {
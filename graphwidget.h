@@ -9,20 +9,23 @@
 #define GRAPHWIDGET_H_
 
 #include <QWidget>
-#include "./agent.h"
+#include <QImage>
+#include <QVector>
+#include <QPoint>
 #include "./graphsettingsitem.h"
+#include "./graphaggregator.h"
 #include "./timescale.h"
 
 class GraphWidget: public QWidget {
   Q_OBJECT
 
   public:
-    GraphWidget(QList<Agent*> *a = 0, int * gs = 0,
-                TimeScale * ts = 0, QWidget *parent = 0);
+    GraphWidget(int * gs = 0, TimeScale * ts = 0, QWidget *parent = 0);
     void paintEvent(QPaintEvent *event);
-    void updateData(int it);
+    void updateData(int it, const PlotCounts & counts);
     void addPlot(GraphSettingsItem * gsi);
     int removePlot(GraphSettingsItem * gsi);
+    QList<GraphSettingsItem*> getPlots() const { return plots; }
     void setGraph(QString g) { graphName = g; }
     QString getGraph() { return graphName; }
 
@@ -42,7 +45,13 @@ class GraphWidget: public QWidget {
   private:
     void drawStylePoint(int type, int size, int x1, int y1, QPainter *painter);
     bool plotsContainTimeScale();
-    QList<Agent*> *agents;
+    QString legendKey();
+    bool cacheCurrent();
+    void drawCache();
+    void drawSegment(int it);
+    void drawSides(QPainter * painter);
+    int xPosition(int iteration) const;
+    int yPosition(int value) const;
     // GraphSettingsModel * gsmodel;
     QList<GraphSettingsItem*> plots;
     QList<QList<int> > data;
@@ -53,6 +62,16 @@ class GraphWidget: public QWidget {
     QString graphName;
     int * style;
     TimeScale * timeScale;
+    /*! \brief Legend, axes and data drawn so far */
+    QImage cache;
+    int cacheStyle;  /*!< \brief The style the cache was drawn with */
+    QString cacheKey;  /*!< \brief The legend the cache was drawn with */
+    int cacheIteration;  /*!< \brief The last iteration in the cache */
+    int axisValue;  /*!< \brief The value at the top of the y axis */
+    int axisIterations;  /*!< \brief The iteration at the end of the x axis */
+    int xleft, xright, ytop, ybottom;  /*!< \brief The graph area */
+    /*! \brief The last point drawn of each plot, null if none */
+    QVector<QPoint> lastPoints;
 };
 
 #endif  // GRAPHWIDGET_H_
@@ -19,6 +19,10 @@ ImagesDialog::ImagesDialog(QWidget *parent)
             this, SLOT(takeAnimationSlot(bool)));
     connect(ui->lineEdit, SIGNAL(textChanged(QString)),
             this, SIGNAL(updateImagesLocation(QString)));
+    connect(ui->comboBox_Format, SIGNAL(currentIndexChanged(QString)),
+            this, SLOT(formatChanged(QString)));
+    connect(ui->lineEdit_Stream, SIGNAL(textChanged(QString)),
+            this, SIGNAL(updateImagesStream(QString)));
 }
 
 ImagesDialog::~ImagesDialog() {
@@ -37,6 +41,16 @@ void ImagesDialog::on_pushButton_Close_clicked() {
 
 void ImagesDialog::sendImageAniUpdate() {
     emit(takeAnimationSignal(ui->checkBox->isChecked()));
+    emit(updateImagesStream(ui->lineEdit_Stream->text()));
+    emit(updateImagesFormat(ui->comboBox_Format->currentText()));
+}
+
+/*! \brief Send the new image format, the stream location is only used by
+ *  streams.
+ */
+void ImagesDialog::formatChanged(QString s) {
+    ui->lineEdit_Stream->setEnabled(s.endsWith(" stream"));
+    emit(updateImagesFormat(s));
 }
 
 void ImagesDialog::setLocation(QString l) {
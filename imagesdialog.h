@@ -29,6 +29,8 @@ class ImagesDialog : public QDialog {
     void take_snapshot();
     void takeAnimationSignal(bool);
     void updateImagesLocation(QString);
+    void updateImagesFormat(QString);
+    void updateImagesStream(QString);
 
   public slots:
     void imageStatus(QString);
@@ -45,6 +47,8 @@ class ImagesDialog : public QDialog {
 
     void on_pushButton_Find_clicked();
 
+    void formatChanged(QString s);
+
   private:
     Ui::ImagesDialog *ui;
     QString * configpath;
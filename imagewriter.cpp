@@ -0,0 +1,172 @@
+/*!
+ * \file imagewriter.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of image writer
+ */
+#include <QRunnable>
+#include <QImageWriter>
+#include <QFileInfo>
+#include <QThread>
+#include <QMetaObject>
+#include "./imagewriter.h"
+
+/*! \brief Encodes one image and tells the writer when done */
+class ImageWriteJob : public QRunnable {
+  public:
+    ImageWriteJob(ImageWriter * w, const QImage & i, const QString & f)
+        : writer(w), image(i), fileName(f) {}
+
+    void run() {
+        QString error;
+        QString status = ImageWriter::save(image, fileName, &error) ?
+                QString("Saved: %1").arg(fileName) :
+                QString("Error: %1 %2").arg(error, fileName);
+        /* Image is shared, release it before the writer is told */
+        image = QImage();
+        QMetaObject::invokeMethod(writer, "imageWritten",
+                Qt::QueuedConnection, Q_ARG(QString, status));
+    }
+
+  private:
+    ImageWriter * writer;
+    QImage image;
+    QString fileName;
+};
+
+/*! \brief Writes one image as the next frame of a stream */
+class StreamWriteJob : public QRunnable {
+  public:
+    StreamWriteJob(ImageWriter * w, FrameStream * s, const QImage & i,
+            const QString & n)
+        : writer(w), stream(s), image(i), name(n) {}
+
+    void run() {
+        QString error;
+        QString status = stream->writeFrame(image, &error) ?
+                QString("Streamed: %1 to %2").arg(name, stream->getTarget()) :
+                QString("Error: %1 %2").arg(error, stream->getTarget());
+        image = QImage();
+        QMetaObject::invokeMethod(writer, "imageWritten",
+                Qt::QueuedConnection, Q_ARG(QString, status));
+    }
+
+  private:
+    ImageWriter * writer;
+    FrameStream * stream;
+    QImage image;
+    QString name;  /*!< \brief The frame name for the status */
+};
+
+/*! \brief Closes a stream after the frames queued before it are written */
+class StreamCloseJob : public QRunnable {
+  public:
+    explicit StreamCloseJob(FrameStream * s) : stream(s) {}
+
+    void run() { delete stream; }
+
+  private:
+    FrameStream * stream;
+};
+
+ImageWriter::ImageWriter(QObject * parent)
+    : QObject(parent) {
+    depth = 0;
+    stream = 0;
+    streamPool.setMaxThreadCount(1);
+    setThreadCount(0);
+}
+
+ImageWriter::~ImageWriter() {
+    closeStream();
+    pool.waitForDone();
+    streamPool.waitForDone();
+}
+
+/*! \brief Set the number of encoder threads, and the queue limit to twice
+ *  that so each thread has the next image waiting.
+ *  \param t The number of threads, 0 for one per core
+ */
+void ImageWriter::setThreadCount(int t) {
+    if (t < 1) t = qMax(1, QThread::idealThreadCount());
+    pool.setMaxThreadCount(t);
+    limit = 2 * t;
+}
+
+/*! \brief Queue an image to be written.
+ *
+ * The image is always queued, callers that produce images continuously
+ * check isFull() first.
+ *  \param image The image
+ *  \param fileName The file, whose suffix is the format, or the name of
+ *  the frame if streaming
+ */
+void ImageWriter::write(const QImage & image, const QString & fileName) {
+    depth++;
+    emit(queueDepthChanged(depth));
+    if (stream)
+        streamPool.start(new StreamWriteJob(this, stream, image, fileName));
+    else
+        pool.start(new ImageWriteJob(this, image, fileName));
+}
+
+/*! \brief Wait for every queued image to be written.
+ */
+void ImageWriter::waitForDone() {
+    pool.waitForDone();
+    streamPool.waitForDone();
+}
+
+/*! \brief Write the following images as the frames of a stream instead of
+ *  files.  A stream already set is closed unless it is the same.
+ *  \param target The file or named pipe, - for standard output
+ *  \param format The stream format
+ */
+void ImageWriter::setStream(const QString & target,
+        FrameStream::Format format) {
+    if (stream && stream->getTarget() == target &&
+            stream->getFormat() == format) return;
+    closeStream();
+    stream = new FrameStream(target, format);
+}
+
+/*! \brief Close the stream once the frames queued are written, so its
+ *  reader sees the end of the video.  The following images are written as
+ *  files.  The caller does not wait for the frames to be written.
+ */
+void ImageWriter::closeStream() {
+    if (!stream) return;
+    streamPool.start(new StreamCloseJob(stream));
+    stream = 0;
+}
+
+void ImageWriter::imageWritten(QString status) {
+    depth--;
+    emit(queueDepthChanged(depth));
+    emit(imageStatus(status));
+}
+
+/*! \brief Encode and write an image.
+ *
+ * jpg is written at quality 90 as before.  png is written at compression
+ * level 1, much faster than the default for a little larger file, and ppm
+ * is written raw.
+ *  \param image The image
+ *  \param fileName The file, whose suffix is the format
+ *  \param error The reason if the image could not be written
+ *  \return True if the image was written
+ */
+bool ImageWriter::save(const QImage & image, const QString & fileName,
+        QString * error) {
+    QString format = QFileInfo(fileName).suffix().toLower();
+    QImageWriter writer(fileName, format.toAscii());
+    if (format == "jpg" || format == "jpeg") writer.setQuality(90);
+    /* Qt maps png quality to zlib level (100 - quality) * 9 / 91 */
+    if (format == "png") writer.setQuality(85);
+    if (!writer.write(image)) {
+        if (error) *error = writer.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+/*!
+ * \file imagewriter.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for image writer
+ */
+#ifndef IMAGEWRITER_H_
+#define IMAGEWRITER_H_
+
+#include <QObject>
+#include <QImage>
+#include <QString>
+#include <QThreadPool>
+#include "./framestream.h"
+
+/*! \brief Encodes and writes snapshot images on worker threads.
+ *
+ * Images are queued and encoded by a pool of threads so the visual window
+ * can carry on drawing.  The queue is bounded: while it is full the
+ * animation waits before moving to the next iteration.  The format is
+ * taken from the file suffix, jpg, png with a low compression level, or
+ * raw ppm.
+ *
+ * With a stream set the images are instead written in order as the frames
+ * of one FrameStream by a single thread, for a video encoder to read.
+ */
+class ImageWriter : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit ImageWriter(QObject * parent = 0);
+    ~ImageWriter();
+
+    void setThreadCount(int t);
+    void setQueueLimit(int l) { limit = l; }
+    int queueLimit() const { return limit; }
+    int queueDepth() const { return depth; }
+    bool isFull() const { return depth >= limit; }
+    void write(const QImage & image, const QString & fileName);
+    void waitForDone();
+    void setStream(const QString & target, FrameStream::Format format);
+    void closeStream();
+    bool isStreaming() const { return stream != 0; }
+
+    static bool save(const QImage & image, const QString & fileName,
+            QString * error);
+
+  signals:
+    void imageStatus(QString);
+    void queueDepthChanged(int);
+
+  private slots:
+    void imageWritten(QString status);
+
+  private:
+    QThreadPool pool;
+    /*! \brief One thread so stream frames are written in order */
+    QThreadPool streamPool;
+    FrameStream * stream;  /*!< \brief The stream written to, if any */
+    int depth;  /*!< \brief Images queued or being encoded */
+    int limit;  /*!< \brief The most images queued before waiting */
+};
+
+#endif  // IMAGEWRITER_H_
@@ -0,0 +1,222 @@
+/*!
+ * \file iterationcache.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of iteration cache
+ */
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QDataStream>
+#include <QTemporaryFile>
+#include <string.h>
+#include "./iterationcache.h"
+
+/*! \brief The name of the cache directory in the results directory */
+const char * IterationCache::directoryName = ".flame_visualiser_cache";
+
+static const char magic[8] = { 'F', 'V', 'C', 'A', 'C', 'H', 'E', '2' };
+static const quint32 byteOrderMark = 0x01020304;
+
+/*! \brief The fixed size start of a cache file */
+struct CacheHeader {
+    char magic[8];
+    quint32 byteOrder;
+    quint32 reserved;
+    qint64 sourceSize;  /*!< \brief Size of the iteration file */
+    qint64 sourceModified;  /*!< \brief Modified time in ms since epoch */
+    qint64 tableSize;  /*!< \brief Size of the type and variable table */
+};
+
+/*! \brief Align a size to a whole number of doubles */
+static qint64 align(qint64 size) {
+    return (size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+}
+
+/*! \brief The cache file of an iteration file.
+ *  \param fileName The iteration file, for example results/12.xml
+ *  \return The cache file, for example results/.flame_visualiser_cache/12.bin
+ */
+QString IterationCache::cacheFileName(const QString & fileName) {
+    QFileInfo info(fileName);
+    QString name = info.path();
+    name.append("/");
+    name.append(directoryName);
+    name.append("/");
+    name.append(info.completeBaseName());
+    name.append(".bin");
+    return name;
+}
+
+/*! \brief Read the agents of an iteration from its cache file.
+ *  \param fileName The iteration file
+ *  \param agents The agent store to fill
+ *  \param agentTypeCounts The agent type counts to fill
+ *  \param projection The variables to read, 0 for every variable
+ *  \return False if there is no cache file, it is out of date, or it was
+ *  written without an agent type or variable that is wanted
+ */
+bool IterationCache::read(const QString & fileName, AgentStore * agents,
+        QHash<QString, int> * agentTypeCounts,
+        const AgentProjection * projection) {
+    QFileInfo source(fileName);
+    if (!source.exists()) return false;
+
+    QFile file(cacheFileName(fileName));
+    if (!file.open(QFile::ReadOnly)) return false;
+    qint64 size = file.size();
+    if (size < static_cast<qint64>(sizeof(CacheHeader))) return false;
+    const uchar * data = file.map(0, size);
+    if (data == 0) return false;
+
+    CacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    bool ok = memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+            header.byteOrder == byteOrderMark &&
+            header.sourceSize == source.size() &&
+            header.sourceModified ==
+                source.lastModified().toMSecsSinceEpoch() &&
+            header.tableSize >= 0 &&
+            static_cast<qint64>(sizeof(header)) + header.tableSize <= size;
+
+    if (ok) {
+        QByteArray table = QByteArray::fromRawData(
+                reinterpret_cast<const char *>(data + sizeof(header)),
+                static_cast<int>(header.tableSize));
+        QDataStream stream(table);
+        qint32 typeCount;
+        stream >> typeCount;
+
+        qint64 offset = align(sizeof(header) + header.tableSize);
+        for (int t = 0; ok && t < typeCount; t++) {
+            QString name;
+            bool isEnvironment;
+            bool typeRead;
+            qint32 count;
+            QStringList variables;
+            QVector<QHash<int, QString> > texts;
+            QStringList skipped;
+            stream >> name >> isEnvironment >> typeRead >> count >>
+                    variables >> texts >> skipped;
+            qint64 bytes = static_cast<qint64>(count) * variables.count() *
+                    sizeof(double);
+            if (stream.status() != QDataStream::Ok || count < 0 ||
+                    texts.count() != variables.count() ||
+                    offset + bytes > size) {
+                ok = false;
+                break;
+            }
+
+            /* Agents of a type no enabled rule or plot uses are counted */
+            bool wanted = !projection || isEnvironment ||
+                    projection->wantsType(name);
+            /* Written by a read that skipped what is now wanted */
+            if (wanted && !typeRead) {
+                ok = false;
+                break;
+            }
+            for (int i = 0; ok && i < skipped.count(); i++)
+                if (wanted && (!projection ||
+                        projection->wantsVariable(name, skipped.at(i))))
+                    ok = false;
+            if (!ok) break;
+
+            AgentColumns & columns = agents->type(agents->addType(name));
+            columns.isEnvironment = isEnvironment;
+            for (int i = 0; i < skipped.count(); i++)
+                columns.addSkipped(skipped.at(i));
+            columns.count = wanted ? count : 0;
+            for (int i = 0; i < variables.count(); i++) {
+                if (!wanted || (projection &&
+                        !projection->wantsVariable(name, variables.at(i)))) {
+                    /* Not used by any rule or plot */
+                    columns.addSkipped(variables.at(i));
+                } else {
+                    int variable = columns.addVariable(variables.at(i));
+                    columns.columns[variable].resize(count);
+                    memcpy(columns.columns[variable].data(), data + offset,
+                            count * sizeof(double));
+                    columns.texts[variable] = texts.at(i);
+                }
+                offset += count * sizeof(double);
+            }
+        }
+        if (ok) {
+            stream >> *agentTypeCounts;
+            if (stream.status() != QDataStream::Ok) ok = false;
+        }
+    }
+
+    file.unmap(const_cast<uchar *>(data));
+    if (!ok) {
+        agents->clear();
+        agentTypeCounts->clear();
+    }
+    return ok;
+}
+
+/*! \brief Write the agents of an iteration to its cache file.
+ *
+ * The agents may have been read with only some agent types and variables,
+ * the types and variables skipped are recorded so the cache file is only
+ * used by reads that want no more.  The file is written under a temporary
+ * name and then renamed so a reader never sees half a cache file.
+ *  \param fileName The iteration file
+ *  \param agents The agents read from the iteration file
+ *  \param agentTypeCounts The agent type counts read from the iteration file
+ *  \return False if the cache file could not be written
+ */
+bool IterationCache::write(const QString & fileName,
+        const AgentStore & agents,
+        const QHash<QString, int> & agentTypeCounts) {
+    QFileInfo source(fileName);
+    QString cacheName = cacheFileName(fileName);
+    if (!QDir(source.path()).mkpath(directoryName)) return false;
+
+    QByteArray table;
+    QDataStream stream(&table, QIODevice::WriteOnly);
+    stream << static_cast<qint32>(agents.typeCount());
+    for (int t = 0; t < agents.typeCount(); t++) {
+        const AgentColumns & columns = agents.type(t);
+        /* A type skipped whole has no agents and every variable skipped */
+        bool typeRead = columns.count > 0 || columns.skipped.isEmpty();
+        stream << columns.name << columns.isEnvironment << typeRead <<
+                static_cast<qint32>(columns.count) << columns.variables <<
+                columns.texts << columns.skipped;
+    }
+    stream << agentTypeCounts;
+
+    CacheHeader header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.byteOrder = byteOrderMark;
+    header.reserved = 0;
+    header.sourceSize = source.size();
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+    header.tableSize = table.size();
+
+    QTemporaryFile file(cacheName);
+    if (!file.open()) return false;
+    bool ok = file.write(reinterpret_cast<const char *>(&header),
+            sizeof(header)) == sizeof(header);
+    ok = ok && file.write(table) == table.size();
+    QByteArray padding(static_cast<int>(
+            align(sizeof(header) + table.size()) -
+            (sizeof(header) + table.size())), '\0');
+    ok = ok && file.write(padding) == padding.size();
+    for (int t = 0; ok && t < agents.typeCount(); t++) {
+        const AgentColumns & columns = agents.type(t);
+        qint64 bytes = static_cast<qint64>(columns.count) * sizeof(double);
+        for (int i = 0; ok && i < columns.variables.count(); i++)
+            ok = file.write(reinterpret_cast<const char *>(columns.column(i)),
+                    bytes) == bytes;
+    }
+    file.close();
+    if (!ok) return false;
+
+    QFile::remove(cacheName);
+    if (!file.rename(cacheName)) return false;
+    file.setAutoRemove(false);
+    return true;
+}
@@ -0,0 +1,39 @@
+/*!
+ * \file iterationcache.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for iteration cache
+ */
+#ifndef ITERATIONCACHE_H_
+#define ITERATIONCACHE_H_
+
+#include <QString>
+#include <QHash>
+#include "./agentstore.h"
+#include "./agentprojection.h"
+
+/*! \brief Binary sidecar files holding the parsed agents of iteration files.
+ *
+ * After an iteration file is read its agents are written to a cache
+ * directory next to it, one file per iteration.  A cache file starts with
+ * the size and modified time of its iteration file followed by a table of
+ * agent types and variable names, including those skipped by the read,
+ * the agent type counts, and then one column of doubles per variable read.
+ * Reading maps the cache file and copies the columns out, so no XML is
+ * parsed.  A cache file whose iteration file has changed, or that skipped
+ * a wanted agent type or variable, is ignored and rewritten on the next
+ * read.
+ */
+class IterationCache {
+  public:
+    static QString cacheFileName(const QString & fileName);
+    static bool read(const QString & fileName, AgentStore * agents,
+            QHash<QString, int> * agentTypeCounts,
+            const AgentProjection * projection = 0);
+    static bool write(const QString & fileName, const AgentStore & agents,
+            const QHash<QString, int> & agentTypeCounts);
+    static const char * directoryName;
+};
+
+#endif  // ITERATIONCACHE_H_
@@ -0,0 +1,44 @@
+/*!
+ * \file iterationdata.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for iteration data
+ */
+#ifndef ITERATIONDATA_H_
+#define ITERATIONDATA_H_
+
+#include <QString>
+#include <QHash>
+#include "./agentstore.h"
+
+/*! \brief The result of reading one iteration file.
+ *
+ * Filled in by an IterationLoader, possibly on a worker thread, and then
+ * handed to the main window which takes the agents and counts.
+ */
+class IterationData {
+  public:
+    IterationData() {
+        iteration = -1;
+        rc = 0;
+        cancelled = false;
+        lineNumber = 0;
+        columnNumber = 0;
+    }
+
+    int iteration;  /*!< \brief The iteration number */
+    QString fileName;  /*!< \brief The iteration file read */
+    AgentStore agents;  /*!< \brief The agents read */
+    /*! \brief The count of each agent type */
+    QHash<QString, int> agentTypeCounts;
+    /*! \brief 0 success, 1 error opening file, 2 error reading file */
+    int rc;
+    /*! \brief True if rc is 2 as the read was stopped, not an error */
+    bool cancelled;
+    QString errorString;  /*!< \brief The parse error if rc is 2 */
+    qint64 lineNumber;  /*!< \brief The line of the parse error */
+    qint64 columnNumber;  /*!< \brief The column of the parse error */
+};
+
+#endif  // ITERATIONDATA_H_
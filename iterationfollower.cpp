@@ -0,0 +1,140 @@
+/*!
+ * \file iterationfollower.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of iteration follower
+ */
+#include <QFile>
+#include <QFileInfo>
+#include <QByteArray>
+#include <QtConcurrentRun>
+#include "./iterationfollower.h"
+#include "./iterationloader.h"
+
+IterationFollower::IterationFollower(IterationIndex * i, QObject * parent)
+    : QObject(parent), index(i) {
+    enabled = false;
+    lastIteration = -1;
+    loading = false;
+    watchedSize = -1;
+    failedSize = -1;
+    loadingSize = -1;
+    pollTimer.setInterval(pollInterval);
+    connect(&pollTimer, SIGNAL(timeout()), this, SLOT(check()));
+    connect(index, SIGNAL(changed()), this, SLOT(check()));
+    connect(&loadWatcher, SIGNAL(finished()), this, SLOT(loadFinished()));
+}
+
+IterationFollower::~IterationFollower() {
+    /* Free an iteration read but not yet handed over */
+    if (loading) {
+        loadWatcher.waitForFinished();
+        delete loadWatcher.result();
+    }
+}
+
+/*! \brief Start or stop following.
+ *  \param b True to follow
+ */
+void IterationFollower::setEnabled(bool b) {
+    enabled = b;
+    watchedFile.clear();
+    failedFile.clear();
+    if (enabled) {
+        pollTimer.start();
+        check();
+    } else {
+        pollTimer.stop();
+    }
+}
+
+/*! \brief Read the newest iteration if it is newer than the last and
+ *  complete.
+ */
+void IterationFollower::check() {
+    if (!enabled || loading) return;
+    if (index->isEmpty()) {
+        /* The run may not have made the results directory when it was
+         * set, any files found are checked through changed */
+        index->refresh();
+        return;
+    }
+    int newest = index->last();
+    if (newest <= lastIteration) return;
+
+    QString fileName = QString("%1/%2.xml").
+            arg(index->getDirectory()).arg(newest);
+    if (hasFailed(fileName) || !isComplete(fileName)) return;
+
+    watchedFile.clear();
+    QFileInfo info(fileName);
+    loadingSize = info.size();
+    loadingModified = info.lastModified();
+    loading = true;
+    loadWatcher.setFuture(QtConcurrent::run(IterationLoader::load,
+            fileName, newest, projection,
+            static_cast<const QAtomicInt *>(0)));
+}
+
+void IterationFollower::loadFinished() {
+    loading = false;
+    IterationData * data = loadWatcher.result();
+    if (!enabled || data->iteration <= lastIteration) {
+        delete data;
+        return;
+    }
+    if (data->rc != 0) {
+        /* Read again only once the file changes */
+        failedFile = data->fileName;
+        failedSize = loadingSize;
+        failedModified = loadingModified;
+        if (data->rc == 2)
+            emit(iterationFailed(data->iteration, tr(
+                    "Cannot parse iteration file %1 at line %2, column "
+                    "%3:\n%4").arg(data->fileName).arg(data->lineNumber).
+                    arg(data->columnNumber).arg(data->errorString)));
+        delete data;
+        return;
+    }
+    lastIteration = data->iteration;
+    emit(iterationReady(data));
+    /* Files may have completed while this one was read */
+    check();
+}
+
+/*! \brief True if a file failed to read and has not changed since.
+ */
+bool IterationFollower::hasFailed(const QString & fileName) const {
+    if (fileName != failedFile) return false;
+    QFileInfo info(fileName);
+    return info.size() == failedSize && info.lastModified() == failedModified;
+}
+
+/*! \brief True if a file has been completely written, it ends with the
+ *  closing states tag or its size has not changed for the stable time.
+ */
+bool IterationFollower::isComplete(const QString & fileName) {
+    if (hasClosingTag(fileName)) return true;
+
+    qint64 size = QFileInfo(fileName).size();
+    if (fileName != watchedFile || size != watchedSize) {
+        watchedFile = fileName;
+        watchedSize = size;
+        watchedSince.start();
+        return false;
+    }
+    return size > 0 && watchedSince.elapsed() >= stableTime;
+}
+
+/*! \brief True if an iteration file ends with the closing states tag.
+ *  \param fileName The iteration file
+ */
+bool IterationFollower::hasClosingTag(const QString & fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    qint64 tail = 64;
+    if (file.size() > tail) file.seek(file.size() - tail);
+    QByteArray end = file.read(tail).trimmed();
+    return end.endsWith("</states>");
+}
@@ -0,0 +1,82 @@
+/*!
+ * \file iterationfollower.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for iteration follower
+ */
+#ifndef ITERATIONFOLLOWER_H_
+#define ITERATIONFOLLOWER_H_
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QTime>
+#include <QDateTime>
+#include <QFutureWatcher>
+#include "./iterationindex.h"
+#include "./iterationdata.h"
+#include "./agentprojection.h"
+
+/*! \brief Follows a simulation that is still writing iteration files.
+ *
+ * While enabled the newest iteration file of the index is checked until
+ * it is complete, when it ends with the closing states tag or its size has
+ * not changed for a while.  It is then read on a worker thread and handed
+ * over with iterationReady.  A file that is still being written is never
+ * read, so nothing waits on or reports an error for a partial file.  A
+ * complete file that fails to read is reported once with iterationFailed
+ * and only read again when its size or modified time changes.
+ */
+class IterationFollower : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit IterationFollower(IterationIndex * i, QObject * parent = 0);
+    ~IterationFollower();
+
+    void setEnabled(bool b);
+    bool isEnabled() const { return enabled; }
+    void setLastIteration(int it) { lastIteration = it; }
+    void setProjection(const AgentProjection & p) { projection = p; }
+
+    static bool hasClosingTag(const QString & fileName);
+
+    /*! \brief The time in ms between checks of the newest file */
+    static const int pollInterval = 500;
+    /*! \brief The time in ms a file without a closing tag must keep the
+     *  same size to be taken as complete */
+    static const int stableTime = 2000;
+
+  signals:
+    /*! \brief An iteration newer than the last has been read, the
+     *  receiver owns the data */
+    void iterationReady(IterationData * data);
+    /*! \brief A complete iteration file could not be read */
+    void iterationFailed(int iteration, const QString & error);
+
+  private slots:
+    void check();
+    void loadFinished();
+
+  private:
+    bool isComplete(const QString & fileName);
+    bool hasFailed(const QString & fileName) const;
+    IterationIndex * index;
+    bool enabled;
+    int lastIteration;  /*!< \brief The newest iteration handed over */
+    QTimer pollTimer;
+    QFutureWatcher<IterationData *> loadWatcher;
+    bool loading;  /*!< \brief True until the read is handed over */
+    QString watchedFile;  /*!< \brief The file whose size is being watched */
+    qint64 watchedSize;
+    QTime watchedSince;  /*!< \brief When the size last changed */
+    AgentProjection projection;  /*!< \brief The variables to read */
+    QString failedFile;  /*!< \brief The last file that failed to read */
+    qint64 failedSize;  /*!< \brief Its size when read */
+    QDateTime failedModified;  /*!< \brief Its modified time when read */
+    qint64 loadingSize;  /*!< \brief The size of the file being read */
+    QDateTime loadingModified;  /*!< \brief Modified time of the file */
+};
+
+#endif  // ITERATIONFOLLOWER_H_
@@ -0,0 +1,153 @@
+/*!
+ * \file iterationindex.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of iteration index
+ */
+#include <QDir>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <QtConcurrentRun>
+#include "./iterationindex.h"
+
+IterationIndex::IterationIndex(QObject * parent)
+    : QObject(parent) {
+    fileWatcher = 0;
+    dirty = false;
+    generation = 0;
+    scanGeneration = 0;
+    rescanTimer.setSingleShot(true);
+    connect(&rescanTimer, SIGNAL(timeout()), this, SLOT(startScan()));
+    connect(&scanWatcher, SIGNAL(finished()), this, SLOT(scanFinished()));
+}
+
+IterationIndex::~IterationIndex() {
+    scanWatcher.waitForFinished();
+}
+
+/*! \brief List and watch a results directory.
+ *  \param d The directory
+ */
+void IterationIndex::setDirectory(const QString & d) {
+    QString path = QDir(d).absolutePath();
+    if (path == directory && fileWatcher) return;
+    clear();
+    directory = path;
+    its = scan(directory);
+
+    /* A new watcher as one that watched nothing may not be reusable */
+    fileWatcher = new QFileSystemWatcher(this);
+    connect(fileWatcher, SIGNAL(directoryChanged(QString)),
+            this, SLOT(directoryChanged()));
+    if (QDir(directory).exists()) fileWatcher->addPath(directory);
+    emit(changed());
+}
+
+/*! \brief Stop watching and forget the iterations.
+ */
+void IterationIndex::clear() {
+    rescanTimer.stop();
+    scanWatcher.waitForFinished();
+    generation++;
+    delete fileWatcher;
+    fileWatcher = 0;
+    directory.clear();
+    dirty = false;
+    if (its.isEmpty()) return;
+    its.clear();
+    emit(changed());
+}
+
+/*! \brief List the directory again on a worker thread without the wait,
+ *  for when the directory is not watched, or only becomes valid after it
+ *  was set.  Any change is given by changed.
+ */
+void IterationIndex::refresh() {
+    if (directory.isEmpty()) return;
+    if (fileWatcher && fileWatcher->directories().isEmpty() &&
+            QDir(directory).exists())
+        fileWatcher->addPath(directory);
+    if (scanWatcher.isRunning()) {
+        dirty = true;
+        return;
+    }
+    rescanTimer.stop();
+    startScan();
+}
+
+/*! \brief True if the iteration has a file.
+ */
+bool IterationIndex::contains(int iteration) const {
+    QVector<int>::const_iterator i = qBinaryFind(its, iteration);
+    return i != its.constEnd();
+}
+
+/*! \brief The first iteration after one.
+ *  \param iteration The iteration
+ *  \param found The next iteration
+ *  \return False if there is none
+ */
+bool IterationIndex::next(int iteration, int * found) const {
+    QVector<int>::const_iterator i =
+            qUpperBound(its.constBegin(), its.constEnd(), iteration);
+    if (i == its.constEnd()) return false;
+    *found = *i;
+    return true;
+}
+
+/*! \brief The last iteration before one.
+ *  \param iteration The iteration
+ *  \param found The previous iteration
+ *  \return False if there is none
+ */
+bool IterationIndex::previous(int iteration, int * found) const {
+    QVector<int>::const_iterator i =
+            qLowerBound(its.constBegin(), its.constEnd(), iteration);
+    if (i == its.constBegin()) return false;
+    *found = *(i - 1);
+    return true;
+}
+
+/*! \brief The sorted iterations of the iteration files of a directory,
+ *  files named by a number and .xml.
+ *  \param directory The directory
+ */
+QVector<int> IterationIndex::scan(const QString & directory) {
+    QVector<int> found;
+    QStringList files = QDir(directory).entryList(QStringList("*.xml"),
+            QDir::Files, QDir::Unsorted);
+    found.reserve(files.count());
+    for (int i = 0; i < files.count(); i++) {
+        QString base = files.at(i).left(files.at(i).length() - 4);
+        bool ok;
+        int it = base.toInt(&ok);
+        if (ok && it >= 0 && base == QString::number(it)) found.append(it);
+    }
+    qSort(found);
+    return found;
+}
+
+void IterationIndex::directoryChanged() {
+    if (scanWatcher.isRunning())
+        dirty = true;
+    else if (!rescanTimer.isActive())
+        rescanTimer.start(rescanDelay);
+}
+
+void IterationIndex::startScan() {
+    if (directory.isEmpty()) return;
+    dirty = false;
+    scanGeneration = ++generation;
+    scanWatcher.setFuture(QtConcurrent::run(IterationIndex::scan, directory));
+}
+
+void IterationIndex::scanFinished() {
+    /* A listing started before the index was cleared or refreshed */
+    if (scanGeneration != generation) return;
+    QVector<int> found = scanWatcher.result();
+    if (dirty) rescanTimer.start(rescanDelay);
+    if (found == its) return;
+    its = found;
+    emit(changed());
+}
@@ -0,0 +1,70 @@
+/*!
+ * \file iterationindex.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for iteration index
+ */
+#ifndef ITERATIONINDEX_H_
+#define ITERATIONINDEX_H_
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QTimer>
+
+/*! \brief The sorted iteration numbers of the files in the results
+ *  directory.
+ *
+ * The directory is listed once when it is set and then watched.  When it
+ * changes it is listed again on a worker thread, after a short wait so a
+ * run writing many files is listed once rather than for every file.  The
+ * next or previous iteration is found by a binary search.
+ */
+class IterationIndex : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit IterationIndex(QObject * parent = 0);
+    ~IterationIndex();
+
+    void setDirectory(const QString & d);
+    QString getDirectory() const { return directory; }
+    void clear();
+    void refresh();
+    const QVector<int> & iterations() const { return its; }
+    bool isEmpty() const { return its.isEmpty(); }
+    int count() const { return its.count(); }
+    int first() const { return its.first(); }
+    int last() const { return its.last(); }
+    bool contains(int iteration) const;
+    bool next(int iteration, int * found) const;
+    bool previous(int iteration, int * found) const;
+
+    static QVector<int> scan(const QString & directory);
+
+    /*! \brief The wait in ms after a change before listing again */
+    static const int rescanDelay = 500;
+
+  signals:
+    void changed();
+
+  private slots:
+    void directoryChanged();
+    void startScan();
+    void scanFinished();
+
+  private:
+    QString directory;  /*!< \brief The results directory */
+    QVector<int> its;  /*!< \brief The iterations in ascending order */
+    QFileSystemWatcher * fileWatcher;
+    QFutureWatcher<QVector<int> > scanWatcher;
+    QTimer rescanTimer;
+    bool dirty;  /*!< \brief Changed while being listed */
+    int generation;  /*!< \brief Counts listings and clears */
+    int scanGeneration;  /*!< \brief The generation of the listing running */
+};
+
+#endif  // ITERATIONINDEX_H_
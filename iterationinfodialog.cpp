@@ -8,6 +8,7 @@
 #include <QDebug>
 #include "./iterationinfodialog.h"
 #include "./ui_iterationinfodialog.h"
+#include "./memoryusage.h"
 
 IterationInfoDialog::IterationInfoDialog(QHash<QString, int> * atc,
                                          Dimension * ad, QWidget *parent)
@@ -65,6 +66,10 @@ void IterationInfoDialog::update_info() {
     addRow("Y-axis Maxiumum", QString::number(agentDimension->ymax));
     addRow("Z-axis Miniumum", QString::number(agentDimension->zmin));
     addRow("Z-axis Maxiumum", QString::number(agentDimension->zmax));
+    /* Add peak memory of the process */
+    qint64 peak = peakMemoryUsage();
+    if (peak >= 0)
+        addRow("Peak memory (MB)", QString::number(peak / (1024 * 1024)));
 }
 
 void IterationInfoDialog::on_buttonBox_accepted() {
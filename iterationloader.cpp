@@ -0,0 +1,271 @@
+/*!
+ * \file iterationloader.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of iteration loader
+ */
+#include <QFile>
+#include <QtConcurrentRun>
+#include "./iterationloader.h"
+#include "./parallelzeroxmlreader.h"
+#include "./iterationcache.h"
+
+IterationLoader::IterationLoader() {
+    index = 0;
+    aborted = new QAtomicInt(0);
+    depth = 0;
+    memoryLimit = 0;
+    lastMemoryUsage = 0;
+}
+
+IterationLoader::~IterationLoader() {
+    clear();
+    for (int i = 0; i < discarded.count(); i++) {
+        discarded[i].waitForFinished();
+        delete discarded.at(i).result();
+    }
+    qDeleteAll(discardedFlags);
+    delete aborted;
+}
+
+/*! \brief Set the results directory, any read ahead data is dropped if the
+ *         directory changes.
+ *  \param d The results directory
+ */
+void IterationLoader::setDirectory(const QString & d) {
+    if (d == directory) return;
+    clear();
+    directory = d;
+}
+
+/*! \brief Set the variables to read.  Read ahead data is dropped if it
+ *  does not have every variable now needed.
+ *  \param p The variables to read
+ */
+void IterationLoader::setProjection(const AgentProjection & p) {
+    if (!projection.contains(p)) clear();
+    projection = p;
+}
+
+/*! \brief The file name of an iteration.
+ *  \param iteration The iteration number
+ */
+QString IterationLoader::fileName(int iteration) const {
+    QString name = directory;
+    name.append("/");
+    name.append(QString().number(iteration));
+    name.append(".xml");
+    return name;
+}
+
+/*! \brief Read an iteration file, from its cache file if up to date.
+ *
+ * A cache file is written after the iteration file is read without error,
+ * holding the variables read, and is used by later reads that want no
+ * more than that.
+ * Does not touch any shared state so can be run on a worker thread.
+ *  \param fileName The iteration file
+ *  \param iteration The iteration number
+ *  \param projection The variables to read
+ *  \param abort Stops reading with rc 2 when set, 0 to always read
+ *  \return The iteration data, owned by the caller
+ */
+IterationData * IterationLoader::load(QString fileName, int iteration,
+        AgentProjection projection, const QAtomicInt * abort) {
+    IterationData * data = new IterationData;
+    data->iteration = iteration;
+    data->fileName = fileName;
+
+    if (abort && *abort != 0) {
+        data->rc = 2;
+        data->cancelled = true;
+        data->errorString = QObject::tr("Reading was cancelled");
+        return data;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        data->rc = 1;
+        return data;
+    }
+
+    if (IterationCache::read(fileName, &data->agents, &data->agentTypeCounts,
+            &projection))
+        return data;
+
+    ParallelZeroXMLReader reader(&data->agents, &data->agentTypeCounts);
+    reader.setProjection(&projection);
+    reader.setAbort(abort);
+    if (!reader.read(&file)) {
+        data->rc = 2;
+        data->cancelled = abort && *abort != 0;
+        data->errorString = reader.errorString();
+        data->lineNumber = reader.lineNumber();
+        data->columnNumber = reader.columnNumber();
+    } else {
+        IterationCache::write(fileName, data->agents, data->agentTypeCounts);
+    }
+
+    return data;
+}
+
+/*! \brief Take the data of an iteration.
+ *
+ * If the iteration has been read ahead it is handed over, waiting if it is
+ * still being read, otherwise it is read now.
+ *  \param iteration The iteration number
+ *  \return The iteration data, owned by the caller
+ */
+IterationData * IterationLoader::take(int iteration) {
+    IterationData * data;
+    QMap<int, QFuture<IterationData *> >::iterator i =
+            futures.find(iteration);
+    if (i != futures.end()) {
+        data = i.value().result();
+        futures.erase(i);
+        /* Read ahead before the file was completely written */
+        if (data->rc != 0) {
+            delete data;
+            data = load(fileName(iteration), iteration, projection);
+        }
+    } else {
+        data = load(fileName(iteration), iteration, projection);
+    }
+
+    if (data->rc == 0) lastMemoryUsage = data->agents.memoryUsage();
+    return data;
+}
+
+/*! \brief Start reading an iteration on a worker thread.
+ *
+ * If the iteration is being read ahead that read is handed over instead,
+ * unless it has already failed.
+ *  \param iteration The iteration number
+ *  \param abort Stops the read when set, a read ahead handed over is only
+ *  stopped by clear, its data then has cancelled set
+ *  \return The future iteration data, owned by the caller
+ */
+QFuture<IterationData *> IterationLoader::start(int iteration,
+        const QAtomicInt * abort) {
+    QMap<int, QFuture<IterationData *> >::iterator i =
+            futures.find(iteration);
+    if (i != futures.end()) {
+        QFuture<IterationData *> future = i.value();
+        futures.erase(i);
+        if (!future.isFinished() || future.result()->rc == 0) return future;
+        /* Read ahead before the file was completely written */
+        delete future.result();
+    }
+    return QtConcurrent::run(IterationLoader::load, fileName(iteration),
+            iteration, projection, abort);
+}
+
+/*! \brief Start reading ahead the iterations after the current iteration.
+ *  \param iteration The current iteration number
+ *  \param direction 1 for forward, -1 for backward
+ */
+void IterationLoader::prefetch(int iteration, int direction) {
+    reap();
+    QList<int> ahead = upcoming(iteration, direction);
+    prune(ahead);
+    if (ahead.isEmpty()) return;
+
+    /* Memory of read ahead iterations, estimated if still being read */
+    qint64 limit = static_cast<qint64>(memoryLimit) * 1024 * 1024;
+    qint64 used = 0;
+    QMap<int, QFuture<IterationData *> >::const_iterator i;
+    for (i = futures.constBegin(); i != futures.constEnd(); ++i) {
+        if (i.value().isFinished())
+            used += i.value().result()->agents.memoryUsage();
+        else
+            used += lastMemoryUsage;
+    }
+
+    for (int k = 0; k < ahead.count(); k++) {
+        int it = ahead.at(k);
+        if (futures.contains(it)) continue;
+        if (used + lastMemoryUsage > limit) break;
+        futures.insert(it, QtConcurrent::run(IterationLoader::load,
+                fileName(it), it, projection,
+                static_cast<const QAtomicInt *>(aborted)));
+        used += lastMemoryUsage;
+    }
+}
+
+/*! \brief The iterations to read ahead, the next files of the index, or
+ *  the next iterations whose files exist if there is no index.
+ *  \param iteration The current iteration number
+ *  \param direction 1 for forward, -1 for backward
+ */
+QList<int> IterationLoader::upcoming(int iteration, int direction) const {
+    QList<int> ahead;
+    if (depth <= 0 || directory.isEmpty() || direction == 0) return ahead;
+    int it = iteration;
+    while (ahead.count() < depth) {
+        if (index) {
+            bool found = (direction > 0) ?
+                    index->next(it, &it) : index->previous(it, &it);
+            if (!found) break;
+        } else {
+            it += direction;
+            if (it < 0 || !QFile::exists(fileName(it))) break;
+        }
+        ahead.append(it);
+    }
+    return ahead;
+}
+
+/*! \brief Drop read ahead data no longer in front of the current iteration.
+ *  \param ahead The iterations in front of the current iteration
+ */
+void IterationLoader::prune(const QList<int> & ahead) {
+    QMap<int, QFuture<IterationData *> >::iterator i = futures.begin();
+    while (i != futures.end()) {
+        if (!ahead.contains(i.key()) && i.value().isFinished()) {
+            delete i.value().result();
+            i = futures.erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+/*! \brief Free the data of discarded reads that have finished.
+ */
+void IterationLoader::reap() {
+    for (int i = discarded.count() - 1; i >= 0; i--) {
+        if (!discarded.at(i).isFinished()) continue;
+        delete discarded.at(i).result();
+        discarded.removeAt(i);
+    }
+    if (!discarded.isEmpty()) return;
+    qDeleteAll(discardedFlags);
+    discardedFlags.clear();
+}
+
+/*! \brief Drop all read ahead data.  Reads still running are stopped and
+ *  their data freed later, so this does not wait.
+ */
+void IterationLoader::clear() {
+    bool running = false;
+    QMap<int, QFuture<IterationData *> >::iterator i;
+    for (i = futures.begin(); i != futures.end(); ++i) {
+        if (i.value().isFinished()) {
+            delete i.value().result();
+        } else {
+            discarded.append(i.value());
+            running = true;
+        }
+    }
+    futures.clear();
+    lastMemoryUsage = 0;
+
+    if (running) {
+        /* New reads ahead get a flag of their own */
+        *aborted = 1;
+        discardedFlags.append(aborted);
+        aborted = new QAtomicInt(0);
+    }
+    reap();
+}
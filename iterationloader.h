@@ -0,0 +1,70 @@
+/*!
+ * \file iterationloader.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for iteration loader
+ */
+#ifndef ITERATIONLOADER_H_
+#define ITERATIONLOADER_H_
+
+#include <QString>
+#include <QMap>
+#include <QList>
+#include <QFuture>
+#include <QAtomicInt>
+#include "./iterationdata.h"
+#include "./agentprojection.h"
+#include "./iterationindex.h"
+
+/*! \brief Reads iteration files, prefetching upcoming iterations on worker
+ *  threads.
+ *
+ * While an iteration is displayed the next iterations in the direction of
+ * travel are parsed in the background, the next files of the iteration
+ * index if set so output saved every few iterations is read ahead.  When
+ * one is asked for its parsed data is handed over without reading the
+ * file again.  Clearing stops the reads running and frees their data when
+ * they finish, without waiting for them.
+ */
+class IterationLoader {
+  public:
+    IterationLoader();
+    ~IterationLoader();
+
+    void setDirectory(const QString & d);
+    void setIndex(const IterationIndex * i) { index = i; }
+    QString getDirectory() const { return directory; }
+    void setDepth(int d) { depth = d; }
+    void setMemoryLimit(int mb) { memoryLimit = mb; }
+    void setProjection(const AgentProjection & p);
+    QString fileName(int iteration) const;
+    IterationData * take(int iteration);
+    QFuture<IterationData *> start(int iteration, const QAtomicInt * abort);
+    void prefetch(int iteration, int direction);
+    void clear();
+    int pendingCount() const { return futures.count(); }
+
+    static IterationData * load(QString fileName, int iteration,
+            AgentProjection projection, const QAtomicInt * abort = 0);
+
+  private:
+    QList<int> upcoming(int iteration, int direction) const;
+    void prune(const QList<int> & ahead);
+    void reap();
+    QString directory;  /*!< \brief The results directory */
+    /*! \brief The iterations of the directory, 0 to look for files */
+    const IterationIndex * index;
+    int depth;  /*!< \brief The number of iterations to read ahead */
+    int memoryLimit;  /*!< \brief The memory limit of read ahead in MB */
+    qint64 lastMemoryUsage;  /*!< \brief Memory of the last iteration read */
+    AgentProjection projection;  /*!< \brief The variables to read */
+    QMap<int, QFuture<IterationData *> > futures;
+    QAtomicInt * aborted;  /*!< \brief Set to stop the reads ahead */
+    /*! \brief Reads stopped by clear that have not yet finished */
+    QList<QFuture<IterationData *> > discarded;
+    /*! \brief The abort flags of the discarded reads */
+    QList<QAtomicInt *> discardedFlags;
+};
+
+#endif  // ITERATIONLOADER_H_
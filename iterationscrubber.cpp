@@ -0,0 +1,71 @@
+/*!
+ * \file iterationscrubber.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of iteration scrubber
+ */
+#include "./iterationscrubber.h"
+
+IterationScrubber::IterationScrubber(IterationLoader * l, QObject * parent)
+    : QObject(parent), loader(l) {
+    aborted = 0;
+    loading = false;
+    pending = -1;
+    connect(&loadWatcher, SIGNAL(finished()), this, SLOT(loadFinished()));
+}
+
+IterationScrubber::~IterationScrubber() {
+    /* Free an iteration read but not yet handed over */
+    if (loading) {
+        aborted = 1;
+        loadWatcher.waitForFinished();
+        delete loadWatcher.result();
+    }
+}
+
+/*! \brief Read an iteration, cancelling any older request.
+ *  \param iteration The iteration number
+ */
+void IterationScrubber::request(int iteration) {
+    if (loading) {
+        /* Read once the running read has stopped */
+        pending = iteration;
+        aborted = 1;
+    } else {
+        start(iteration);
+    }
+}
+
+/*! \brief Drop the running read and any request waiting.
+ */
+void IterationScrubber::cancel() {
+    pending = -1;
+    if (loading) aborted = 1;
+}
+
+void IterationScrubber::start(int iteration) {
+    aborted = 0;
+    pending = -1;
+    loading = true;
+    loadWatcher.setFuture(loader->start(iteration, &aborted));
+}
+
+void IterationScrubber::loadFinished() {
+    loading = false;
+    IterationData * data = loadWatcher.result();
+    if (aborted != 0) {
+        /* Superseded or cancelled, so never shown */
+        delete data;
+        if (pending >= 0) start(pending);
+        return;
+    }
+    if (data->cancelled) {
+        /* A read ahead handed over and then stopped by the loader */
+        int iteration = data->iteration;
+        delete data;
+        start(iteration);
+        return;
+    }
+    emit(iterationReady(data));
+}
@@ -0,0 +1,54 @@
+/*!
+ * \file iterationscrubber.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for iteration scrubber
+ */
+#ifndef ITERATIONSCRUBBER_H_
+#define ITERATIONSCRUBBER_H_
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include "./iterationloader.h"
+#include "./iterationdata.h"
+
+/*! \brief Reads the iterations chosen by scrubbing on a worker thread,
+ *  only ever the latest.
+ *
+ * When an iteration is requested while another is being read that read is
+ * cancelled and the newest request is read once it stops, so dragging the
+ * spin box through many iterations reads only the one it stops at.  The
+ * requests in between are never read and the current iteration stays
+ * shown until the newest is ready.
+ */
+class IterationScrubber : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit IterationScrubber(IterationLoader * l, QObject * parent = 0);
+    ~IterationScrubber();
+
+    void request(int iteration);
+    void cancel();
+    bool isLoading() const { return loading; }
+
+  signals:
+    /*! \brief The latest iteration requested has been read, the receiver
+     *  owns the data */
+    void iterationReady(IterationData * data);
+
+  private slots:
+    void loadFinished();
+
+  private:
+    void start(int iteration);
+    IterationLoader * loader;
+    QFutureWatcher<IterationData *> loadWatcher;
+    QAtomicInt aborted;  /*!< \brief Set to stop the read and drop it */
+    bool loading;  /*!< \brief True until the read has finished */
+    int pending;  /*!< \brief The iteration to read next, -1 if none */
+};
+
+#endif  // ITERATIONSCRUBBER_H_
@@ -6,10 +6,76 @@
  *  \brief Implementation of \c main()
  */
 #include <QtGui/QApplication>
+#include <QTextStream>
+#include <QStringList>
+#include <stdio.h>
 #include "./mainwindow.h"
+#include "./batchrenderer.h"
+
+/*! \brief Read the options of a batch render from the command line.
+ *  \param args The command line arguments
+ *  \param options The options read
+ *  \return False if the arguments are not valid
+ */
+static bool readBatchOptions(const QStringList & args,
+        BatchOptions * options) {
+    bool hasFirst = false;
+    bool hasLast = false;
+    for (int i = 1; i < args.count(); i++) {
+        QString arg = args.at(i);
+        if (i + 1 >= args.count()) return false;
+        QString value = args.at(++i);
+        bool ok = true;
+        if (arg == "--batch") {
+            options->configFile = value;
+        } else if (arg == "--first") {
+            options->first = value.toInt(&ok);
+            hasFirst = true;
+        } else if (arg == "--last") {
+            options->last = value.toInt(&ok);
+            hasLast = true;
+        } else if (arg == "--output") {
+            options->outputDirectory = value;
+        } else if (arg == "--size") {
+            QStringList size = value.split('x');
+            if (size.count() != 2) return false;
+            bool okh = true;
+            options->width = size.at(0).toInt(&ok);
+            options->height = size.at(1).toInt(&okh);
+            ok = ok && okh && options->width > 0 && options->height > 0;
+        } else if (arg == "--jobs") {
+            options->jobs = value.toInt(&ok);
+        } else if (arg == "--format") {
+            options->format = value.toLower();
+            ok = (options->format == "jpg" || options->format == "png" ||
+                    options->format == "ppm");
+        } else {
+            return false;
+        }
+        if (!ok) return false;
+    }
+    return !options->configFile.isEmpty() && hasFirst && hasLast &&
+            options->last >= options->first;
+}
 
 int main(int argc, char *argv[]) {
     QApplication a(argc, argv);
+
+    if (a.arguments().contains("--batch")) {
+        QTextStream err(stderr);
+        BatchOptions options;
+        if (!readBatchOptions(a.arguments(), &options)) {
+            err << "Usage: " << a.arguments().at(0)
+                << " --batch config.xml --first N --last M [--output dir]"
+                << " [--size WxH] [--jobs J] [--format jpg|png|ppm]" << endl;
+            return 1;
+        }
+        BatchRenderer renderer(options);
+        int rc = renderer.run();
+        if (rc != 0) err << renderer.errorString() << endl;
+        return rc;
+    }
+
     MainWindow w;
     w.show();
 
@@ -29,6 +95,18 @@ int main(int argc, char *argv[]) {
  * -# The graph plots
  * -# The iteration settings
  *
+ * \section BATCH Batch Rendering
+ * Iterations can be rendered to images without opening a window:
+ * \code
+ * flame_visualiser --batch config.xml --first 0 --last 100 --output images
+ *     --size 1024x768 --jobs 4 --format png
+ * \endcode
+ * The \c BatchRenderer draws the rules and camera of the config file into
+ * an offscreen pixel buffer.  Iterations are read and populated by \c jobs
+ * worker threads, the number of cores by default, and written in iteration
+ * order as \c N.jpg, \c N.png or \c N.ppm.  On a machine without a screen
+ * run it under a virtual X server such as Xvfb with Mesa.
+ *
  * \section DATASTRUCT Data Structures
  * -# The visual rules table class \c VisualSettingsModel is an implementation of \c QAbstractTableModel
  *    - which holds objects of type \c VisualSettingsItem
@@ -39,6 +117,10 @@ int main(int argc, char *argv[]) {
  *    - which holds objects of type \c GraphSettingsItem
  * -# The time settings dialog class \c TimeDialog handles the time associated with one time step
  * -# The rescrict axes dialog class \c RestrictAxesDialog handles the restriction of drawing agents on different axes
+ * -# The agents of an iteration are held in an \c AgentStore
+ *    - which holds one \c AgentColumns per agent type with a column of doubles per memory variable
+ * -# Iteration files are read by an \c IterationLoader
+ *    - which reads ahead on worker threads and keeps binary sidecar files with an \c IterationCache
  *
  * The \c VisualSettingsItem is used to represent visual rules and contains:
  * - agent type
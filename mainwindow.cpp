@@ -17,7 +17,6 @@
 #include <math.h>
 #include "./mainwindow.h"
 #include "./ui_mainwindow.h"
-#include "./zeroxmlreader.h"
 #include "./visualsettingsmodel.h"
 #include "./visualsettingsitem.h"
 #include "./configxmlreader.h"
@@ -58,12 +57,40 @@ MainWindow::MainWindow(QWidget *parent)
     iteration = 0;
     openedValidIteration = false;
     delayTime = 0;
+    iterationLoader = new IterationLoader();
+    graphAggregator = new GraphAggregator();
+    graphBackfill = new GraphBackfill(this);
+    connect(graphBackfill, SIGNAL(countsReady(int, PlotCounts)),
+            this, SLOT(graphCountsReady(int, PlotCounts)));
+    connect(graphBackfill, SIGNAL(progress(int, int)),
+            this, SLOT(graphBackfillProgress(int, int)));
+    iterationIndex = new IterationIndex(this);
+    iterationLoader->setIndex(iterationIndex);
+    connect(iterationIndex, SIGNAL(changed()),
+            this, SLOT(iterationIndexChanged()));
+    iterationFollower = new IterationFollower(iterationIndex, this);
+    connect(iterationFollower, SIGNAL(iterationReady(IterationData*)),
+            this, SLOT(followIterationReady(IterationData*)));
+    connect(iterationFollower, SIGNAL(iterationFailed(int, QString)),
+            this, SLOT(followIterationFailed(int, QString)));
+    iterationScrubber = new IterationScrubber(iterationLoader, this);
+    connect(iterationScrubber, SIGNAL(iterationReady(IterationData*)),
+            this, SLOT(scrubIterationReady(IterationData*)));
+    prefetchDepth = 2;
+    prefetchMemory = 512;
+    iterationDirection = 1;
     configPath = "";
     configName = "";
     timeScale = new TimeScale();
     visual_settings_model = new VisualSettingsModel();
-    connect(visual_settings_model, SIGNAL(ruleUpdated(int)),
-            this, SLOT(ruleUpdated(int)));
+    connect(visual_settings_model, SIGNAL(ruleUpdated(int, int)),
+            this, SLOT(ruleUpdated(int, int)));
+    ruleUpdater = new RuleUpdater(visual_settings_model, this);
+    connect(ruleUpdater,
+            SIGNAL(ruleUpdated(VisualSettingsItem*, Dimension)),
+            this, SLOT(ruleAgentsUpdated(VisualSettingsItem*, Dimension)));
+    connect(ruleUpdater, SIGNAL(progress(int, int)),
+            this, SLOT(ruleUpdaterProgress(int, int)));
     graph_settings_model = new GraphSettingsModel(&agents);
     connect(graph_settings_model,
             SIGNAL(plotGraphChanged(GraphSettingsItem*, QString, QString)),
@@ -183,6 +210,10 @@ MainWindow::MainWindow(QWidget *parent)
  */
 MainWindow::~MainWindow() {
     delete ui;
+    /* The scrubber may be reading with the loader */
+    delete iterationScrubber;
+    delete iterationLoader;
+    delete graphAggregator;
 
     /* Output settings */
     QFile file(".flamevisualisersettings");
@@ -244,6 +275,10 @@ void MainWindow::visual_window_closed() {
             this, SLOT(visual_window_closed()));
     disconnect(this, SIGNAL(iterationLoaded()),
             visual_window, SLOT(iterationLoaded()));
+    disconnect(this, SIGNAL(agentsChanged()),
+            visual_window, SLOT(agentsChanged()));
+    disconnect(this, SIGNAL(startAnimation()),
+            visual_window, SLOT(update()));
     disconnect(visual_window, SIGNAL(signal_toggleAnimation()),
             this, SLOT(slot_toggleAnimation()));
     disconnect(this, SIGNAL(takeSnapshotSignal()),
@@ -254,6 +289,12 @@ void MainWindow::visual_window_closed() {
             visual_window, SIGNAL(takeAnimation(bool)));
     disconnect(this, SIGNAL(updateImagesLocationSignal(QString)),
             visual_window, SLOT(updateImagesLocation(QString)));
+    disconnect(this, SIGNAL(updateImagesFormatSignal(QString)),
+            visual_window, SLOT(updateImagesFormat(QString)));
+    disconnect(this, SIGNAL(updateImagesStreamSignal(QString)),
+            visual_window, SLOT(updateImagesStream(QString)));
+    disconnect(visual_window, SIGNAL(imageQueueChanged(int)),
+            this, SLOT(imageQueueChanged(int)));
     disconnect(this, SIGNAL(restrictAxes(bool)),
             visual_window, SLOT(restrictAxes(bool)));
     disconnect(this, SIGNAL(updateDelayTime(int)),
@@ -281,6 +322,10 @@ void MainWindow::image_dialog_closed() {
             this, SLOT(takeAnimationSlot(bool)));
     disconnect(images_dialog, SIGNAL(updateImagesLocation(QString)),
             this, SLOT(updateImagesLocationSlot(QString)));
+    disconnect(images_dialog, SIGNAL(updateImagesFormat(QString)),
+            this, SLOT(updateImagesFormatSlot(QString)));
+    disconnect(images_dialog, SIGNAL(updateImagesStream(QString)),
+            this, SLOT(updateImagesStreamSlot(QString)));
     images_dialog_open = false;
     ui->pushButton_ImageSettings->setText("Open Image Settings");
 }
@@ -312,9 +357,17 @@ void MainWindow::restrict_axes_closed() {
             this, SLOT(restrict_axes_closed()));
     disconnect(this, SIGNAL(updatedAgentDimension()),
             restrictAxesDialog, SLOT(updatedAgentDimensions()));
+    disconnect(restrictAxesDialog, SIGNAL(updateRestrictDimensions(Dimension)),
+            this, SLOT(restrictDimensionsUpdated()));
     emit(restrictAxes(false));
 }
 
+/*! \brief Redraw the visual window when the axes restriction changes.
+ */
+void MainWindow::restrictDimensionsUpdated() {
+    if (opengl_window_open) emit(agentsChanged());
+}
+
 /*! \brief When a graph window is closed, close all windows with the same graph name.
  *  \param graphName The graph name.
  */
@@ -347,7 +400,8 @@ void MainWindow::addPlot() {
  */
 void MainWindow::createGraphWindow(GraphWidget *graph_window) {
     graphs.append(graph_window);
-    graph_window->updateData(iteration);
+    updateGraphData();
+    startGraphBackfill();
     graph_window->resize(720, 380);
     graph_window->show();
     connect(graph_window, SIGNAL(increase_iteration()),
@@ -364,6 +418,8 @@ void MainWindow::createGraphWindow(GraphWidget *graph_window) {
  *  \param graphName The graph name
  */
 void MainWindow::closeGraphWindows(QString graphName) {
+    bool backfilling = graphBackfill->isRunning();
+    graphBackfill->cancel();
     graph_settings_model->setDisabled(graphName);
 
     /* Check open graphs */
@@ -374,6 +430,9 @@ void MainWindow::closeGraphWindows(QString graphName) {
             i--;
         }
     }
+
+    /* Finish filling the graphs still open */
+    if (backfilling) startGraphBackfill();
 }
 
 /*! \brief Enable or disable a visual rule when the enabled cell
@@ -385,13 +444,15 @@ void MainWindow::enabledRule(QModelIndex index) {
     if (index.column() == 7) {
         /* Switch the enabled value */
         visual_settings_model->switchEnabled(index);
+        /* Agents of a type no other enabled rule used were not read */
+        if (updateProjection()) {
+            readZeroXML();
+            return;
+        }
         /* Populate rule agents */
-        visual_settings_model->getRule(index.row())->populate(&agents);
-        visual_settings_model->getRule(index.row())->
-                copyAgentDrawDataToRuleAgentDrawData(agentDimension);
-        visual_settings_model->getRule(index.row())->
-                applyOffset(xoffset, yoffset, zoffset);
-        visual_settings_model->getRule(index.row())->applyRatio(ratio);
+        visual_settings_model->getRule(index.row())->populate(&agents,
+                agentDimension, xoffset, yoffset, zoffset, ratio);
+        emit(agentsChanged());
     }
 }
 
@@ -405,8 +466,7 @@ void MainWindow::enabledGraph(QModelIndex index) {
         enabled = !(graph_settings_model->getPlot(index.row())->getEnable());
         graph_settings_model->switchEnabled(index);
         if (enabled) {
-            GraphWidget * gw = new GraphWidget(
-                        &agents, &graph_style, timeScale);
+            GraphWidget * gw = new GraphWidget(&graph_style, timeScale);
             gw->setGraph(graph_settings_model->
                     getPlot(index.row())->getGraph());
             QList<GraphSettingsItem *> subplots =
@@ -440,10 +500,11 @@ void MainWindow::plotGraphChanged(GraphSettingsItem * gsi, QString oldGraph,
         }
         if (QString::compare(graphs[i]->getGraph(), newGraph) == 0) {
             graphs[i]->addPlot(gsi);
-            graphs[i]->updateData(iteration);
+            updateGraphData();
             graphs[i]->repaint();
         }
     }
+    startGraphBackfill();
 }
 
 /*! \brief Show the colour dialog when the colour cell of the visual table is clicked.
@@ -544,6 +605,7 @@ void MainWindow::on_pushButton_LocationFind_clicked() {
     QDir dir2(s1);
     s = dir2.relativeFilePath(filepath);
     ui->lineEdit_ResultsLocation->setText(s);
+    iterationIndex->setDirectory(resultsDirectory());
 
     // tryAndReadInAgentTypes();
     readZeroXML(); /* Read in new agent data */
@@ -565,6 +627,7 @@ void MainWindow::on_pushButton_OpenCloseVisual_clicked() {
         visual_window->set_rules(visual_settings_model);
         visual_window->setIteration(&iteration);
         visual_window->setConfigPath(&configPath);
+        visual_window->setAgentsFileName(&agentsFileName);
         visual_window->setTimeScale(timeScale);
         visual_window->setTimeString(&timeString);
         visual_window->setDimension(visual_dimension);
@@ -581,6 +644,10 @@ void MainWindow::on_pushButton_OpenCloseVisual_clicked() {
                 this, SLOT(visual_window_closed()));
         connect(this, SIGNAL(iterationLoaded()),
                 visual_window, SLOT(iterationLoaded()));
+        connect(this, SIGNAL(agentsChanged()),
+                visual_window, SLOT(agentsChanged()));
+        connect(this, SIGNAL(startAnimation()),
+                visual_window, SLOT(update()));
         connect(visual_window, SIGNAL(signal_toggleAnimation()),
                 this, SLOT(slot_toggleAnimation()));
         connect(this, SIGNAL(takeSnapshotSignal()),
@@ -591,6 +658,12 @@ void MainWindow::on_pushButton_OpenCloseVisual_clicked() {
                 visual_window, SLOT(takeAnimation(bool)));
         connect(this, SIGNAL(updateImagesLocationSignal(QString)),
                 visual_window, SLOT(updateImagesLocation(QString)));
+        connect(this, SIGNAL(updateImagesFormatSignal(QString)),
+                visual_window, SLOT(updateImagesFormat(QString)));
+        connect(this, SIGNAL(updateImagesStreamSignal(QString)),
+                visual_window, SLOT(updateImagesStream(QString)));
+        connect(visual_window, SIGNAL(imageQueueChanged(int)),
+                this, SLOT(imageQueueChanged(int)));
         connect(this, SIGNAL(restrictAxes(bool)),
                 visual_window, SLOT(restrictAxes(bool)));
         connect(this, SIGNAL(updateDelayTime(int)),
@@ -601,6 +674,8 @@ void MainWindow::on_pushButton_OpenCloseVisual_clicked() {
         visual_window->setFocus();
         ui->pushButton_OpenCloseVisual->setText("Close Visual Window");
         opengl_window_open = true;
+        /* The results directory may have been made after it was set */
+        iterationIndex->refresh();
         /* Set update viewpoint button to be false */
         ui->pushButton_updateViewpoint->setEnabled(true);
         ui->pushButton_Animate->setEnabled(true);
@@ -609,7 +684,21 @@ void MainWindow::on_pushButton_OpenCloseVisual_clicked() {
     }
 }
 
+/*! \brief The directory of the iteration files.
+ */
+QString MainWindow::resultsDirectory() {
+    QString directory;
+    directory.append(configPath);
+    directory.append("/");
+    directory.append(ui->lineEdit_ResultsLocation->text());
+    return directory;
+}
+
 /*! \brief Read the 0 xml defined by the current iteration.
+ *
+ * The iteration is taken from the iteration loader, which hands over the
+ * data if it has already been read ahead on a worker thread.  The following
+ * iterations in the direction of travel are then read ahead.
  *  \return False if the file could not be found.
  */
 int MainWindow::readZeroXML() {
@@ -617,46 +706,67 @@ int MainWindow::readZeroXML() {
 
     itLocked = true;
 
-    QString fileName;
-    fileName.append(configPath);
-    fileName.append("/");
-    fileName.append(ui->lineEdit_ResultsLocation->text());
-    fileName.append("/");
-    fileName.append(QString().number(iteration));
-    fileName.append(".xml");
+    /* This iteration replaces any chosen with the spin box */
+    iterationScrubber->cancel();
+    setupIterationLoader();
 
-    // qDebug() << "Opening file: " << fileName;
+    IterationData * data = iterationLoader->take(iteration);
+    int rc = applyIterationData(data);
+    delete data;
+    itLocked = false;
+    if (rc != 0) return rc;
 
-    QFile file(fileName);
-    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+    iterationLoader->prefetch(iteration, iterationDirection);
+    return 0;
+}
+
+/*! \brief Give the iteration loader the current results directory, read
+ *  ahead settings and variables to read.
+ */
+void MainWindow::setupIterationLoader() {
+    iterationLoader->setDirectory(resultsDirectory());
+    iterationLoader->setDepth(prefetchDepth);
+    iterationLoader->setMemoryLimit(prefetchMemory);
+    updateProjection();
+}
+
+/*! \brief Make the data of an iteration the current agent data.
+ *  \param data The iteration data read by the iteration loader
+ *  \return 0 success, 1 error opening file, 2 error reading file
+ */
+int MainWindow::applyIterationData(IterationData * data) {
+    if (data->rc == 1) {
         // ui->spinBox->setValue(iteration);
         ui->label_5->setText(QString("! Error opening %1.xml").
                     arg(QString().number(iteration)));
-        itLocked = false;
         return 1;
     }
 
-    // used by visual
-/*    for (int i = 0; i < visual_settings_model->rowCount(); i++) {
-        for (int j = 0; j < visual_settings_model->getRule(i)->agents.size(); j++)
-            // Free memory of ruleagent data
-            delete visual_settings_model->getRule(i)->agents.at(j);
-        visual_settings_model->getRule(i)->agents.clear();
-    }*/
-    // used by graphs
-    for (int j = 0; j < agents.size(); j++)
-        // Free memory of agent tag data
-        delete agents.at(j);
-    agents.clear();
+    /* Take the agents, the columns are shared not copied */
+    agents = data->agents;
+    data->agents.clear();
+    agentsFileName = data->fileName;
     // used by iteration info dialog
     QHash<QString, int>::iterator i;
     for (i = agentTypeCounts.begin(); i != agentTypeCounts.end(); ++i)
         i.value() = 0;
+    QHash<QString, int>::const_iterator j;
+    for (j = data->agentTypeCounts.constBegin();
+            j != data->agentTypeCounts.constEnd(); ++j)
+        agentTypeCounts.insert(j.key(), j.value());
+
+    addNewAgentTypes();
+    populateRules();
+
+    if (data->rc == 2 && iterationFollower->isEnabled() &&
+            !IterationFollower::hasClosingTag(data->fileName)) {
+        /* Still being written by the running simulation */
+        ui->label_5->setText(QString("Waiting for %1.xml").
+                    arg(QString().number(iteration)));
+        return 2;
+    }
 
-    ZeroXMLReader reader(&agents, &agentTypes, visual_settings_model, ratio,
-            agentDimension, &stringAgentTypes, &agentTypeCounts,
-            xoffset, yoffset, zoffset);
-    if (!reader.read(&file)) {
+    if (data->rc == 2) {
         // ui->spinBox->setValue(iteration);
         ui->label_5->setText(
                     QString("! Error reading %1.xml").
@@ -664,22 +774,20 @@ int MainWindow::readZeroXML() {
 
 
         /* Make the path to the file look pretty */
-         QDir dir(fileName);
+         QDir dir(data->fileName);
          QString filePath = dir.canonicalPath();
 
          QString error = tr(
              "Cannot parse iteration file %1 at line %2, column %3:\n%4").arg(
-             filePath).arg(reader.lineNumber()).arg(
-             reader.columnNumber()).arg(reader.errorString());
+             filePath).arg(data->lineNumber).arg(
+             data->columnNumber).arg(data->errorString);
         #ifdef TESTBUILD
         qDebug() << error;
         #else
         QMessageBox::warning(this, "FLAME Visualiser", error);
         #endif
-        itLocked = false;
          return 2;
     } else {
-        itLocked = false;
          if (opengl_window_open) emit(iterationLoaded());
          ui->label_5->setText(
                  QString("Read %1.xml").arg(QString().number(iteration)));
@@ -695,16 +803,89 @@ int MainWindow::readZeroXML() {
     return 0;
 }
 
-/*! \brief Change the iteration number to the number of the spin box.
+/*! \brief Add agent types not seen in earlier iterations to the agent
+ *  type lists used by the rule and plot delegates.
+ */
+void MainWindow::addNewAgentTypes() {
+    for (int t = 0; t < agents.typeCount(); t++) {
+        const AgentColumns & columns = agents.type(t);
+        if (stringAgentTypes.contains(columns.name)) continue;
+
+        // qDebug() << "new agent type found: " << columns.name;
+        stringAgentTypes.append(columns.name);
+        AgentType agentType(columns.name);
+        /* Variables not read can still be chosen */
+        agentType.variables = columns.variables + columns.skipped;
+        agentTypes.append(agentType);
+    }
+}
+
+/*! \brief Populate the rule agents of every visual rule from the current
+ *  agents and recalculate the agent dimension.
+ */
+void MainWindow::populateRules() {
+    /* Edits queued are covered by populating every rule */
+    ruleUpdater->cancel();
+    visual_settings_model->populate(&agents, agentDimension,
+            xoffset, yoffset, zoffset, ratio);
+}
+
+/*! \brief Read only the agents and variables used by the visual rules
+ *  and plots from now on.
+ *  \return True if agents or a variable not read for the current agents
+ *  are needed
+ */
+bool MainWindow::updateProjection() {
+    AgentProjection p(false);
+    QList<VisualSettingsItem *> rules = visual_settings_model->getRules();
+    for (int i = 0; i < rules.count(); i++) p.addRule(rules.at(i));
+    QList<GraphSettingsItem *> plots = graph_settings_model->getPlots();
+    for (int i = 0; i < plots.count(); i++) p.addPlot(plots.at(i));
+
+    bool wider = !projection.contains(p);
+    projection = p;
+    iterationLoader->setProjection(p);
+    iterationFollower->setProjection(p);
+    return wider;
+}
+
+/*! \brief Read the iteration of the spin box in the background.
+ *
+ * Only the latest value is read, a read of an earlier value is cancelled,
+ * and the current iteration stays shown until it is ready.
  *  \param arg1 The value of the spin box
  */
 void MainWindow::on_spinBox_valueChanged(int arg1) {
     // qDebug() << "on_spinBox_valueChanged" << arg1;
-    if (iteration != arg1) {
-        iteration = arg1;
-        int rc = readZeroXML(); /* Read in new agent data */
-        if (rc == 0) if (ui->checkBox_timeScale->isChecked()) calcTimeScale();
+    if (iteration == arg1) {
+        /* Back to the iteration shown */
+        iterationScrubber->cancel();
+        return;
     }
+    /* Choosing an iteration stops following the run */
+    ui->actionFollow_Run->setChecked(false);
+    setupIterationLoader();
+    iterationScrubber->request(arg1);
+}
+
+/*! \brief Show the iteration chosen with the spin box once it is read.
+ *  \param data The iteration data read by the scrubber
+ */
+void MainWindow::scrubIterationReady(IterationData * data) {
+    if (itLocked || !fileOpen) {
+        delete data;
+        return;
+    }
+    itLocked = true;
+    iterationDirection = (data->iteration < iteration) ? -1 : 1;
+    iteration = data->iteration;
+    int rc = applyIterationData(data);
+    delete data;
+    itLocked = false;
+    if (rc != 0) return;
+
+    iterationLoader->prefetch(iteration, iterationDirection);
+    if (ui->checkBox_timeScale->isChecked()) calcTimeScale();
 }
 
 /*! \brief Increment the iteration number, read in new agent data, set the spin box value, update all graphs.
@@ -713,6 +894,7 @@ void MainWindow::increment_iteration() {
     int rc;
     /* increase iteration number */
     iteration++;
+    iterationDirection = 1;
     /* try and read the iteration file
      * the parameter 1 means try and read in the agent data */
     rc = readZeroXML();
@@ -738,9 +920,7 @@ void MainWindow::increment_iteration() {
     } else {
         if (ui->checkBox_timeScale->isChecked()) calcTimeScale();
 
-        for (int i = 0; i < graphs.count(); i++) {
-            graphs.at(i)->updateData(iteration);
-        }
+        updateGraphData();
 
         if (restrict_dimension_open) emit(updatedAgentDimension());
     }
@@ -753,7 +933,9 @@ void MainWindow::increment_iteration() {
 void MainWindow::decrement_iteration() {
     int rc;
 
+    ui->actionFollow_Run->setChecked(false);
     if (iteration > 0) iteration--;
+    iterationDirection = -1;
     rc = readZeroXML();
 
     if (rc == 1) {  // Can't open file
@@ -785,39 +967,110 @@ void MainWindow::open_config_file() {
      readConfigFile(fileName, 0);
 }
 
+/*! \brief Find the iteration file after or before an iteration and make
+ *  it the iteration.
+ *  \param it The iteration
+ *  \param flag 0 to search forward, 1 to search backward
+ *  \return False if there is no such file
+ */
 bool MainWindow::checkDirectoryForNextIteration(int it, int flag) {
-    QString fileName;
-    fileName.append(configPath);
-    fileName.append("/");
-    fileName.append(ui->lineEdit_ResultsLocation->text());
-    fileName.append("/");
-
-    QDir dir(fileName);
-    QStringList filters;
-    filters << "*.xml";
-    dir.setNameFilters(filters);
-    QStringList list = dir.entryList();
-    QList<int> ilist;
-    for (int i = 0; i < list.size(); i++) {
-        QString f = list.at(i);
-        f.chop(4);
-        bool s;
-        int j = f.toInt(&s);
-        if (s) ilist.append(j);
+    int found;
+    if (flag == 0 && iterationIndex->next(it, &found)) {
+        iteration = found;
+        return true;
     }
-    qSort(ilist);
-    for (int i = 0; i < ilist.size(); i++) {
-        if ((ilist.at(i) > it && flag == 0) ||
-                (ilist.at(ilist.size()-1-i) < it && flag == 1)) {
-            if (flag == 0) iteration = ilist.at(i);
-            if (flag == 1) iteration = ilist.at(ilist.size()-1-i);
-            return true;
-        }
+    if (flag == 1 && iterationIndex->previous(it, &found)) {
+        iteration = found;
+        return true;
     }
-
     return false;
 }
 
+/*! \brief Limit the spin box to the first and last iteration files.
+ *
+ * The spin box signal is blocked so the iteration is not read here.
+ *  \return True if the iteration was outside the range and was moved
+ */
+bool MainWindow::updateIterationRange() {
+    int first = 0;
+    int last = 999999999;
+    if (!iterationIndex->isEmpty()) {
+        first = iterationIndex->first();
+        last = iterationIndex->last();
+    }
+    ui->spinBox->blockSignals(true);
+    ui->spinBox->setRange(first, last);
+    ui->spinBox->blockSignals(false);
+
+    int clamped = qBound(first, iteration, last);
+    if (clamped == iteration) return false;
+    iteration = clamped;
+    ui->spinBox->blockSignals(true);
+    ui->spinBox->setValue(iteration);
+    ui->spinBox->blockSignals(false);
+    return true;
+}
+
+/*! \brief Start or stop following the newest iteration of a running
+ *  simulation.
+ *  \param checked True to follow
+ */
+void MainWindow::on_actionFollow_Run_toggled(bool checked) {
+    if (checked && animation) slot_toggleAnimation();
+    if (checked) iterationScrubber->cancel();
+    iterationDirection = 1;
+    iterationFollower->setLastIteration(iteration);
+    iterationFollower->setEnabled(checked);
+}
+
+/*! \brief Show an iteration written by the running simulation and add it
+ *  to the graphs.
+ *  \param data The iteration data read by the follower
+ */
+void MainWindow::followIterationReady(IterationData * data) {
+    if (itLocked || !fileOpen || !iterationFollower->isEnabled()) {
+        delete data;
+        return;
+    }
+    itLocked = true;
+    iteration = data->iteration;
+    updateIterationRange();
+    ui->spinBox->blockSignals(true);
+    ui->spinBox->setValue(iteration);
+    ui->spinBox->blockSignals(false);
+    int rc = applyIterationData(data);
+    delete data;
+    itLocked = false;
+    if (rc != 0) return;
+
+    if (ui->checkBox_timeScale->isChecked()) calcTimeScale();
+    updateGraphData();
+    if (restrict_dimension_open) emit(updatedAgentDimension());
+}
+
+/*! \brief Report an iteration written by the running simulation that
+ *  could not be read.
+ *  \param it The iteration
+ *  \param error The reason
+ */
+void MainWindow::followIterationFailed(int it, const QString & error) {
+    if (!fileOpen || !iterationFollower->isEnabled()) return;
+    ui->label_5->setText(QString("! Error reading %1.xml").
+                arg(QString().number(it)));
+    #ifdef TESTBUILD
+    qDebug() << error;
+    #else
+    QMessageBox::warning(this, "FLAME Visualiser", error);
+    #endif
+}
+
+/*! \brief The iteration files have changed so update the spin box range,
+ *  reading the iteration if it has to move.
+ */
+void MainWindow::iterationIndexChanged() {
+    if (updateIterationRange() && fileOpen) readZeroXML();
+}
+
 /*! \brief Read in a config file.
  *  \param fileName The file name
  *  \param it The iteration number to be set
@@ -840,7 +1093,7 @@ int MainWindow::readConfigFile(QString fileName, int it) {
     ConfigXMLReader reader(visual_settings_model, graph_settings_model,
             &resultsData, timeScale, &ratio, &xrotate, &yrotate,
             &xmove, &ymove, &zmove, &delayTime, &orthoZoom, &visual_dimension,
-            &visualBackground);
+            &visualBackground, &prefetchDepth, &prefetchMemory);
     if (!reader.read(&file)) {
         QString error = tr("Parse error in file %1 at line %2, column %3:\n%4").
                 arg(fileName).
@@ -885,6 +1138,7 @@ int MainWindow::readConfigFile(QString fileName, int it) {
     if (ui->checkBox_timeScale->isChecked()) calcTimeScale();
 
     ui->lineEdit_ResultsLocation->setText(resultsData);
+    iterationIndex->setDirectory(resultsDirectory());
     //        tryAndReadInAgentTypes();
     openedValidIteration = false;
     readZeroXML();
@@ -1003,6 +1257,8 @@ void MainWindow::save_config_file() {
 /*! \brief Close the config file and disable the user interface.
  */
 void MainWindow::close_config_file() {
+    graphBackfill->cancel();
+    ruleUpdater->cancel();
     this->setWindowTitle("FLAME Visualiser - ");
     visual_settings_model->deleteRules();
     graph_settings_model->deletePlots();
@@ -1035,6 +1291,14 @@ void MainWindow::close_config_file() {
     animation = false;
     agentTypeCounts.clear();
     stringAgentTypes.clear();
+    iterationScrubber->cancel();
+    iterationLoader->clear();
+    ui->actionFollow_Run->setChecked(false);
+    iterationIndex->clear();
+    updateIterationRange();
+    prefetchDepth = 2;
+    prefetchMemory = 512;
+    iterationDirection = 1;
     on_actionPerspective_triggered();
 }
 
@@ -1075,6 +1339,9 @@ bool MainWindow::writeConfigXML(QFile * file) {
 
     stream.writeStartElement("animation");  // animation
     stream.writeTextElement("delay", QString("%1").arg(delayTime));
+    stream.writeTextElement("prefetchDepth", QString("%1").arg(prefetchDepth));
+    stream.writeTextElement("prefetchMemory",
+            QString("%1").arg(prefetchMemory));
     stream.writeEndElement();  // animation
 
     stream.writeStartElement("visual");
@@ -1288,76 +1555,20 @@ void MainWindow::keyPressEvent(QKeyEvent* event) {
  *  centre at origin.
  */
 void MainWindow::calcPositionOffsetAndRatio() {
-    double smallest_x = 0.0;
-    double largest_x = 0.0;
-    double smallest_y = 0.0;
-    double largest_y = 0.0;
-    double smallest_z = 0.0;
-    double largest_z = 0.0;
-    double smallest = 0.0;
-    double largest = 0.0;
-
-    // Calc offset first
-    for (int j = 0; j < visual_settings_model->rowCount(); j++) {
-        for (int i= 0; i < visual_settings_model->getRule(j)->agents.count();
-                i++) {
-            if (smallest_x > visual_settings_model->getRule(j)->agents.at(i)->x)
-                smallest_x = visual_settings_model->getRule(j)->agents.at(i)->x;
-            if (smallest_y > visual_settings_model->getRule(j)->agents.at(i)->y)
-                smallest_y = visual_settings_model->getRule(j)->agents.at(i)->y;
-            if (largest_x  < visual_settings_model->getRule(j)->agents.at(i)->x)
-                largest_x  = visual_settings_model->getRule(j)->agents.at(i)->x;
-            if (largest_y  < visual_settings_model->getRule(j)->agents.at(i)->y)
-                largest_y  = visual_settings_model->getRule(j)->agents.at(i)->y;
-        }
-    }
-    /* Takes the middle position of x and y */
-    xoffset = -(largest_x + smallest_x)/2.0;
-    yoffset = -(largest_y + smallest_y)/2.0;
-    zoffset = -(largest_z + smallest_z)/2.0;
-
-    // Apply offset and calc ratio
-    for (int j = 0; j < visual_settings_model->rowCount(); j++) {
-        for (int i= 0; i < visual_settings_model->getRule(j)->agents.count();
-                i++) {
-            // Apply offset
-            visual_settings_model->getRule(j)->agents.at(i)->x += xoffset;
-            visual_settings_model->getRule(j)->agents.at(i)->y += yoffset;
-            visual_settings_model->getRule(j)->agents.at(i)->z += zoffset;
-            double x = visual_settings_model->getRule(j)->agents.at(i)->x;
-            double y = visual_settings_model->getRule(j)->agents.at(i)->y;
-            double size_x =
-                visual_settings_model->getRule(j)->shape().getDimension()/2.0;
-            double size_y = size_x;
-            if (QString::compare("cube",
-                visual_settings_model->getRule(j)->shape().getShape()) == 0)
-                size_y =
-                visual_settings_model->getRule(j)->shape().getDimensionY()/2.0;
-
-            if (smallest > x-size_x) smallest = x-size_x;
-            if (smallest > y-size_y) smallest = y-size_y;
-            if (largest  < x+size_x) largest  = x+size_x;
-            if (largest  < y+size_y) largest  = y+size_y;
-        }
-    }
-    if (smallest < 0.0 && largest < -smallest)
-        ratio = 1.0 / -smallest;
-    else
-        ratio = 1.0 / largest;
-
-    // Apply ratio
-    for (int j = 0; j < visual_settings_model->rowCount(); j++) {
-        visual_settings_model->getRule(j)->applyRatio(ratio);
-    }
+    visual_settings_model->calcPositionOffsetAndRatio(&xoffset, &yoffset,
+            &zoffset, &ratio);
 }
 
 void MainWindow::slot_toggleAnimation() {
     if (opengl_window_open) {
         animation = !animation;
-        if (animation)
+        if (animation) {
             ui->pushButton_Animate->setText("Stop Animation - A");
-        else
+            emit(startAnimation());
+        } else {
             ui->pushButton_Animate->setText("Start Animation - A");
+            emit(stopAnimation());
+        }
     }
 }
 
@@ -1391,6 +1602,10 @@ void MainWindow::on_pushButton_ImageSettings_clicked() {
                 this, SLOT(takeAnimationSlot(bool)));
         connect(images_dialog, SIGNAL(updateImagesLocation(QString)),
                 this, SLOT(updateImagesLocationSlot(QString)));
+        connect(images_dialog, SIGNAL(updateImagesFormat(QString)),
+                this, SLOT(updateImagesFormatSlot(QString)));
+        connect(images_dialog, SIGNAL(updateImagesStream(QString)),
+                this, SLOT(updateImagesStreamSlot(QString)));
 
         images_dialog->setConfigPath(&configPath);
         images_dialog->setLocation(ui->lineEdit_ResultsLocation->text());
@@ -1420,9 +1635,66 @@ void MainWindow::updateImagesLocationSlot(QString s) {
     if (opengl_window_open) emit(updateImagesLocationSignal(s));
 }
 
-void MainWindow::ruleUpdated(int /*row*/) {
-    // Reread agents using updated rules
-    if (opengl_window_open) readZeroXML();
+void MainWindow::updateImagesFormatSlot(QString s) {
+    if (opengl_window_open) emit(updateImagesFormatSignal(s));
+}
+
+void MainWindow::updateImagesStreamSlot(QString s) {
+    if (opengl_window_open) emit(updateImagesStreamSignal(s));
+}
+
+/*! \brief Show the number of snapshots waiting to be written.
+ *  \param depth The number of snapshots queued
+ */
+void MainWindow::imageQueueChanged(int depth) {
+    if (depth > 0)
+        ui->statusBar->showMessage(QString("Images: %1 queued").arg(depth));
+    else
+        ui->statusBar->showMessage("Images: written", 3000);
+}
+
+/*! \brief Update the rule agents of an edited rule from the agents
+ *  already read.
+ *
+ * A colour only changes how the rule agents are drawn, which the visual
+ * window rebuilds itself.  Any other cell changes which agents the rule
+ * has or where they are, so the rule is populated again in the
+ * background.  If the rule now uses agents or a variable that were not
+ * read the iteration is read again.
+ *  \param row The rule
+ *  \param column The cell edited
+ */
+void MainWindow::ruleUpdated(int row, int column) {
+    if (!opengl_window_open || column == 6) return;
+    /* Agents or a variable that were not read are needed */
+    if (updateProjection()) {
+        readZeroXML();
+        return;
+    }
+    ruleUpdater->update(visual_settings_model->getRule(row), agents,
+            xoffset, yoffset, zoffset, ratio);
+}
+
+/*! \brief Draw the new rule agents of an edited rule.
+ *  \param dimension The scene dimension of the rule agents
+ */
+void MainWindow::ruleAgentsUpdated(VisualSettingsItem * /*rule*/,
+        const Dimension & dimension) {
+    agentDimension->merge(dimension);
+    emit(agentsChanged());
+}
+
+/*! \brief Show how many edited rules have been populated.
+ *  \param done The rules populated
+ *  \param total The rules edited
+ */
+void MainWindow::ruleUpdaterProgress(int done, int total) {
+    if (done < total)
+        ui->statusBar->showMessage(QString("Rules: %1 of %2 updated").
+                arg(done).arg(total));
+    else
+        ui->statusBar->showMessage(QString("Rules: %1 updated").
+                arg(total), 3000);
 }
 
 void MainWindow::on_actionQuit_triggered() {
@@ -1548,6 +1820,8 @@ void MainWindow::on_actionRestrict_Axes_triggered() {
                 this, SLOT(restrict_axes_closed()));
         connect(this, SIGNAL(updatedAgentDimension()),
                 restrictAxesDialog, SLOT(updatedAgentDimensions()));
+        connect(restrictAxesDialog, SIGNAL(updateRestrictDimensions(Dimension)),
+                this, SLOT(restrictDimensionsUpdated()));
         emit(restrictAxes(true));
     }
     restrictAxesDialog->show();
@@ -1588,8 +1862,9 @@ void MainWindow::resetVisualViewpoint() {
 
     for (int i = 0; i < visual_settings_model->rowCount(); i++)
         visual_settings_model->getRule(i)->
-            copyAgentDrawDataToRuleAgentDrawData(agentDimension);
+            copyAgentDrawDataToRuleAgentDrawData(&agents, agentDimension);
     calcPositionOffsetAndRatio();
+    emit(agentsChanged());
 }
 
 void MainWindow::on_pushButton_updateViewpoint_clicked() {
@@ -1611,6 +1886,58 @@ void MainWindow::on_actionOrthogonal_triggered() {
     if (opengl_window_open) visual_window->setDimension(2);
 }
 
+/*! \brief Count the agents of every plot of the open graph windows in one
+ *  pass and give the counts of the current iteration to each window.
+ */
+void MainWindow::updateGraphData() {
+    if (graphs.isEmpty()) return;
+
+    QList<GraphSettingsItem *> plots;
+    for (int i = 0; i < graphs.size(); i++)
+        plots.append(graphs.at(i)->getPlots());
+    PlotCounts counts = graphAggregator->aggregate(agents, plots);
+
+    for (int i = 0; i < graphs.size(); i++)
+        graphs.at(i)->updateData(iteration, counts);
+}
+
+/*! \brief Count every iteration of the run for the plots of the open graph
+ *  windows in the background.
+ */
+void MainWindow::startGraphBackfill() {
+    graphBackfill->cancel();
+    if (graphs.isEmpty()) return;
+
+    QList<GraphSettingsItem *> plots;
+    for (int i = 0; i < graphs.size(); i++)
+        plots.append(graphs.at(i)->getPlots());
+    graphBackfill->start(resultsDirectory(),
+            iterationIndex->iterations().toList(), plots);
+}
+
+/*! \brief Give the counts of an iteration counted in the background to the
+ *  graph windows.
+ *  \param it The iteration
+ *  \param counts The count of every plot of the open graph windows
+ */
+void MainWindow::graphCountsReady(int it, const PlotCounts & counts) {
+    for (int i = 0; i < graphs.size(); i++)
+        graphs.at(i)->updateData(it, counts);
+}
+
+/*! \brief Show how far the background count of the graphs has got.
+ *  \param done The iteration files counted
+ *  \param total The iteration files in the results directory
+ */
+void MainWindow::graphBackfillProgress(int done, int total) {
+    if (done < total)
+        ui->statusBar->showMessage(QString("Graphs: %1 of %2 iterations").
+                arg(done).arg(total));
+    else
+        ui->statusBar->showMessage(QString("Graphs: %1 iterations").
+                arg(total), 3000);
+}
+
 void MainWindow::updateAllGraphs() {
     int i;
     for (i = 0; i < graphs.size(); i++)
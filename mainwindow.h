@@ -12,7 +12,10 @@
 #include <QFile>
 #include "./glwidget.h"
 #include "./graphwidget.h"
-#include "./agent.h"
+#include "./graphaggregator.h"
+#include "./graphbackfill.h"
+#include "./agentstore.h"
+#include "./agentprojection.h"
 #include "./agenttype.h"
 #include "./visualsettingsmodel.h"
 #include "./graphsettingsmodel.h"
@@ -22,6 +25,11 @@
 #include "./restrictaxesdialog.h"
 #include "./dimension.h"
 #include "./iterationinfodialog.h"
+#include "./iterationloader.h"
+#include "./iterationindex.h"
+#include "./iterationfollower.h"
+#include "./iterationscrubber.h"
+#include "./ruleupdater.h"
 
 /*! \brief
   */
@@ -58,10 +66,14 @@ class MainWindow : public QMainWindow {
     void imageStatusSlot(QString);
     void takeAnimationSlot(bool);
     void updateImagesLocationSlot(QString);
+    void updateImagesFormatSlot(QString);
+    void updateImagesStreamSlot(QString);
+    void imageQueueChanged(int);
     void colourChanged(QColor);
     void backgroundColourChanged(QColor c);
     void calcTimeScale();
     void restrict_axes_closed();
+    void restrictDimensionsUpdated();
     void slot_toggleAnimation();
     void iterationInfoDialog_closed();
 
@@ -71,10 +83,13 @@ class MainWindow : public QMainWindow {
     void stopAnimation();
     void startAnimation();
     void iterationLoaded();
+    void agentsChanged();
     void takeSnapshotSignal();
     void imageStatusSignal(QString);
     void takeAnimationSignal(bool);
     void updateImagesLocationSignal(QString);
+    void updateImagesFormatSignal(QString);
+    void updateImagesStreamSignal(QString);
     void restrictAxes(bool);
     void updatedAgentDimension();
     void updateDelayTime(int);
@@ -103,7 +118,10 @@ class MainWindow : public QMainWindow {
             QString newGraph);
     void on_pushButton_Animate_clicked();
     void on_pushButton_ImageSettings_clicked();
-    void ruleUpdated(int);
+    void ruleUpdated(int row, int column);
+    void ruleAgentsUpdated(VisualSettingsItem * rule,
+            const Dimension & dimension);
+    void ruleUpdaterProgress(int done, int total);
     void on_actionQuit_triggered();
     void on_actionAbout_triggered();
     void on_pushButton_timeScale_clicked();
@@ -120,11 +138,24 @@ class MainWindow : public QMainWindow {
     void on_actionLinespoints_triggered();
     void on_actionDots_triggered();
     void on_actionBackground_triggered();
+    void graphCountsReady(int it, const PlotCounts & counts);
+    void graphBackfillProgress(int done, int total);
+    void iterationIndexChanged();
+    void on_actionFollow_Run_toggled(bool checked);
+    void followIterationReady(IterationData * data);
+    void followIterationFailed(int it, const QString & error);
+    void scrubIterationReady(IterationData * data);
 
   private:
     int save_config_file_internal(QString fileName);
     int create_new_config_file(QString fileName);
     int readZeroXML();
+    void setupIterationLoader();
+    QString resultsDirectory();
+    int applyIterationData(IterationData * data);
+    void addNewAgentTypes();
+    void populateRules();
+    bool updateProjection();
     bool writeConfigXML(QFile * file);
     void createGraphWindow(GraphWidget * graph_window);
     int readConfigFile(QString fileName, int it);
@@ -132,8 +163,11 @@ class MainWindow : public QMainWindow {
     void calcPositionOffsetAndRatio();
     void findLoadSettings();
     bool checkDirectoryForNextIteration(int it, int flag);
+    bool updateIterationRange();
     void resetVisualViewpoint();
     void updateAllGraphs();
+    void updateGraphData();
+    void startGraphBackfill();
     Ui::MainWindow *ui;  /*!< The User Interface */
     bool opengl_window_open;  /*!< Indicates if the visual window is open */
     /*! Indicates if the image settings window is open */
@@ -143,7 +177,9 @@ class MainWindow : public QMainWindow {
     GLWidget *visual_window;  /*!< The visual window */
     int iteration;  /*!< The current iteration number */
     bool fileOpen;  /*!< Indicates if a file is open */
-    QList<Agent*> agents;  /*!< The list of agents */
+    AgentStore agents;  /*!< The agents of the current iteration */
+    QString agentsFileName;  /*!< The iteration file of the agents */
+    AgentProjection projection;  /*!< The variables read of the agents */
     QList<AgentType> agentTypes;  /*!< The list of agent types */
     /*! A string list of agent type names  */
     QStringList stringAgentTypes;
@@ -183,6 +219,23 @@ class MainWindow : public QMainWindow {
     RestrictAxesDialog * restrictAxesDialog;
     bool animation;
     int delayTime; /*!< The animation delay time in millisecs */
+    /*! Reads iteration files and prefetches upcoming iterations */
+    IterationLoader * iterationLoader;
+    /*! Counts the agents of every plot in one pass */
+    GraphAggregator * graphAggregator;
+    /*! Fills the graphs with every iteration in the background */
+    GraphBackfill * graphBackfill;
+    /*! The sorted iterations of the results directory */
+    IterationIndex * iterationIndex;
+    /*! Reads the newest iterations of a running simulation */
+    IterationFollower * iterationFollower;
+    /*! Reads the latest iteration chosen with the spin box */
+    IterationScrubber * iterationScrubber;
+    /*! Populates edited visual rules in the background */
+    RuleUpdater * ruleUpdater;
+    int prefetchDepth; /*!< The number of iterations to read ahead */
+    int prefetchMemory; /*!< The memory limit of read ahead in MB */
+    int iterationDirection; /*!< 1 if moving forward, -1 if backward */
     int visual_dimension;
     int graph_style;
     QColor visualBackground;
@@ -0,0 +1,35 @@
+/*!
+ * \file memoryusage.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of memory usage
+ */
+#include "./memoryusage.h"
+#if defined(Q_OS_WIN)
+    #include <windows.h>
+    #include <psapi.h>
+#elif defined(Q_OS_UNIX)
+    #include <sys/resource.h>
+#endif
+
+qint64 peakMemoryUsage() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+            sizeof(counters))) return -1;
+    return static_cast<qint64>(counters.PeakWorkingSetSize);
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+    #if defined(Q_OS_MAC)
+    /* Bytes on Mac OS X */
+    return static_cast<qint64>(usage.ru_maxrss);
+    #else
+    /* Kilobytes on Linux */
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;
+    #endif
+#else
+    return -1;
+#endif
+}
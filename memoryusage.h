@@ -0,0 +1,18 @@
+/*!
+ * \file memoryusage.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for memory usage
+ */
+#ifndef MEMORYUSAGE_H_
+#define MEMORYUSAGE_H_
+
+#include <QtGlobal>
+
+/*! \brief The peak resident memory of the process in bytes, -1 if the
+ *  platform does not say.
+ */
+qint64 peakMemoryUsage();
+
+#endif  // MEMORYUSAGE_H_
@@ -0,0 +1,256 @@
+/*!
+ * \file parallelzeroxmlreader.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of parallel zero XML reader
+ */
+#include <QIODevice>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <string.h>
+#include "./parallelzeroxmlreader.h"
+#include "./zeroxmlreader.h"
+#include "./fastzeroxmlreader.h"
+
+/*! \brief A read only device over a chunk of mapped memory, wrapped in
+ *  the tags needed to make the chunk a document of its own.
+ */
+class ChunkDevice : public QIODevice {
+  public:
+    ChunkDevice(const QByteArray & p, const char * d, qint64 s,
+            const QByteArray & e) {
+        prefix = p;
+        data = d;
+        size = s;
+        suffix = e;
+        pos = 0;
+    }
+
+    bool isSequential() const { return true; }
+    qint64 bytesAvailable() const {
+        return prefix.size() + size + suffix.size() - pos +
+                QIODevice::bytesAvailable();
+    }
+
+  protected:
+    qint64 readData(char * to, qint64 maxlen) {
+        qint64 read = 0;
+        while (read < maxlen) {
+            const char * from;
+            qint64 available;
+            if (pos < prefix.size()) {
+                from = prefix.constData() + pos;
+                available = prefix.size() - pos;
+            } else if (pos < prefix.size() + size) {
+                from = data + (pos - prefix.size());
+                available = prefix.size() + size - pos;
+            } else if (pos < prefix.size() + size + suffix.size()) {
+                from = suffix.constData() + (pos - prefix.size() - size);
+                available = prefix.size() + size + suffix.size() - pos;
+            } else {
+                break;
+            }
+            qint64 n = qMin(available, maxlen - read);
+            memcpy(to + read, from, n);
+            read += n;
+            pos += n;
+        }
+        return read;
+    }
+    qint64 writeData(const char *, qint64) { return -1; }
+
+  private:
+    QByteArray prefix;
+    const char * data;
+    qint64 size;
+    QByteArray suffix;
+    qint64 pos;
+};
+
+/*! \brief Reads one chunk of an iteration file on a worker thread, with
+ *  the fast reader if the chunk has the usual shape.
+ */
+class ChunkReader : public QRunnable {
+  public:
+    ChunkReader(const char * d, qint64 s, bool f, bool l,
+            const AgentProjection * p, const QAtomicInt * a) {
+        data = d;
+        size = s;
+        first = f;
+        last = l;
+        projection = p;
+        abort = a;
+        ok = false;
+        setAutoDelete(false);
+    }
+
+    void run() {
+        FastZeroXMLReader fastReader(&agents, &agentTypeCounts);
+        fastReader.setProjection(projection);
+        fastReader.setAbort(abort);
+        ok = fastReader.read(data, size, first, last);
+        if (ok || fastReader.isAborted()) return;
+
+        /* Not the usual shape, read again with the general reader */
+        agents.clear();
+        agentTypeCounts.clear();
+        ChunkDevice device(first ? QByteArray() : QByteArray("<states>"),
+                data, size, last ? QByteArray() : QByteArray("</states>"));
+        device.open(QIODevice::ReadOnly);
+        ZeroXMLReader reader(&agents, &agentTypeCounts);
+        reader.setProjection(projection);
+        reader.setAbort(abort);
+        ok = reader.read(&device);
+    }
+
+    AgentStore agents;
+    QHash<QString, int> agentTypeCounts;
+    bool ok;
+
+  private:
+    const char * data;
+    qint64 size;
+    bool first;
+    bool last;
+    const AgentProjection * projection;
+    const QAtomicInt * abort;
+};
+
+/*! \brief Find the next xagent start tag.
+ *  \param data The file data
+ *  \param from The offset to search from
+ *  \param size The size of the file data
+ *  \return The offset of the tag or -1 if there is none
+ */
+static qint64 findAgentStart(const char * data, qint64 from, qint64 size) {
+    static const char tag[] = "<xagent>";
+    static const qint64 length = sizeof(tag) - 1;
+
+    while (from + length <= size) {
+        const char * p = static_cast<const char *>(
+                memchr(data + from, '<', size - from));
+        if (p == 0) return -1;
+        from = p - data;
+        if (from + length <= size && memcmp(p, tag, length) == 0)
+            return from;
+        from++;
+    }
+    return -1;
+}
+
+ParallelZeroXMLReader::ParallelZeroXMLReader(AgentStore *a,
+        QHash<QString, int> *atc) {
+    agents = a;
+    agentTypeCounts = atc;
+    chunkCount = 0;
+    projection = 0;
+    abort = 0;
+    line = 0;
+    column = 0;
+}
+
+/*! \brief Read an iteration file into the agent store.
+ *  \param file The opened iteration file
+ *  \return False if the file could not be read
+ */
+bool ParallelZeroXMLReader::read(QFile * file) {
+    qint64 size = file->size();
+    int chunks = chunkCount;
+    if (chunks <= 0)
+        chunks = static_cast<int>(qMin(
+                static_cast<qint64>(QThread::idealThreadCount()),
+                size / minimumChunkSize));
+    if (chunks < 1) chunks = 1;
+
+    uchar * data = 0;
+    if (size > 0) data = file->map(0, size);
+    if (data == 0) return readSequential(file);
+
+    bool ok = readChunks(reinterpret_cast<const char *>(data), size, chunks);
+    file->unmap(data);
+    if (ok) return true;
+    if (abort && *abort != 0) {
+        error = QObject::tr("Reading was cancelled");
+        return false;
+    }
+
+    /* Read again in one go to report the error where it is in the file */
+    return readSequential(file);
+}
+
+/*! \brief Read the mapped file data in chunks on worker threads.
+ *  \param data The file data
+ *  \param size The size of the file data
+ *  \param chunks The number of chunks wanted
+ *  \return False if any chunk could not be read
+ */
+bool ParallelZeroXMLReader::readChunks(const char * data, qint64 size,
+        int chunks) {
+    /* Split near equal sizes, moving each split to an xagent start tag */
+    QList<qint64> splits;
+    splits.append(0);
+    for (int i = 1; i < chunks; i++) {
+        qint64 from = qMax(size / chunks * i, splits.last() + 1);
+        qint64 split = findAgentStart(data, from, size);
+        if (split == -1) break;
+        splits.append(split);
+    }
+    splits.append(size);
+
+    QList<ChunkReader *> readers;
+    for (int i = 0; i < splits.count() - 1; i++)
+        readers.append(new ChunkReader(data + splits.at(i),
+                splits.at(i + 1) - splits.at(i),
+                i == 0, i == splits.count() - 2, projection, abort));
+
+    if (readers.count() == 1) {
+        readers.at(0)->run();
+    } else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(qMin(readers.count(),
+                qMax(QThread::idealThreadCount(), 1)));
+        for (int i = 0; i < readers.count(); i++) pool.start(readers.at(i));
+        pool.waitForDone();
+    }
+
+    bool ok = true;
+    for (int i = 0; i < readers.count(); i++)
+        if (!readers.at(i)->ok) ok = false;
+
+    /* Merge in file order so types and variables keep their order */
+    if (ok) {
+        for (int i = 0; i < readers.count(); i++) {
+            agents->append(readers.at(i)->agents);
+            QHash<QString, int>::const_iterator j;
+            for (j = readers.at(i)->agentTypeCounts.constBegin();
+                    j != readers.at(i)->agentTypeCounts.constEnd(); ++j)
+                agentTypeCounts->insert(j.key(),
+                        agentTypeCounts->value(j.key()) + j.value());
+        }
+    }
+
+    qDeleteAll(readers);
+    return ok;
+}
+
+/*! \brief Read the whole file with one ZeroXMLReader.
+ *  \param file The opened iteration file
+ *  \return False if the file could not be read
+ */
+bool ParallelZeroXMLReader::readSequential(QFile * file) {
+    agents->clear();
+    agentTypeCounts->clear();
+    file->seek(0);
+
+    ZeroXMLReader reader(agents, agentTypeCounts);
+    reader.setProjection(projection);
+    reader.setAbort(abort);
+    if (reader.read(file)) return true;
+
+    error = reader.errorString();
+    line = reader.lineNumber();
+    column = reader.columnNumber();
+    return false;
+}
@@ -0,0 +1,59 @@
+/*!
+ * \file parallelzeroxmlreader.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for parallel zero XML reader
+ */
+#ifndef PARALLELZEROXMLREADER_H_
+#define PARALLELZEROXMLREADER_H_
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QAtomicInt>
+#include "./agentstore.h"
+#include "./agentprojection.h"
+
+/*! \brief Reads an iteration file in parallel chunks.
+ *
+ * The mapped file is split at xagent start tags and each chunk is read by
+ * its own FastZeroXMLReader, or ZeroXMLReader if the chunk is not of the
+ * usual shape, on a worker thread into a thread local store.  The stores
+ * and agent type counts are then appended in file order, which gives the
+ * same result as reading the whole file in one go.  Small files are read
+ * as one chunk.  Files that cannot be mapped and any chunk that fails to
+ * read fall back to the sequential reader so errors are reported exactly
+ * as before.
+ */
+class ParallelZeroXMLReader {
+  public:
+    ParallelZeroXMLReader(AgentStore * a, QHash<QString, int> * atc);
+
+    void setChunkCount(int c) { chunkCount = c; }
+    void setProjection(const AgentProjection * p) { projection = p; }
+    void setAbort(const QAtomicInt * a) { abort = a; }
+    bool read(QFile * file);
+    QString errorString() const { return error; }
+    qint64 lineNumber() const { return line; }
+    qint64 columnNumber() const { return column; }
+
+    /*! \brief The smallest chunk worth a thread of its own */
+    static const qint64 minimumChunkSize = 16 * 1024 * 1024;
+
+  private:
+    bool readChunks(const char * data, qint64 size, int chunks);
+    bool readSequential(QFile * file);
+    AgentStore * agents;
+    QHash<QString, int> * agentTypeCounts;
+    int chunkCount;  /*!< \brief Chunks to read, 0 to choose from file size */
+    /*! \brief The variables to read, 0 for every variable */
+    const AgentProjection * projection;
+    /*! \brief Stops reading with an error when set, 0 if never stopped */
+    const QAtomicInt * abort;
+    QString error;
+    qint64 line;
+    qint64 column;
+};
+
+#endif  // PARALLELZEROXMLREADER_H_
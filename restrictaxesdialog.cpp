@@ -176,6 +176,7 @@ void RestrictAxesDialog::updateXMin(double d) {
     restrictDimension->xmin = d*(*ratio);
     emit(ui->horizontalSlider_xMin->
             setValue(static_cast<int>((d-xStart)/xStep)));
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::updateXMax(double d) {
@@ -183,6 +184,7 @@ void RestrictAxesDialog::updateXMax(double d) {
     restrictDimension->xmax = d*(*ratio);
     emit(ui->horizontalSlider_xMax->
             setValue(static_cast<int>((d-xStart)/xStep)));
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::updateYMin(double d) {
@@ -190,6 +192,7 @@ void RestrictAxesDialog::updateYMin(double d) {
     restrictDimension->ymin = d*(*ratio);
     emit(ui->horizontalSlider_yMin->
             setValue(static_cast<int>((d-yStart)/yStep)));
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::updateYMax(double d) {
@@ -197,6 +200,7 @@ void RestrictAxesDialog::updateYMax(double d) {
     restrictDimension->ymax = d*(*ratio);
     emit(ui->horizontalSlider_yMax->
             setValue(static_cast<int>((d-yStart)/yStep)));
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::updateZMin(double d) {
@@ -204,6 +208,7 @@ void RestrictAxesDialog::updateZMin(double d) {
     restrictDimension->zmin = d*(*ratio);
     emit(ui->horizontalSlider_zMin->
             setValue(static_cast<int>((d-zStart)/zStep)));
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::updateZMax(double d) {
@@ -211,6 +216,7 @@ void RestrictAxesDialog::updateZMax(double d) {
     restrictDimension->zmax = d*(*ratio);
     emit(ui->horizontalSlider_zMax->
             setValue(static_cast<int>((d-zStart)/zStep)));
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::updateXMinS(int i) {
@@ -296,6 +302,7 @@ void RestrictAxesDialog::enableXMin(bool b) {
     restrictAgentDimension->xminon = b;
     ui->label_xmin->setEnabled(b);
     ui->doubleSpinBox_xMin->setEnabled(b);
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::enableXMax(bool b) {
@@ -303,6 +310,7 @@ void RestrictAxesDialog::enableXMax(bool b) {
     restrictAgentDimension->xmaxon = b;
     ui->label_xmax->setEnabled(b);
     ui->doubleSpinBox_xMax->setEnabled(b);
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::enableYMin(bool b) {
@@ -310,6 +318,7 @@ void RestrictAxesDialog::enableYMin(bool b) {
     restrictAgentDimension->yminon = b;
     ui->label_ymin->setEnabled(b);
     ui->doubleSpinBox_yMin->setEnabled(b);
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::enableYMax(bool b) {
@@ -317,6 +326,7 @@ void RestrictAxesDialog::enableYMax(bool b) {
     restrictAgentDimension->ymaxon = b;
     ui->label_ymax->setEnabled(b);
     ui->doubleSpinBox_yMax->setEnabled(b);
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::enableZMin(bool b) {
@@ -324,6 +334,7 @@ void RestrictAxesDialog::enableZMin(bool b) {
     restrictAgentDimension->zminon = b;
     ui->label_zmin->setEnabled(b);
     ui->doubleSpinBox_zMin->setEnabled(b);
+    emit(updateRestrictDimensions(*restrictDimension));
 }
 
 void RestrictAxesDialog::enableZMax(bool b) {
@@ -331,4 +342,5 @@ void RestrictAxesDialog::enableZMax(bool b) {
     restrictAgentDimension->zmaxon = b;
     ui->label_zmax->setEnabled(b);
     ui->doubleSpinBox_zMax->setEnabled(b);
+    emit(updateRestrictDimensions(*restrictDimension));
 }
@@ -12,7 +12,7 @@
 
 class RuleAgent {
   public:
-    explicit RuleAgent(Agent * a) {
+    explicit RuleAgent(Agent a) {
         x = 0.0;
         y = 0.0;
         z = 0.0;
@@ -35,8 +35,8 @@ class RuleAgent {
     double conditionVariable;
     bool isEnvironment;
     bool isPicked;
-    /*! \brief Pointer to original agent memory variables */
-    Agent * agent;
+    /*! \brief Reference to original agent memory variables */
+    Agent agent;
 };
 
 #endif  // RULEAGENT_H_
@@ -0,0 +1,63 @@
+/*!
+ * \file ruleagentarena.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of rule agent arena
+ */
+#include <new>
+#include "./ruleagentarena.h"
+
+RuleAgentArena::RuleAgentArena() {
+    block = 0;
+    used = 0;
+}
+
+RuleAgentArena::~RuleAgentArena() {
+    release();
+}
+
+/*! \brief Make a rule agent in the arena.  It is valid until the arena is
+ *  reset.
+ *  \param a The agent the rule agent draws
+ */
+RuleAgent * RuleAgentArena::create(const Agent & a) {
+    if (used == blockSize) {
+        block++;
+        used = 0;
+    }
+    if (block == blocks.count())
+        blocks.append(static_cast<RuleAgent *>(
+                qMalloc(blockSize * sizeof(RuleAgent))));
+    return new (blocks.at(block) + used++) RuleAgent(a);
+}
+
+/*! \brief Empty the arena, keeping its blocks for the next iteration.
+ */
+void RuleAgentArena::reset() {
+    block = 0;
+    used = 0;
+}
+
+/*! \brief Empty the arena and free its blocks.
+ */
+void RuleAgentArena::release() {
+    for (int i = 0; i < blocks.count(); i++) qFree(blocks.at(i));
+    blocks.clear();
+    reset();
+}
+
+/*! \brief Exchange the rule agents and blocks of two arenas.
+ */
+void RuleAgentArena::swap(RuleAgentArena & other) {
+    qSwap(blocks, other.blocks);
+    qSwap(block, other.block);
+    qSwap(used, other.used);
+}
+
+/*! \brief The memory held by the arena in bytes.
+ */
+qint64 RuleAgentArena::memoryUsage() const {
+    return static_cast<qint64>(blocks.count()) * blockSize *
+            static_cast<qint64>(sizeof(RuleAgent));
+}
@@ -0,0 +1,45 @@
+/*!
+ * \file ruleagentarena.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for rule agent arena
+ */
+#ifndef RULEAGENTARENA_H_
+#define RULEAGENTARENA_H_
+
+#include <QVector>
+#include "./ruleagent.h"
+
+/*! \brief Holds the rule agents of a visual rule for one iteration.
+ *
+ * Rule agents are placed one after another in large blocks instead of
+ * being allocated one at a time.  Rule agents need no destruction, so the
+ * arena is emptied for the next iteration by going back to the start of
+ * the first block, and the blocks are reused rather than freed.
+ */
+class RuleAgentArena {
+  public:
+    RuleAgentArena();
+    ~RuleAgentArena();
+
+    RuleAgent * create(const Agent & a);
+    void reset();
+    void release();
+    void swap(RuleAgentArena & other);
+    int count() const { return block * blockSize + used; }
+    qint64 memoryUsage() const;
+
+    /*! \brief The number of rule agents in a block */
+    static const int blockSize = 4096;
+
+  private:
+    /* Not copyable, the rule agents are pointed to */
+    RuleAgentArena(const RuleAgentArena &);
+    RuleAgentArena & operator=(const RuleAgentArena &);
+    QVector<RuleAgent *> blocks;  /*!< \brief Storage of blockSize each */
+    int block;  /*!< \brief The block being filled */
+    int used;  /*!< \brief Rule agents in the block being filled */
+};
+
+#endif  // RULEAGENTARENA_H_
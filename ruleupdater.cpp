@@ -0,0 +1,133 @@
+/*!
+ * \file ruleupdater.cpp
+ *  \author Simon Coakley
+ *  \date 2012
+ *  \copyright Copyright (c) 2012 University of Sheffield
+ *  \brief Implementation of rule updater
+ */
+#include <QtConcurrentRun>
+#include "./ruleupdater.h"
+
+RuleUpdater::RuleUpdater(VisualSettingsModel * m, QObject * parent)
+    : QObject(parent), model(m) {
+    running = 0;
+    stale = false;
+    done = 0;
+    total = 0;
+    connect(&watcher, SIGNAL(finished()), this, SLOT(updateFinished()));
+    connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex, int, int)),
+            this, SLOT(rulesAboutToBeRemoved(QModelIndex, int, int)));
+}
+
+RuleUpdater::~RuleUpdater() {
+    cancel();
+    watcher.waitForFinished();
+    if (running) {
+        delete running->copy;
+        delete running;
+    }
+}
+
+/*! \brief Queue a rule to be populated again.
+ *  \param rule The edited rule
+ *  \param agents The agents of the current iteration
+ *  \param xoffset The x offset to centre the scene
+ *  \param yoffset The y offset to centre the scene
+ *  \param zoffset The z offset to centre the scene
+ *  \param ratio The ratio from model space to opengl space
+ */
+void RuleUpdater::update(VisualSettingsItem * rule, const AgentStore & agents,
+        double xoffset, double yoffset, double zoffset, double ratio) {
+    if (running && running->rule == rule) stale = true;
+
+    RuleUpdate * u = new RuleUpdate;
+    u->rule = rule;
+    /* Copy the settings now, later edits queue the rule again */
+    u->copy = new VisualSettingsItem(rule->agentType(), rule->condition(),
+            rule->x(), rule->y(), rule->z(), rule->shape(), rule->colour(),
+            rule->enabled());
+    u->agents = agents;
+    u->dimension.reset();
+    u->xoffset = xoffset;
+    u->yoffset = yoffset;
+    u->zoffset = zoffset;
+    u->ratio = ratio;
+
+    /* Only the latest edit of a queued rule is populated */
+    for (int i = 0; i < queue.count(); i++) {
+        if (queue.at(i)->rule == rule) {
+            delete queue.at(i)->copy;
+            delete queue.at(i);
+            queue[i] = u;
+            return;
+        }
+    }
+    queue.append(u);
+    total++;
+    emit(progress(done, total));
+    if (!running) startNext();
+}
+
+/*! \brief Forget the queued rules and the result of the running one, as
+ *  when every rule is populated for a new iteration.
+ */
+void RuleUpdater::cancel() {
+    for (int i = 0; i < queue.count(); i++) {
+        delete queue.at(i)->copy;
+        delete queue.at(i);
+    }
+    queue.clear();
+    if (running) stale = true;
+    done = 0;
+    total = running ? 1 : 0;
+}
+
+void RuleUpdater::startNext() {
+    if (queue.isEmpty()) {
+        done = 0;
+        total = 0;
+        return;
+    }
+    running = queue.takeFirst();
+    stale = false;
+    watcher.setFuture(QtConcurrent::run(RuleUpdater::populate, running));
+}
+
+void RuleUpdater::populate(RuleUpdate * update) {
+    update->copy->populate(&update->agents, &update->dimension,
+            update->xoffset, update->yoffset, update->zoffset, update->ratio);
+}
+
+void RuleUpdater::updateFinished() {
+    RuleUpdate * u = running;
+    running = 0;
+    done++;
+    if (!stale) {
+        u->rule->takeAgents(u->copy);
+        emit(ruleUpdated(u->rule, u->dimension));
+    }
+    delete u->copy;
+    delete u;
+    emit(progress(done, total));
+    startNext();
+}
+
+void RuleUpdater::rulesAboutToBeRemoved(const QModelIndex & /*parent*/,
+        int first, int last) {
+    for (int i = first; i <= last; i++) forget(model->getRule(i));
+}
+
+/*! \brief Drop a rule that is being deleted so its rule agents are never
+ *  replaced.
+ */
+void RuleUpdater::forget(VisualSettingsItem * rule) {
+    if (running && running->rule == rule) stale = true;
+    for (int i = 0; i < queue.count(); i++) {
+        if (queue.at(i)->rule == rule) {
+            delete queue.at(i)->copy;
+            delete queue.takeAt(i);
+            total--;
+            return;
+        }
+    }
+}
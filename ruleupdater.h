@@ -0,0 +1,72 @@
+/*!
+ * \file ruleupdater.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for rule updater
+ */
+#ifndef RULEUPDATER_H_
+#define RULEUPDATER_H_
+
+#include <QObject>
+#include <QList>
+#include <QFutureWatcher>
+#include "./visualsettingsmodel.h"
+#include "./agentstore.h"
+#include "./dimension.h"
+
+/*! \brief A rule copied with the agents to populate it from */
+struct RuleUpdate {
+    VisualSettingsItem * rule;  /*!< \brief The rule in the model */
+    VisualSettingsItem * copy;  /*!< \brief Populated on the worker */
+    AgentStore agents;  /*!< \brief Shared columns of the iteration */
+    Dimension dimension;  /*!< \brief The scene dimension of the copy */
+    double xoffset, yoffset, zoffset, ratio;
+};
+
+/*! \brief Populates edited visual rules again in the background from the
+ *  agents already read.
+ *
+ * The worker populates a copy of the rule so the rule being drawn is never
+ * touched off the GUI thread.  When done the rule agents of the copy are
+ * swapped into the rule.  Rules edited again while queued are populated
+ * once, and a rule edited while being populated is queued again.
+ */
+class RuleUpdater : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit RuleUpdater(VisualSettingsModel * m, QObject * parent = 0);
+    ~RuleUpdater();
+
+    void update(VisualSettingsItem * rule, const AgentStore & agents,
+            double xoffset, double yoffset, double zoffset, double ratio);
+    void cancel();
+    bool isRunning() const { return running != 0; }
+
+  signals:
+    /*! \brief The rule agents of a rule have been replaced, the scene
+     *  dimension of the rule is given to expand the agent dimension */
+    void ruleUpdated(VisualSettingsItem * rule, const Dimension & dimension);
+    /*! \brief The number of queued rules populated so far */
+    void progress(int done, int total);
+
+  private slots:
+    void updateFinished();
+    void rulesAboutToBeRemoved(const QModelIndex & parent, int first,
+            int last);
+
+  private:
+    void startNext();
+    void forget(VisualSettingsItem * rule);
+    static void populate(RuleUpdate * update);
+    VisualSettingsModel * model;
+    QFutureWatcher<void> watcher;
+    QList<RuleUpdate *> queue;  /*!< \brief Rules waiting to be populated */
+    RuleUpdate * running;  /*!< \brief The rule being populated, or 0 */
+    bool stale;  /*!< \brief The running rule was edited or cancelled */
+    int done;
+    int total;
+};
+
+#endif  // RULEUPDATER_H_
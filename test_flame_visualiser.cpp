@@ -8,7 +8,30 @@
 #include <QtTest/QtTest>
 #include <QtGui/QApplication>
 #include <QFileDialog>
+#include <string.h>
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
 #include "./mainwindow.h"
+#include "./zeroxmlreader.h"
+#include "./parallelzeroxmlreader.h"
+#include "./fastzeroxmlreader.h"
+#include "./iterationcache.h"
+#include "./graphaggregator.h"
+#include "./graphbackfill.h"
+#include "./imagewriter.h"
+#include "./framestream.h"
+#include "./iterationindex.h"
+#include "./iterationfollower.h"
+#include "./ruleagentarena.h"
+#include "./ruleupdater.h"
+#include "./agentprojection.h"
+#include "./iterationscrubber.h"
+#include "./agentrenderer.h"
+#include "./agentpicker.h"
+
+/* So the signal spy can record the iteration data handed over */
+Q_DECLARE_METATYPE(IterationData *)
 
 class TestVisualiser: public QObject {
     Q_OBJECT
@@ -24,6 +47,29 @@ class TestVisualiser: public QObject {
     void save_a_config();
     void open_an_iteration();
     void adding_agent_types();
+    void agent_store_columns();
+    void parallel_read_data();
+    void parallel_read();
+    void fast_parse_number_data();
+    void fast_parse_number();
+    void iteration_cache();
+    void graph_aggregator();
+    void graph_backfill_count();
+    void iteration_index();
+    void iteration_follower_tag();
+    void image_writer();
+    void frame_stream();
+    void rule_agent_arena();
+    void populate_rules();
+    void rule_updater();
+    void projection_read();
+    void projection_skip_type();
+    void iteration_scrubber();
+    void transparent_sort();
+    void prefetch_stride();
+    void read_speed_data();
+    void read_speed();
+    void agent_picker();
 
   private:
     MainWindow w;
@@ -151,5 +197,788 @@ void TestVisualiser::adding_agent_types() {
     w.close_config_file();
 }
 
+void TestVisualiser::agent_store_columns() {
+    rc = w.readConfigFile("tests/models/graph_test/visual_config.xml", 0);
+    QCOMPARE(rc, 0);
+
+    w.iteration = 0;
+    rc = w.readZeroXML();
+    QCOMPARE(rc, 0);
+    QCOMPARE(w.agents.typeCount(), 2);
+    QCOMPARE(w.agents.agentCount(), 10);
+
+    int type = w.agents.typeIndex("a");
+    QVERIFY(type != -1);
+    const AgentColumns & columns = w.agents.type(type);
+    QCOMPARE(columns.count, 9);
+    QCOMPARE(columns.variables.size(), 1);
+    int id = columns.variableIndex("id");
+    QCOMPARE(id, 0);
+    for (int i = 0; i < columns.count; i++)
+        QCOMPARE(columns.value(id, i), static_cast<double>(i));
+    QCOMPARE(columns.variableIndex("missing"), -1);
+
+    w.close_config_file();
+}
+
+void TestVisualiser::parallel_read_data() {
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<int>("chunks");
+
+    QTest::newRow("graph_test 2 chunks")
+            << "tests/models/graph_test/0.xml" << 2;
+    QTest::newRow("graph_test 4 chunks")
+            << "tests/models/graph_test/0.xml" << 4;
+    QTest::newRow("increasing_dimension")
+            << "tests/models/increasing_dimension/3.xml" << 3;
+    QTest::newRow("new_agent_types_added")
+            << "tests/models/new_agent_types_added/3.xml" << 3;
+    QTest::newRow("size_test") << "tests/models/size_test/1.xml" << 3;
+    QTest::newRow("malformed_1_xml")
+            << "tests/models/malformed_1_xml/1.xml" << 3;
+}
+
+void TestVisualiser::parallel_read() {
+    QFETCH(QString, fileName);
+    QFETCH(int, chunks);
+
+    AgentStore sequential;
+    QHash<QString, int> sequentialCounts;
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+    ZeroXMLReader reader(&sequential, &sequentialCounts);
+    bool sequentialOk = reader.read(&file);
+    file.close();
+
+    AgentStore parallel;
+    QHash<QString, int> parallelCounts;
+    QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+    ParallelZeroXMLReader parallelReader(&parallel, &parallelCounts);
+    parallelReader.setChunkCount(chunks);
+    QCOMPARE(parallelReader.read(&file), sequentialOk);
+    file.close();
+
+    if (!sequentialOk) {
+        QCOMPARE(parallelReader.lineNumber(), reader.lineNumber());
+        QCOMPARE(parallelReader.errorString(), reader.errorString());
+    }
+    QCOMPARE(parallelCounts, sequentialCounts);
+    QCOMPARE(parallel.typeCount(), sequential.typeCount());
+    for (int t = 0; t < sequential.typeCount(); t++) {
+        const AgentColumns & s = sequential.type(t);
+        const AgentColumns & p = parallel.type(t);
+        QCOMPARE(p.name, s.name);
+        QCOMPARE(p.variables, s.variables);
+        QCOMPARE(p.count, s.count);
+        QCOMPARE(p.isEnvironment, s.isEnvironment);
+        for (int v = 0; v < s.variables.count(); v++)
+            for (int r = 0; r < s.count; r++)
+                QCOMPARE(p.text(v, r), s.text(v, r));
+    }
+}
+
+void TestVisualiser::fast_parse_number_data() {
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("integer") << "42";
+    QTest::newRow("negative") << "-7";
+    QTest::newRow("decimal") << "0.1";
+    QTest::newRow("fixed") << "123.456000";
+    QTest::newRow("exponent") << "1.5e-07";
+    QTest::newRow("spaces") << "\n  3.25 \n";
+    QTest::newRow("negative zero") << "-0.0";
+    QTest::newRow("leading point") << ".5";
+    QTest::newRow("max digits") << "123456789.012345";
+}
+
+void TestVisualiser::fast_parse_number() {
+    QFETCH(QString, text);
+
+    QByteArray bytes = text.toLatin1();
+    double d;
+    QVERIFY(FastZeroXMLReader::parseNumber(bytes.constData(),
+            bytes.constData() + bytes.size(), &d));
+    bool ok;
+    double expected = text.toDouble(&ok);
+    QVERIFY(ok);
+    QVERIFY(memcmp(&d, &expected, sizeof(d)) == 0);
+}
+
+void TestVisualiser::iteration_cache() {
+    QString fileName("tests/models/size_test/1.xml");
+    QString cacheName = IterationCache::cacheFileName(fileName);
+    QFile::remove(cacheName);
+
+    AgentStore cached;
+    QHash<QString, int> cachedCounts;
+    QVERIFY(!IterationCache::read(fileName, &cached, &cachedCounts));
+
+    /* Reading the iteration file writes the cache file */
+    IterationData * data = IterationLoader::load(fileName, 1,
+            AgentProjection());
+    QCOMPARE(data->rc, 0);
+    QVERIFY(QFile::exists(cacheName));
+
+    QVERIFY(IterationCache::read(fileName, &cached, &cachedCounts));
+    QCOMPARE(cachedCounts, data->agentTypeCounts);
+    QCOMPARE(cached.typeCount(), data->agents.typeCount());
+    for (int t = 0; t < cached.typeCount(); t++) {
+        const AgentColumns & c = cached.type(t);
+        const AgentColumns & p = data->agents.type(t);
+        QCOMPARE(c.name, p.name);
+        QCOMPARE(c.variables, p.variables);
+        QCOMPARE(c.count, p.count);
+        QCOMPARE(c.isEnvironment, p.isEnvironment);
+        for (int v = 0; v < p.variables.count(); v++)
+            for (int r = 0; r < p.count; r++)
+                QCOMPARE(c.text(v, r), p.text(v, r));
+    }
+    delete data;
+
+    /* A projected read writes a cache file only it and narrower reads use */
+    QVERIFY(QFile::remove(cacheName));
+    AgentProjection projection(false);
+    projection.addType("a");
+    projection.addVariable("a", "x");
+    data = IterationLoader::load(fileName, 1, projection);
+    QCOMPARE(data->rc, 0);
+    delete data;
+    QVERIFY(QFile::exists(cacheName));
+    AgentStore projected;
+    QHash<QString, int> projectedCounts;
+    QVERIFY(!IterationCache::read(fileName, &projected, &projectedCounts));
+    QCOMPARE(projected.typeCount(), 0);
+    QVERIFY(IterationCache::read(fileName, &projected, &projectedCounts,
+            &projection));
+    QCOMPARE(projectedCounts, cachedCounts);
+    const AgentColumns & a = projected.type(projected.typeIndex("a"));
+    QCOMPARE(a.variables, QStringList("x"));
+    QVERIFY(a.skipped.contains("y"));
+
+    QVERIFY(QFile::remove(cacheName));
+    QDir(QFileInfo(fileName).path()).rmdir(IterationCache::directoryName);
+}
+
+void TestVisualiser::graph_aggregator() {
+    AgentStore store;
+    AgentColumns & columns = store.type(store.addType("a"));
+    int id = columns.addVariable("id");
+    int rows = 3 * GraphAggregator::minimumRows + 7;
+    for (int i = 0; i < rows; i++)
+        columns.setValue(id, columns.appendAgent(), static_cast<double>(i));
+
+    Condition none;
+    Condition less;
+    less.variable = "id";
+    less.op = "<";
+    less.value = 1000.0;
+    less.enable = true;
+    Condition greaterEqual = less;
+    greaterEqual.op = ">=";
+    greaterEqual.value = 100000.0;
+    Condition missing = less;
+    missing.variable = "missing";
+    GraphSettingsItem all("g", "iteration", "a", none, Qt::black, true);
+    GraphSettingsItem low("g", "iteration", "a", less, Qt::black, true);
+    GraphSettingsItem high("g", "iteration", "a", greaterEqual, Qt::black,
+            true);
+    GraphSettingsItem noVariable("g", "iteration", "a", missing, Qt::black,
+            true);
+    GraphSettingsItem noType("g", "iteration", "b", less, Qt::black, true);
+    QList<GraphSettingsItem *> plots;
+    plots << &all << &low << &high << &noVariable << &noType << &low;
+
+    for (int threads = 1; threads <= 4; threads += 3) {
+        GraphAggregator aggregator;
+        aggregator.setThreadCount(threads);
+        PlotCounts counts = aggregator.aggregate(store, plots);
+        QCOMPARE(counts.count(), 5);
+        QCOMPARE(counts.value(&all), rows);
+        QCOMPARE(counts.value(&low), 1000);
+        QCOMPARE(counts.value(&high), rows - 100000);
+        QCOMPARE(counts.value(&noVariable), 0);
+        QCOMPARE(counts.value(&noType), 0);
+    }
+}
+
+void TestVisualiser::graph_backfill_count() {
+    QList<int> its = GraphBackfill::iterations("tests/models/graph_test");
+    QCOMPARE(its, QList<int>() << 0 << 1 << 2);
+
+    PlotSpec all;
+    all.type = "a";
+    all.conditional = false;
+    PlotSpec low = all;
+    low.conditional = true;
+    low.variable = "id";
+    low.op = Condition::Less;
+    low.value = 4.0;
+    PlotSpec noType = all;
+    noType.type = "missing";
+    QList<PlotSpec> specs;
+    specs << all << low << noType;
+
+    QAtomicInt abort(0);
+    QVector<int> counts;
+    QVERIFY(GraphBackfill::countFile("tests/models/graph_test/0.xml", specs,
+            &abort, &counts));
+    QCOMPARE(counts, QVector<int>() << 9 << 4 << 0);
+    QVERIFY(!GraphBackfill::countFile("tests/models/graph_test/none.xml",
+            specs, &abort, &counts));
+}
+
+void TestVisualiser::iteration_index() {
+    IterationIndex index;
+    QSignalSpy changed(&index, SIGNAL(changed()));
+    index.setDirectory("tests/models/graph_test");
+    QCOMPARE(changed.count(), 1);
+    QCOMPARE(index.iterations(), QVector<int>() << 0 << 1 << 2);
+    QCOMPARE(index.first(), 0);
+    QCOMPARE(index.last(), 2);
+    QVERIFY(index.contains(1));
+    QVERIFY(!index.contains(3));
+
+    int found = -1;
+    QVERIFY(index.next(0, &found));
+    QCOMPARE(found, 1);
+    QVERIFY(index.next(-5, &found));
+    QCOMPARE(found, 0);
+    QVERIFY(!index.next(2, &found));
+    QVERIFY(index.previous(2, &found));
+    QCOMPARE(found, 1);
+    QVERIFY(index.previous(9, &found));
+    QCOMPARE(found, 2);
+    QVERIFY(!index.previous(0, &found));
+
+    index.clear();
+    QVERIFY(index.isEmpty());
+    QCOMPARE(changed.count(), 2);
+}
+
+void TestVisualiser::iteration_follower_tag() {
+    QVERIFY(IterationFollower::hasClosingTag("tests/models/graph_test/0.xml"));
+    QVERIFY(!IterationFollower::hasClosingTag("tests/models/none.xml"));
+
+    /* A file cut short is still being written */
+    QString fileName("tests/models/partial_test.xml");
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("<states>\n<itno>0</itno>\n<xagent>\n<name>a</name>\n");
+    file.close();
+    QVERIFY(!IterationFollower::hasClosingTag(fileName));
+    QVERIFY(file.open(QIODevice::Append));
+    file.write("</xagent>\n</states>\n\n");
+    file.close();
+    QVERIFY(IterationFollower::hasClosingTag(fileName));
+    QVERIFY(QFile::remove(fileName));
+}
+
+void TestVisualiser::image_writer() {
+    QImage image(16, 9, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); y++)
+        for (int x = 0; x < image.width(); x++)
+            image.setPixel(x, y, qRgb(x * 16, y * 28, 200));
+
+    /* The lossless formats are read back the same */
+    QStringList names;
+    names << "tests/models/image_test.png" << "tests/models/image_test.ppm";
+    for (int i = 0; i < names.count(); i++) {
+        QString error;
+        QVERIFY(ImageWriter::save(image, names.at(i), &error));
+        QVERIFY(error.isEmpty());
+        QImage read(names.at(i));
+        QCOMPARE(read.convertToFormat(QImage::Format_RGB32), image);
+        QVERIFY(QFile::remove(names.at(i)));
+    }
+
+    /* Writes are queued and counted until written */
+    ImageWriter writer;
+    writer.setThreadCount(1);
+    QCOMPARE(writer.queueLimit(), 2);
+    QSignalSpy depth(&writer, SIGNAL(queueDepthChanged(int)));
+    writer.write(image, names.at(1));
+    writer.write(image, names.at(1));
+    QVERIFY(writer.isFull());
+    writer.waitForDone();
+    QCoreApplication::processEvents();
+    QCOMPARE(writer.queueDepth(), 0);
+    QCOMPARE(depth.count(), 4);
+    QVERIFY(QFile::remove(names.at(1)));
+
+    QString error;
+    QVERIFY(!ImageWriter::save(image, "tests/models/none/image.png", &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void TestVisualiser::frame_stream() {
+    QImage white(4, 2, QImage::Format_RGB32);
+    white.fill(qRgb(255, 255, 255));
+    QByteArray frame = FrameStream::y4mFrame(white);
+    QCOMPARE(frame.size(), 6 + 3 * 8);
+    QVERIFY(frame.startsWith("FRAME\n"));
+    QCOMPARE(static_cast<uchar>(frame.at(6)), uchar(235));
+    QCOMPARE(static_cast<uchar>(frame.at(6 + 8)), uchar(128));
+    QCOMPARE(static_cast<uchar>(frame.at(6 + 16)), uchar(128));
+
+    /* Frames of another size are scaled to the first */
+    QString fileName("tests/models/stream_test.y4m");
+    QImage large(8, 4, QImage::Format_RGB32);
+    large.fill(qRgb(0, 0, 0));
+    FrameStream y4m(fileName, FrameStream::Y4M);
+    QVERIFY(y4m.writeFrame(white, 0));
+    QVERIFY(y4m.writeFrame(large, 0));
+    QCOMPARE(y4m.frameCount(), 2);
+    y4m.close();
+    QByteArray header = FrameStream::y4mHeader(4, 2);
+    QCOMPARE(header, QByteArray("YUV4MPEG2 W4 H2 F25:1 Ip A1:1 C444\n"));
+    QCOMPARE(QFileInfo(fileName).size(),
+            qint64(header.size() + 2 * frame.size()));
+
+    FrameStream ppm(fileName, FrameStream::PPM);
+    QVERIFY(ppm.writeFrame(white, 0));
+    ppm.close();
+    QImage read(fileName, "PPM");
+    QCOMPARE(read.convertToFormat(QImage::Format_RGB32), white);
+    QVERIFY(QFile::remove(fileName));
+
+    FrameStream none("tests/models/none/stream.y4m", FrameStream::Y4M);
+    QString error;
+    QVERIFY(!none.writeFrame(white, &error));
+    QVERIFY(!error.isEmpty());
+
+#ifdef Q_OS_UNIX
+    /* A named pipe nothing reads fails rather than waits */
+    QString pipeName("tests/models/stream_test.fifo");
+    QFile::remove(pipeName);
+    QCOMPARE(mkfifo(QFile::encodeName(pipeName).constData(), 0600), 0);
+    FrameStream unread(pipeName, FrameStream::Y4M);
+    error.clear();
+    QVERIFY(!unread.writeFrame(white, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(QFile::remove(pipeName));
+#endif
+}
+
+void TestVisualiser::rule_agent_arena() {
+    RuleAgentArena arena;
+    int n = RuleAgentArena::blockSize + 10;
+    RuleAgent * first = arena.create(Agent(0, 0));
+    for (int i = 1; i < n; i++) arena.create(Agent(0, i));
+    QCOMPARE(arena.count(), n);
+    qint64 used = arena.memoryUsage();
+    QCOMPARE(used, 2 * RuleAgentArena::blockSize *
+            static_cast<qint64>(sizeof(RuleAgent)));
+
+    /* The blocks are reused for the next iteration */
+    arena.reset();
+    QCOMPARE(arena.count(), 0);
+    QCOMPARE(arena.create(Agent(1, 0)), first);
+    QCOMPARE(first->agent.type, 1);
+    QCOMPARE(arena.memoryUsage(), used);
+
+    arena.release();
+    QCOMPARE(arena.memoryUsage(), qint64(0));
+}
+
+void TestVisualiser::populate_rules() {
+    AgentStore store;
+    QHash<QString, int> counts;
+    QFile file("tests/models/graph_test/0.xml");
+    QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+    ZeroXMLReader reader(&store, &counts);
+    QVERIFY(reader.read(&file));
+    file.close();
+
+    Position x;
+    x.positionVariable = "id";
+    Position zero;
+    zero.useVariable = false;
+    VisualSettingsModel model;
+    model.addRule("a", Condition(), x, zero, zero, Shape(), QColor(), true);
+    model.addRule("a", Condition(), zero, x, zero, Shape(), QColor(), true);
+    model.addRule("a", Condition(), x, x, zero, Shape(), QColor(), false);
+    model.addRule("none", Condition(), x, x, x, Shape(), QColor(), true);
+
+    /* The same as populating each rule in turn */
+    Dimension dimension;
+    model.populate(&store, &dimension, 0.0, 0.0, 0.0, 1.0);
+    Dimension sequential;
+    sequential.reset();
+    for (int i = 0; i < model.rowCount(); i++) {
+        int count = model.getRule(i)->agents.count();
+        model.getRule(i)->populate(&store, &sequential, 0.0, 0.0, 0.0, 1.0);
+        QCOMPARE(model.getRule(i)->agents.count(), count);
+    }
+    QVERIFY(dimension == sequential);
+    QCOMPARE(model.getRule(0)->agents.count(), 9);
+    QCOMPARE(model.getRule(2)->agents.count(), 0);
+    QCOMPARE(model.getRule(3)->agents.count(), 0);
+}
+
+void TestVisualiser::rule_updater() {
+    AgentStore store;
+    QHash<QString, int> counts;
+    QFile file("tests/models/graph_test/0.xml");
+    QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+    ZeroXMLReader reader(&store, &counts);
+    QVERIFY(reader.read(&file));
+    file.close();
+
+    Position x;
+    x.positionVariable = "id";
+    VisualSettingsModel model;
+    model.addRule("a", Condition(), x, x, x, Shape(), QColor(), true);
+    VisualSettingsItem * rule = model.getRule(0);
+    Dimension dimension;
+    model.populate(&store, &dimension, 0.0, 0.0, 0.0, 1.0);
+    QCOMPARE(rule->agents.count(), 9);
+
+    RuleUpdater updater(&model);
+    QSignalSpy updated(&updater,
+            SIGNAL(ruleUpdated(VisualSettingsItem*, Dimension)));
+    Condition less;
+    less.enable = true;
+    less.variable = "id";
+    less.op = "<";
+    less.value = 3.0;
+    rule->setCondition(less);
+    updater.update(rule, store, 0.0, 0.0, 0.0, 1.0);
+    /* Only the last of two edits is used */
+    less.value = 5.0;
+    rule->setCondition(less);
+    updater.update(rule, store, 0.0, 0.0, 0.0, 1.0);
+    /* The rule being drawn is untouched until the update is done */
+    QCOMPARE(rule->agents.count(), 9);
+    for (int i = 0; i < 100 && updater.isRunning(); i++) QTest::qWait(10);
+    QVERIFY(!updater.isRunning());
+    QCOMPARE(rule->agents.count(), 5);
+    QVERIFY(updated.count() >= 1);
+
+    /* A cancelled update is not used */
+    rule->setCondition(Condition());
+    updater.update(rule, store, 0.0, 0.0, 0.0, 1.0);
+    updater.cancel();
+    for (int i = 0; i < 100 && updater.isRunning(); i++) QTest::qWait(10);
+    QCOMPARE(rule->agents.count(), 5);
+}
+
+void TestVisualiser::projection_read() {
+    QString fileName("tests/models/size_test/1.xml");
+    AgentProjection projection(false);
+    projection.addType("a");
+    projection.addVariable("a", "x");
+    projection.addVariable("a", "size");
+    QVERIFY(!projection.wantsVariable("a", "y"));
+    QVERIFY(AgentProjection().contains(projection));
+    QVERIFY(!projection.contains(AgentProjection()));
+
+    /* The fast and the general readers skip the same variables */
+    for (int general = 0; general < 2; general++) {
+        AgentStore store;
+        QHash<QString, int> counts;
+        QFile file(fileName);
+        QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+        if (general) {
+            ZeroXMLReader reader(&store, &counts);
+            reader.setProjection(&projection);
+            QVERIFY(reader.read(&file));
+        } else {
+            QByteArray data = file.readAll();
+            FastZeroXMLReader reader(&store, &counts);
+            reader.setProjection(&projection);
+            QVERIFY(reader.read(data.constData(), data.size(), true, true));
+        }
+        file.close();
+
+        QCOMPARE(counts.value("a"), 4);
+        const AgentColumns & columns = store.type(store.typeIndex("a"));
+        QCOMPARE(columns.count, 4);
+        QCOMPARE(columns.variables, QStringList() << "x" << "size");
+        QCOMPARE(columns.skipped, QStringList() << "id" << "y");
+        QCOMPARE(columns.value(columns.variableIndex("x"), 2), 20.0);
+        QCOMPARE(columns.value(columns.variableIndex("size"), 3), 4.0);
+    }
+
+    /* The whole memory of one agent is read when asked for */
+    AgentColumns agent;
+    QVERIFY(ZeroXMLReader::readAgent(fileName, "a", 2, &agent));
+    QCOMPARE(agent.count, 1);
+    QCOMPARE(agent.variables.count(), 4);
+    QCOMPARE(agent.value(agent.variableIndex("id"), 0), 2.0);
+    QVERIFY(!ZeroXMLReader::readAgent(fileName, "a", 4, &agent));
+    QVERIFY(!ZeroXMLReader::readAgent(fileName, "b", 0, &agent));
+}
+
+void TestVisualiser::projection_skip_type() {
+    QString fileName("tests/models/new_agent_types_added/3.xml");
+    AgentStore full;
+    QHash<QString, int> fullCounts;
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+    ZeroXMLReader fullReader(&full, &fullCounts);
+    QVERIFY(fullReader.read(&file));
+    file.close();
+    QVERIFY(full.typeCount() > 2);
+    QString kept = full.type(1).name;
+    QString skipped = full.type(2).name;
+
+    AgentProjection projection(false);
+    projection.addType(kept);
+    AgentProjection wider(false);
+    wider.addType(kept);
+    wider.addType(skipped);
+    QVERIFY(wider.contains(projection));
+    QVERIFY(!projection.contains(wider));
+
+    /* Agents of other types are counted but not kept */
+    for (int chunks = 1; chunks <= 3; chunks += 2) {
+        AgentStore store;
+        QHash<QString, int> counts;
+        QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+        ParallelZeroXMLReader reader(&store, &counts);
+        reader.setChunkCount(chunks);
+        reader.setProjection(&projection);
+        QVERIFY(reader.read(&file));
+        file.close();
+        QCOMPARE(counts, fullCounts);
+        const AgentColumns & k = store.type(store.typeIndex(kept));
+        QCOMPARE(k.count, full.type(1).count);
+        const AgentColumns & s = store.type(store.typeIndex(skipped));
+        QCOMPARE(s.count, 0);
+        QCOMPARE(s.variables.count(), 0);
+        QCOMPARE(s.skipped.count(), full.type(2).variables.count());
+    }
+
+    /* Later agents of a type not read are skipped whole */
+    QFile sizeFile("tests/models/size_test/1.xml");
+    QVERIFY(sizeFile.open(QFile::ReadOnly | QFile::Text));
+    QByteArray data = sizeFile.readAll();
+    sizeFile.close();
+    AgentStore store;
+    QHash<QString, int> counts;
+    FastZeroXMLReader reader(&store, &counts);
+    reader.setProjection(&projection);
+    QVERIFY(reader.read(data.constData(), data.size(), true, true));
+    QCOMPARE(counts.value("a"), 4);
+    QCOMPARE(store.type(store.typeIndex("a")).count, 0);
+    QCOMPARE(store.type(store.typeIndex("a")).skipped.count(), 4);
+}
+
+void TestVisualiser::iteration_scrubber() {
+    /* A read stopped before it starts fails */
+    QAtomicInt stop(1);
+    IterationData * data = IterationLoader::load(
+            "tests/models/graph_test/1.xml", 1, AgentProjection(), &stop);
+    QCOMPARE(data->rc, 2);
+    QCOMPARE(data->agents.typeCount(), 0);
+    delete data;
+
+    /* Only the last of several requests is read and shown */
+    IterationLoader loader;
+    loader.setDirectory("tests/models/graph_test");
+    IterationScrubber scrubber(&loader);
+    qRegisterMetaType<IterationData *>("IterationData*");
+    QSignalSpy ready(&scrubber, SIGNAL(iterationReady(IterationData*)));
+    scrubber.request(0);
+    scrubber.request(1);
+    scrubber.request(2);
+    for (int i = 0; i < 100 && scrubber.isLoading(); i++) QTest::qWait(10);
+    QVERIFY(!scrubber.isLoading());
+    QCOMPARE(ready.count(), 1);
+    data = qvariant_cast<IterationData *>(ready.at(0).at(0));
+    QCOMPARE(data->iteration, 2);
+    QCOMPARE(data->rc, 0);
+    delete data;
+
+    /* A cancelled request is never shown */
+    scrubber.request(1);
+    scrubber.cancel();
+    for (int i = 0; i < 100 && scrubber.isLoading(); i++) QTest::qWait(10);
+    QCOMPARE(ready.count(), 1);
+}
+
+void TestVisualiser::transparent_sort() {
+    /* Looking down -z from the origin */
+    float modelview[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    QList<AgentChunk *> chunks;
+    float z[4] = { -2.0, -5.0, -1.0, -3.0 };
+    for (int i = 0; i < 4; i++) {
+        chunks.append(new AgentChunk);
+        chunks.at(i)->centre[2] = z[i];
+    }
+    QList<AgentChunk *> unsorted = chunks;
+
+    AgentRenderer::sortBackToFront(&chunks, modelview);
+    QCOMPARE(chunks.at(0), unsorted.at(1));
+    QCOMPARE(chunks.at(1), unsorted.at(3));
+    QCOMPARE(chunks.at(2), unsorted.at(0));
+    QCOMPARE(chunks.at(3), unsorted.at(2));
+
+    /* Turned around the far chunk is the nearest */
+    modelview[10] = -1.0;
+    AgentRenderer::sortBackToFront(&chunks, modelview);
+    QCOMPARE(chunks.at(0), unsorted.at(2));
+    QCOMPARE(chunks.at(3), unsorted.at(1));
+    qDeleteAll(chunks);
+}
+
+void TestVisualiser::prefetch_stride() {
+    /* Output saved every fifth iteration */
+    QString directory("tests/models/stride_test");
+    QDir().mkpath(directory);
+    QFile::remove(directory + "/0.xml");
+    QFile::remove(directory + "/5.xml");
+    QVERIFY(QFile::copy("tests/models/graph_test/0.xml",
+            directory + "/0.xml"));
+    QVERIFY(QFile::copy("tests/models/graph_test/1.xml",
+            directory + "/5.xml"));
+
+    {
+        IterationIndex index;
+        index.setDirectory(directory);
+        IterationLoader loader;
+        loader.setDirectory(directory);
+        loader.setIndex(&index);
+        loader.setDepth(2);
+        loader.setMemoryLimit(512);
+        loader.prefetch(0, 1);
+        QCOMPARE(loader.pendingCount(), 1);
+        IterationData * data = loader.take(5);
+        QCOMPARE(data->rc, 0);
+        QVERIFY(!data->cancelled);
+        delete data;
+        QCOMPARE(loader.pendingCount(), 0);
+
+        /* Clearing does not wait for reads ahead */
+        loader.prefetch(0, 1);
+        loader.clear();
+        QCOMPARE(loader.pendingCount(), 0);
+    }
+
+    /* The loader has waited for its reads, which write cache files */
+    QStringList names;
+    names << "0" << "5";
+    for (int i = 0; i < names.count(); i++) {
+        QString fileName = directory + "/" + names.at(i) + ".xml";
+        QFile::remove(IterationCache::cacheFileName(fileName));
+        QVERIFY(QFile::remove(fileName));
+    }
+    QDir(directory).rmdir(IterationCache::directoryName);
+    QVERIFY(QDir().rmdir(directory));
+}
+
+void TestVisualiser::read_speed_data() {
+    QTest::addColumn<bool>("general");
+    QTest::newRow("fast") << false;
+    QTest::newRow("general") << true;
+}
+
+void TestVisualiser::read_speed() {
+    QFETCH(bool, general);
+
+    /* The agents of size_test repeated to make a file worth timing */
+    QFile file("tests/models/size_test/1.xml");
+    QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+    QByteArray fixture = file.readAll();
+    file.close();
+    int begin = fixture.indexOf("<xagent>");
+    int end = fixture.indexOf("</states>");
+    QVERIFY(begin != -1 && end != -1);
+    QByteArray agents = fixture.mid(begin, end - begin);
+    QByteArray data = fixture.left(begin);
+    for (int i = 0; i < 2500; i++) data.append(agents);
+    data.append(fixture.mid(end));
+
+    QHash<QString, int> counts;
+    QBENCHMARK {
+        AgentStore store;
+        counts.clear();
+        if (general) {
+            QBuffer buffer(&data);
+            QVERIFY(buffer.open(QIODevice::ReadOnly));
+            ZeroXMLReader reader(&store, &counts);
+            QVERIFY(reader.read(&buffer));
+        } else {
+            FastZeroXMLReader reader(&store, &counts);
+            QVERIFY(reader.read(data.constData(), data.size(), true, true));
+        }
+    }
+    QCOMPARE(counts.value("a"), 10000);
+}
+
+void TestVisualiser::agent_picker() {
+    Position zero;
+    zero.useVariable = false;
+    Shape sphere;
+    sphere.setShape("sphere");
+    Shape cube;
+    cube.setShape("cube");
+    Shape point;
+    point.setShape("point");
+
+    /* Spheres of radius 0.5 and a cube of side 2, found through the grid */
+    RuleAgent s0(Agent(0, 0)), s1(Agent(0, 1)), s2(Agent(0, 2));
+    RuleAgent c0(Agent(0, 3));
+    s1.x = 10.0;
+    s2.z = -5.0;
+    c0.x = 10.0;
+    c0.y = 10.0;
+    c0.shapeDimension = c0.shapeDimensionY = c0.shapeDimensionZ = 2.0;
+    s0.shapeDimension = s1.shapeDimension = s2.shapeDimension = 1.0;
+    VisualSettingsModel model;
+    model.addRule("a", Condition(), zero, zero, zero, sphere, QColor(), true);
+    model.addRule("a", Condition(), zero, zero, zero, cube, QColor(), true);
+    model.getRule(0)->agents << &s0 << &s1 << &s2;
+    model.getRule(1)->agents << &c0;
+
+    AgentPicker picker;
+    QVERIFY(picker.needsBuild(0));
+    picker.build(&model, 0);
+    QVERIFY(!picker.needsBuild(0));
+
+    /* Rays from z 10 to z -10 hit the nearest agent */
+    double nearPoint[3] = { 0.0, 0.0, 10.0 };
+    double farPoint[3] = { 0.0, 0.0, -10.0 };
+    QCOMPARE(picker.pick(nearPoint, farPoint, 0.01, 0.01), &s0);
+    nearPoint[0] = farPoint[0] = 10.0;
+    QCOMPARE(picker.pick(nearPoint, farPoint, 0.01, 0.01), &s1);
+    nearPoint[1] = farPoint[1] = 10.0;
+    QCOMPARE(picker.pick(nearPoint, farPoint, 0.01, 0.01), &c0);
+    nearPoint[0] = farPoint[0] = 5.0;
+    nearPoint[1] = farPoint[1] = 5.0;
+    QVERIFY(picker.pick(nearPoint, farPoint, 0.01, 0.01) == 0);
+
+    /* A ray along x at z -5 meets the sphere behind the first */
+    double leftPoint[3] = { -10.0, 0.0, -5.0 };
+    double rightPoint[3] = { 20.0, 0.0, -5.0 };
+    QCOMPARE(picker.pick(leftPoint, rightPoint, 0.01, 0.01), &s2);
+
+    /* Points picked within 2.5 pixels of 1 need 5 rings of the 0.5 cells
+     * along z, more than 4, so every agent is tested instead */
+    RuleAgent p0(Agent(0, 4)), p1(Agent(0, 5));
+    p0.x = 3.0;
+    p1.x = 20.0;
+    p1.y = 20.0;
+    VisualSettingsModel points;
+    points.addRule("a", Condition(), zero, zero, zero, sphere, QColor(),
+            true);
+    points.addRule("a", Condition(), zero, zero, zero, point, QColor(),
+            true);
+    points.getRule(0)->agents << &s0;
+    points.getRule(1)->agents << &p0 << &p1;
+    picker.invalidate();
+    QVERIFY(picker.needsBuild(0));
+    picker.build(&points, 0);
+
+    nearPoint[0] = farPoint[0] = 4.0;
+    nearPoint[1] = farPoint[1] = 0.0;
+    QCOMPARE(picker.pick(nearPoint, farPoint, 1.0, 1.0), &p0);
+    nearPoint[0] = farPoint[0] = 0.0;
+    QCOMPARE(picker.pick(nearPoint, farPoint, 1.0, 1.0), &s0);
+    nearPoint[0] = farPoint[0] = 10.0;
+    nearPoint[1] = farPoint[1] = 10.0;
+    QVERIFY(picker.pick(nearPoint, farPoint, 1.0, 1.0) == 0);
+}
+
 QTEST_MAIN(TestVisualiser)
 #include "test_flame_visualiser.moc"
@@ -0,0 +1,30 @@
+/*!
+ * \file textsearch.h
+ * \author Simon Coakley
+ * \date 2012
+ * \copyright Copyright (c) 2012 University of Sheffield
+ * \brief Header file for text search
+ */
+#ifndef TEXTSEARCH_H_
+#define TEXTSEARCH_H_
+
+#include <string.h>
+
+/*! \brief Find text between from and end with memchr and memcmp, for the
+ *  readers that scan mapped iteration files.
+ *  \param length The length of the text, at least 1
+ *  \return The start of the text or 0 if it is not there
+ */
+inline const char * findText(const char * from, const char * end,
+        const char * text, int length) {
+    while (end - from >= length) {
+        const char * c = static_cast<const char *>(
+                memchr(from, text[0], end - from - length + 1));
+        if (c == 0) return 0;
+        if (memcmp(c, text, length) == 0) return c;
+        from = c + 1;
+    }
+    return 0;
+}
+
+#endif  // TEXTSEARCH_H_
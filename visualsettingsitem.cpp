@@ -6,6 +6,7 @@
  *  \brief Implementation of visual settings item
  */
 #include "./visualsettingsitem.h"
+#include "./compiledrule.h"
 
 VisualSettingsItem::VisualSettingsItem() {
     colourColor = QColor(128, 128, 128, 255);
@@ -25,73 +26,62 @@ VisualSettingsItem::VisualSettingsItem(QString agentType, Condition condition,
     setEnabled(enabled);
 }
 
-bool VisualSettingsItem::passAgentCondition(Agent *agent) {
-    bool pass = true;
-    // If condition is enabled
-    if (conditionCondition.enable) {
-        pass = false;
-        // For each agent variable
-        for (int k = 0; k < agent->tags.count(); k++) {
-            // If the variable is used in the condition
-            if (QString::compare(conditionCondition.variable,
-                    agent->tags.at(k)) == 0) {
-                // Check each possible operator and its outcome
-                if (conditionCondition.op == "==" &&
-                        agent->values.at(k).toDouble() ==
-                        conditionCondition.value) pass = true;
-                else if (conditionCondition.op == "!=" &&
-                        agent->values.at(k).toDouble() !=
-                        conditionCondition.value) pass = true;
-                else if (conditionCondition.op == ">" &&
-                        agent->values.at(k).toDouble() >
-                        conditionCondition.value) pass = true;
-                else if (conditionCondition.op == "<" &&
-                        agent->values.at(k).toDouble() <
-                        conditionCondition.value) pass = true;
-                else if (conditionCondition.op == ">=" &&
-                        agent->values.at(k).toDouble() >=
-                        conditionCondition.value) pass = true;
-                else if (conditionCondition.op == "<=" &&
-                        agent->values.at(k).toDouble() <=
-                        conditionCondition.value) pass = true;
-            }
-        }
-    }
-    return pass;
-}
-
-void VisualSettingsItem::populate(QList<Agent *> *a) {
-    for (int j = 0; j < agents.size(); j++)
-        // Free memory of ruleagent data
-        delete agents.at(j);
+/*! \brief Populate the rule with the agents that pass its condition and
+ *  calculate their draw data in one pass.
+ *  \param a The agents of the iteration
+ *  \param agentDimension The scene dimension to expand
+ *  \param xoffset The x offset to centre the scene
+ *  \param yoffset The y offset to centre the scene
+ *  \param zoffset The z offset to centre the scene
+ *  \param ratio The ratio from model space to opengl space
+ */
+void VisualSettingsItem::populate(AgentStore *a, Dimension * agentDimension,
+        double xoffset, double yoffset, double zoffset, double ratio) {
+    // Rule agents of the last iteration are dropped all at once
     agents.clear();
+    arena.reset();
     // If the rule is enabled
-    if (boolEnabled) {
-        // If the agent corresponds to the rule agent
-        for (int i = 0; i < a->size(); i++) {
-            if (a->at(i)->agentType == agentTypeString) {
-                // If the agent passes any condition
-                if (passAgentCondition(a->at(i))) {
-                    // Change agent drawing variables for this rule
-                    // Then add a copy of this agent to the agent list of
-                    // the drawing rule.
+    if (!boolEnabled) {
+        arena.release();
+        return;
+    }
+
+    // Resolve the agent type, variables and operator once
+    CompiledRule rule(this, *a);
+    if (rule.type == -1) return;
 
-                    // Create a new rule agent to handle drawing this agent
-                    // under this rule
-                    agents.append(new RuleAgent(a->at(i)));
-                }
-            }
+    for (int i = 0; i < rule.count; i++) {
+        // If the agent passes any condition
+        if (!rule.pass(i)) continue;
+        // Create a new rule agent to handle drawing this agent
+        // under this rule
+        RuleAgent * ruleagent = arena.create(Agent(rule.type, i));
+        rule.drawData(i, ruleagent);
+        /* Calc agent scene dimension */
+        agentDimension->expand(ruleagent->x + ruleagent->shapeDimension,
+                ruleagent->y + ruleagent->shapeDimensionY,
+                ruleagent->z + ruleagent->shapeDimensionZ);
+        // Apply offset to centre the scene and ratio to go from
+        // model space to opengl space
+        ruleagent->x = (ruleagent->x + xoffset) * ratio;
+        ruleagent->y = (ruleagent->y + yoffset) * ratio;
+        ruleagent->z = (ruleagent->z + zoffset) * ratio;
+        /* Point size does not need to be ratioed */
+        if (!rule.isPoint) {
+            ruleagent->shapeDimension  *= ratio;
+            ruleagent->shapeDimensionY *= ratio;
+            ruleagent->shapeDimensionZ *= ratio;
         }
+        agents.append(ruleagent);
     }
 }
 
-void VisualSettingsItem::applyOffset(
-        double xoffset, double yoffset, double zoffset) {
-    for (int j = 0; j < agents.size(); j++) {
-        agents.at(j)->x += xoffset;
-        agents.at(j)->y += yoffset;
-        agents.at(j)->z += zoffset;
-    }
+/*! \brief Take the rule agents of another rule, which is given these.
+ *  \param other The rule populated in place of this one
+ */
+void VisualSettingsItem::takeAgents(VisualSettingsItem * other) {
+    qSwap(agents, other->agents);
+    arena.swap(other->arena);
 }
 
 void VisualSettingsItem::applyRatio(double ratio) {
@@ -109,67 +99,17 @@ void VisualSettingsItem::applyRatio(double ratio) {
 }
 
 void VisualSettingsItem::copyAgentDrawDataToRuleAgentDrawData(
-        Dimension * agentDimension) {
+        AgentStore * a, Dimension * agentDimension) {
+    CompiledRule rule(this, *a);
+    if (rule.type == -1) return;
+
     for (int j = 0; j < agents.size(); j++) {
         RuleAgent * ruleagent = agents.at(j);
-        Agent * agent = ruleagent->agent;
-
-        ruleagent->x = xPosition.opValue;
-        ruleagent->y = yPosition.opValue;
-        ruleagent->z = zPosition.opValue;
-        ruleagent->shapeDimension  = shapeShape.getDimension();
-        ruleagent->shapeDimensionY = shapeShape.getDimensionY();
-        ruleagent->shapeDimensionZ = shapeShape.getDimensionZ();
-
-        for (int k = 0; k < agent->tags.count(); k++) {
-            if (xPosition.useVariable)
-                if (QString::compare(xPosition.positionVariable,
-                        agent->tags.at(k)) == 0)
-                    ruleagent->x += agent->values.at(k).toDouble();
-            if (yPosition.useVariable)
-                if (QString::compare(yPosition.positionVariable,
-                        agent->tags.at(k)) == 0)
-                    ruleagent->y += agent->values.at(k).toDouble();
-            if (zPosition.useVariable)
-                if (QString::compare(zPosition.positionVariable,
-                        agent->tags.at(k)) == 0)
-                    ruleagent->z += agent->values.at(k).toDouble();
-            if (shapeShape.getUseVariable())
-                if (QString::compare(
-                        shapeShape.getDimensionVariable(),
-                        agent->tags.at(k)) == 0)
-                    ruleagent->shapeDimension +=
-                            agent->values.at(k).toDouble();
-            if (shapeShape.getUseVariableY())
-                if (QString::compare(
-                        shapeShape.getDimensionVariableY(),
-                        agent->tags.at(k)) == 0)
-                    ruleagent->shapeDimensionY +=
-                            agent->values.at(k).toDouble();
-            if (shapeShape.getUseVariableZ())
-                if (QString::compare(
-                        shapeShape.getDimensionVariableZ(),
-                        agent->tags.at(k)) == 0)
-                    ruleagent->shapeDimensionZ +=
-                            agent->values.at(k).toDouble();
-        }
-
-        if (shapeShape.getFromCentreX()) ruleagent->shapeDimension  *= 2.0;
-        if (shapeShape.getFromCentreY()) ruleagent->shapeDimensionY *= 2.0;
-        if (shapeShape.getFromCentreZ()) ruleagent->shapeDimensionZ *= 2.0;
+        rule.drawData(ruleagent->agent.row, ruleagent);
 
         /* Calc agent scene dimension */
-        if (agentDimension->xmin > ruleagent->x + ruleagent->shapeDimension)
-            agentDimension->xmin = ruleagent->x + ruleagent->shapeDimension;
-        if (agentDimension->xmax < ruleagent->x + ruleagent->shapeDimension)
-            agentDimension->xmax = ruleagent->x + ruleagent->shapeDimension;
-        if (agentDimension->ymin > ruleagent->y + ruleagent->shapeDimensionY)
-            agentDimension->ymin = ruleagent->y + ruleagent->shapeDimensionY;
-        if (agentDimension->ymax < ruleagent->y + ruleagent->shapeDimensionY)
-            agentDimension->ymax = ruleagent->y + ruleagent->shapeDimensionY;
-        if (agentDimension->zmin > ruleagent->z + ruleagent->shapeDimensionZ)
-            agentDimension->zmin = ruleagent->z + ruleagent->shapeDimensionZ;
-        if (agentDimension->zmax < ruleagent->z + ruleagent->shapeDimensionZ)
-            agentDimension->zmax = ruleagent->z + ruleagent->shapeDimensionZ;
+        agentDimension->expand(ruleagent->x + ruleagent->shapeDimension,
+                ruleagent->y + ruleagent->shapeDimensionY,
+                ruleagent->z + ruleagent->shapeDimensionZ);
     }
 }
@@ -14,6 +14,8 @@
 #include "./position.h"
 #include "./condition.h"
 #include "./ruleagent.h"
+#include "./ruleagentarena.h"
+#include "./agentstore.h"
 #include "./dimension.h"
 
 class VisualSettingsItem {
@@ -40,11 +42,14 @@ class VisualSettingsItem {
     QColor colour() const { return colourColor; }
     void setEnabled(bool b) { boolEnabled = b; }
     bool enabled() const { return boolEnabled; }
-    void applyOffset(double xoffset, double yoffset, double zoffset);
     void applyRatio(double ratio);
-    void copyAgentDrawDataToRuleAgentDrawData(Dimension * agentDimension);
-    bool passAgentCondition(Agent *agent);
-    void populate(QList<Agent *> *a);
+    void copyAgentDrawDataToRuleAgentDrawData(AgentStore * a,
+            Dimension * agentDimension);
+    void populate(AgentStore * a, Dimension * agentDimension,
+            double xoffset, double yoffset, double zoffset, double ratio);
+    void takeAgents(VisualSettingsItem * other);
+
+    qint64 ruleAgentMemory() const { return arena.memoryUsage(); }
 
     QList<RuleAgent *> agents;  /*!< The list of agents to draw */
 
@@ -63,6 +68,7 @@ class VisualSettingsItem {
     Shape shapeShape;
     QColor colourColor;
     bool boolEnabled;
+    RuleAgentArena arena;  /*!< Holds the rule agents of the iteration */
 };
 
 #endif  // VISUALSETTINGSITEM_H_
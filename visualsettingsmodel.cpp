@@ -6,8 +6,22 @@
  *  \brief Implementation of visual settings model
  */
 #include <QtGui>
+#include <QtConcurrentMap>
 #include "./visualsettingsmodel.h"
 
+/*! \brief One rule to populate and the scene dimension of its agents */
+struct RulePopulateJob {
+    VisualSettingsItem * rule;
+    AgentStore * agents;
+    Dimension dimension;
+    double xoffset, yoffset, zoffset, ratio;
+};
+
+static void populateRule(RulePopulateJob & job) {
+    job.rule->populate(job.agents, &job.dimension,
+            job.xoffset, job.yoffset, job.zoffset, job.ratio);
+}
+
 int VisualSettingsModel::rowCount(const QModelIndex &/*parent*/) const {
      return rules.count();
 }
@@ -104,7 +118,7 @@ bool VisualSettingsModel::setData(const QModelIndex &index,
         if (index.column() == 7)
             rules.at(index.row())->setEnabled(qVariantValue<bool>(value));
          emit dataChanged(index, index);
-         emit ruleUpdated(index.row());
+         emit ruleUpdated(index.row(), index.column());
          return true;
      }
      return false;
@@ -168,3 +182,108 @@ void VisualSettingsModel::switchEnabled(QModelIndex index) {
     emit dataChanged(createIndex(index.row(), index.column(), 0),
             createIndex(index.row(), index.column(), 0));
 }
+
+/*! \brief Populate the rule agents of every rule and recalculate the
+ *  agent dimension.
+ *
+ * Each rule only reads the columns of its own agent type and fills its own
+ * rule agents, so the rules are populated at the same time, each expanding
+ * its own dimension which are then merged.
+ *  \param a The agents of the iteration
+ *  \param agentDimension The scene dimension, reset and then expanded
+ *  \param xoffset The x offset to centre the scene
+ *  \param yoffset The y offset to centre the scene
+ *  \param zoffset The z offset to centre the scene
+ *  \param ratio The ratio from model space to opengl space
+ */
+void VisualSettingsModel::populate(AgentStore * a, Dimension * agentDimension,
+        double xoffset, double yoffset, double zoffset, double ratio) {
+    agentDimension->reset();
+    QList<RulePopulateJob> jobs;
+    for (int i = 0; i < rules.count(); i++) {
+        RulePopulateJob job;
+        job.rule = rules.at(i);
+        job.agents = a;
+        job.dimension.reset();
+        job.xoffset = xoffset;
+        job.yoffset = yoffset;
+        job.zoffset = zoffset;
+        job.ratio = ratio;
+        jobs.append(job);
+    }
+
+    if (jobs.count() > 1)
+        QtConcurrent::blockingMap(jobs, populateRule);
+    else if (jobs.count() == 1)
+        populateRule(jobs[0]);
+
+    for (int i = 0; i < jobs.count(); i++)
+        agentDimension->merge(jobs.at(i).dimension);
+}
+
+/*! \brief Automatically work out the offset of the scene to position
+ *  centre at origin and the ratio to fit it in the unit cube, and apply
+ *  them to the rule agents.
+ *  \param xoffset The x offset
+ *  \param yoffset The y offset
+ *  \param zoffset The z offset
+ *  \param ratio The ratio
+ */
+void VisualSettingsModel::calcPositionOffsetAndRatio(double * xoffset,
+        double * yoffset, double * zoffset, double * ratio) {
+    double smallest_x = 0.0;
+    double largest_x = 0.0;
+    double smallest_y = 0.0;
+    double largest_y = 0.0;
+    double smallest_z = 0.0;
+    double largest_z = 0.0;
+    double smallest = 0.0;
+    double largest = 0.0;
+
+    // Calc offset first
+    for (int j = 0; j < rowCount(); j++) {
+        for (int i= 0; i < rules.at(j)->agents.count(); i++) {
+            RuleAgent * agent = rules.at(j)->agents.at(i);
+            if (smallest_x > agent->x) smallest_x = agent->x;
+            if (smallest_y > agent->y) smallest_y = agent->y;
+            if (largest_x  < agent->x) largest_x  = agent->x;
+            if (largest_y  < agent->y) largest_y  = agent->y;
+        }
+    }
+    /* Takes the middle position of x and y */
+    *xoffset = -(largest_x + smallest_x)/2.0;
+    *yoffset = -(largest_y + smallest_y)/2.0;
+    *zoffset = -(largest_z + smallest_z)/2.0;
+
+    // Apply offset and calc ratio
+    for (int j = 0; j < rowCount(); j++) {
+        double size_x = rules.at(j)->shape().getDimension()/2.0;
+        double size_y = size_x;
+        if (QString::compare("cube", rules.at(j)->shape().getShape()) == 0)
+            size_y = rules.at(j)->shape().getDimensionY()/2.0;
+
+        for (int i= 0; i < rules.at(j)->agents.count(); i++) {
+            RuleAgent * agent = rules.at(j)->agents.at(i);
+            // Apply offset
+            agent->x += *xoffset;
+            agent->y += *yoffset;
+            agent->z += *zoffset;
+            double x = agent->x;
+            double y = agent->y;
+
+            if (smallest > x-size_x) smallest = x-size_x;
+            if (smallest > y-size_y) smallest = y-size_y;
+            if (largest  < x+size_x) largest  = x+size_x;
+            if (largest  < y+size_y) largest  = y+size_y;
+        }
+    }
+    if (smallest < 0.0 && largest < -smallest)
+        *ratio = 1.0 / -smallest;
+    else
+        *ratio = 1.0 / largest;
+
+    // Apply ratio
+    for (int j = 0; j < rowCount(); j++) {
+        rules.at(j)->applyRatio(*ratio);
+    }
+}
@@ -38,9 +38,13 @@ class VisualSettingsModel : public QAbstractTableModel {
     QList<VisualSettingsItem *> getRules() const { return rules; }
     VisualSettingsItem * getRule(int row) const { return rules[row]; }
     void switchEnabled(QModelIndex index);
+    void populate(AgentStore * a, Dimension * agentDimension,
+            double xoffset, double yoffset, double zoffset, double ratio);
+    void calcPositionOffsetAndRatio(double * xoffset, double * yoffset,
+            double * zoffset, double * ratio);
 
   signals:
-     void ruleUpdated(int);
+     void ruleUpdated(int row, int column);
 
   public slots:
      void addRule();
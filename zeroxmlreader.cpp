@@ -6,31 +6,15 @@
  *  \brief Implementation of zero XML reader
  */
 #include <QtGui>
+#include <string.h>
 #include "./zeroxmlreader.h"
-#include "./visualsettingsitem.h"
-#include "./ruleagent.h"
+#include "./textsearch.h"
 
-ZeroXMLReader::ZeroXMLReader(QList<Agent *> *a, QList<AgentType> *at,
-        VisualSettingsModel *vsm, double r, Dimension * ad,
-                             QStringList *sat, QHash<QString, int> *atc,
-                             double xo, double yo, double zo) {
+ZeroXMLReader::ZeroXMLReader(AgentStore *a, QHash<QString, int> *atc) {
     agents = a;
-    agentTypes = at;
-    vsmodel = vsm;
-    ratio = r;
-    agentDimension = ad;
-    stringAgentTypes = sat;
     agentTypeCounts = atc;
-    xoffset = xo;
-    yoffset = yo;
-    zoffset = zo;
-
-    agentDimension->xmin =  999999.9;
-    agentDimension->xmax = -999999.9;
-    agentDimension->ymin =  999999.9;
-    agentDimension->ymax = -999999.9;
-    agentDimension->zmin =  999999.9;
-    agentDimension->zmax = -999999.9;
+    projection = 0;
+    abort = 0;
 }
 
 bool ZeroXMLReader::read(QIODevice * device) {
@@ -48,19 +32,6 @@ bool ZeroXMLReader::read(QIODevice * device) {
         }
     }
 
-    // For every rule
-    for (int i = 0; i < vsmodel->rowCount(); i++) {
-        // Populate rule with ruleagents from agents
-        vsmodel->getRule(i)->populate(agents);
-        // Calculate visual variables for ruleagent
-        vsmodel->getRule(i)->
-                copyAgentDrawDataToRuleAgentDrawData(agentDimension);
-        // Apply offset to ruleagents to centre the scene
-        vsmodel->getRule(i)->applyOffset(xoffset, yoffset, zoffset);
-        // Apply ratio to ruleagents to go from model space to opengl space
-        vsmodel->getRule(i)->applyRatio(ratio);
-    }
-
     return !error();
 }
 
@@ -105,18 +76,11 @@ void ZeroXMLReader::readZeroXML() {
 }
 
 void ZeroXMLReader::readEnvironmentXML() {
-    // Create 'agent' with type environment
-    Agent * agent = new Agent;
-    int index = -1;
-    agent->isEnvironment = true;
-    agent->agentType = "environment";
-
-    if (stringAgentTypes->contains("environment") == false) {
-     // qDebug() << "new agent type found: environment";
-     stringAgentTypes->append("environment");
-     agentTypes->append(AgentType("environment"));
-     index = agentTypes->count() - 1;
-    }
+    // Store environment as an 'agent' with type environment
+    int type = agents->addType("environment");
+    AgentColumns & columns = agents->type(type);
+    int row = columns.appendAgent();
+    columns.isEnvironment = true;
 
     /* Make environment count one for iteration info */
     agentTypeCounts->insert("environment", 1);
@@ -128,16 +92,17 @@ void ZeroXMLReader::readEnvironmentXML() {
              break;
 
          if (isStartElement()) {
-             agent->tags.append(name().toString());
-             agent->values.append(readElementText());
-             if (index != -1) {
-                (*agentTypes)[index].variables.append(name().toString());
+             if (projection && !projection->wantsVariable(columns.name,
+                     name().toString())) {
+                 /* Not used by any rule or plot */
+                 columns.addSkipped(name().toString());
+                 readUnknownElement();
+                 continue;
              }
+             columns.setValue(columns.addVariable(name().toString()), row,
+                              readElementText());
          }
      }
-
-    // Add agent to list of agents
-    agents->append(agent);
 }
 
 void ZeroXMLReader::readAgentsXML() {
@@ -157,9 +122,12 @@ void ZeroXMLReader::readAgentsXML() {
 }
 
 void ZeroXMLReader::readAgentXML() {
-    Agent * agent = new Agent;
-    QString agentname = "";
-    int index = -1;
+    AgentColumns * columns = 0;
+    int row = -1;
+    /* Column expected next, agents of a type list variables in order */
+    int expected = 0;
+    /* The agent type is not read, only the names of its variables */
+    bool skipType = false;
 
     while (!atEnd()) {
          readNext();
@@ -169,28 +137,116 @@ void ZeroXMLReader::readAgentXML() {
          if (isStartElement()) {
              if (name() == "name") {
                  // Agent type
-                 agentname = readElementText();
-                 agent->agentType = agentname;
+                 QString agentname = readElementText();
+                 columns = &agents->type(agents->addType(agentname));
                  /* Increment agent counts for iteration info */
                  agentTypeCounts->insert(agentname,
                                         agentTypeCounts->value(agentname) + 1);
-                 /* If agent type is unknown then add to agent list */
-                 if (stringAgentTypes->contains(agentname) == false) {
-                     // qDebug() << "new agent type found: " << agentname;
-                     stringAgentTypes->append(agentname);
-                     agentTypes->append(AgentType(agentname));
-                     index = agentTypes->count() - 1;
-                 } else { index = -1; }
+                 skipType = projection && !projection->wantsType(agentname);
+                 if (!skipType) row = columns->appendAgent();
+             } else if (columns == 0) {
+                 /* Memory before the agent type is known cannot be stored */
+                 readUnknownElement();
+             } else if (skipType) {
+                 /* No enabled rule or plot uses the agent type */
+                 columns->addSkipped(name().toString());
+                 readUnknownElement();
+             } else if (projection && !projection->wantsVariable(
+                     columns->name, name().toString())) {
+                 /* Not used by any rule or plot */
+                 columns->addSkipped(name().toString());
+                 readUnknownElement();
              } else {
                  // Agent memory variable
-                 agent->tags.append(name().toString());
-                 agent->values.append(readElementText());
-                 /* If agent is unknown then add variables to agent type */
-                 if (index != -1)
-                    (*agentTypes)[index].variables.append(name().toString());
+                 int variable;
+                 if (expected < columns->variables.count() &&
+                         name() == columns->variables.at(expected)) {
+                     variable = expected;
+                 } else {
+                     variable = columns->addVariable(name().toString());
+                 }
+                 expected = variable + 1;
+                 columns->setValue(variable, row, readElementText());
              }
          }
      }
-    // Add agent to list of agents
-    agents->append(agent);
+     if (abort && *abort != 0)
+         raiseError(QObject::tr("Reading was cancelled"));
+}
+
+/*! \brief Read every memory variable of one agent from an iteration file,
+ *  for an agent whose memory was only partly read.
+ *
+ * The mapped file is searched for the agent without parsing the agents
+ * before it and only the agent itself is parsed.
+ *  \param fileName The iteration file
+ *  \param type The agent type
+ *  \param row The agent row, the number of agents of the type before it
+ *  \param columns Set to the agent type with the one agent
+ *  \return False if the agent could not be found or read
+ */
+bool ZeroXMLReader::readAgent(const QString & fileName, const QString & type,
+        int row, AgentColumns * columns) {
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) return false;
+    qint64 size = file.size();
+    if (size <= 0) return false;
+    QByteArray contents;
+    uchar * mapped = file.map(0, size);
+    const char * data = reinterpret_cast<const char *>(mapped);
+    if (data == 0) {
+        contents = file.readAll();
+        data = contents.constData();
+        size = contents.size();
+    }
+    const char * end = data + size;
+
+    QByteArray startTag("<xagent>");
+    QByteArray endTag("</xagent>");
+    if (type == "environment") {
+        startTag = "<environment>";
+        endTag = "</environment>";
+    }
+    QByteArray name = type.toUtf8();
+    QByteArray nameTag("<name>");
+
+    /* Find the start and end of the agent, only it is copied */
+    QByteArray block;
+    int n = 0;
+    const char * from = data;
+    while (block.isEmpty()) {
+        const char * agent = findText(from, end, startTag.constData(),
+                startTag.size());
+        if (agent == 0) break;
+        const char * agentEnd = findText(agent, end, endTag.constData(),
+                endTag.size());
+        if (agentEnd == 0) break;
+        from = agentEnd + endTag.size();
+        if (type != "environment") {
+            const char * text = findText(agent, agentEnd,
+                    nameTag.constData(), nameTag.size());
+            if (text == 0) continue;
+            text += nameTag.size();
+            const char * textEnd = static_cast<const char *>(
+                    memchr(text, '<', agentEnd - text));
+            if (textEnd == 0) continue;
+            if (QByteArray(text, textEnd - text).trimmed() != name)
+                continue;
+            if (n++ != row) continue;
+        }
+        block = "<states>" + QByteArray(agent, from - agent) + "</states>";
+    }
+    if (mapped) file.unmap(mapped);
+    if (block.isEmpty()) return false;
+
+    AgentStore store;
+    QHash<QString, int> counts;
+    QBuffer buffer(&block);
+    buffer.open(QIODevice::ReadOnly);
+    ZeroXMLReader reader(&store, &counts);
+    if (!reader.read(&buffer)) return false;
+    int t = store.typeIndex(type);
+    if (t == -1 || store.type(t).count != 1) return false;
+    *columns = store.type(t);
+    return true;
 }
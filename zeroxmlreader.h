@@ -10,18 +10,19 @@
 
 #include <QXmlStreamReader>
 #include <QHash>
-#include "./agent.h"
-#include "./agenttype.h"
-#include "./visualsettingsmodel.h"
-#include "./dimension.h"
+#include <QAtomicInt>
+#include "./agentstore.h"
+#include "./agentprojection.h"
 
 class ZeroXMLReader : public QXmlStreamReader {
   public:
-    ZeroXMLReader(QList<Agent*> * a, QList<AgentType> * at,
-            VisualSettingsModel * vsm, double r, Dimension * ad,
-            QStringList * sat, QHash<QString, int> * atc,
-            double xo, double yo, double zo);
+    ZeroXMLReader(AgentStore * a, QHash<QString, int> * atc);
     bool read(QIODevice * device);
+    void setProjection(const AgentProjection * p) { projection = p; }
+    void setAbort(const QAtomicInt * a) { abort = a; }
+
+    static bool readAgent(const QString & fileName, const QString & type,
+            int row, AgentColumns * columns);
 
   private:
     void readUnknownElement();
@@ -29,16 +30,12 @@ class ZeroXMLReader : public QXmlStreamReader {
     void readAgentXML();
     void readAgentsXML();
     void readZeroXML();
-    QList<Agent*> * agents;
-    QList<AgentType> * agentTypes;
-    VisualSettingsModel * vsmodel;
-    double ratio;
-    Dimension * agentDimension;
-    QStringList * stringAgentTypes;
+    AgentStore * agents;
     QHash<QString, int> * agentTypeCounts;
-    double xoffset;
-    double yoffset;
-    double zoffset;
+    /*! \brief The variables to read, 0 for every variable */
+    const AgentProjection * projection;
+    /*! \brief Stops reading with an error when set, 0 if never stopped */
+    const QAtomicInt * abort;
 };
 
 #endif  // ZEROXMLREADER_H_